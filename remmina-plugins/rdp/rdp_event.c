@@ -91,7 +91,8 @@ static void remmina_rdp_event_event_push(RemminaProtocolWidget* gp, const Remmin
 
 	if (rfi->event_queue)
 	{
-		event = g_memdup(e, sizeof(RemminaPluginRdpEvent));
+		event = (RemminaPluginRdpEvent*) rf_pool_alloc(&rfi->event_pool);
+		*event = *e;
 		g_async_queue_push(rfi->event_queue, event);
 
 		if (write(rfi->event_pipe[1], "\0", 1))
@@ -188,21 +189,38 @@ static void remmina_rdp_event_scale_area(RemminaProtocolWidget* gp, gint* x, gin
 	*h = sh;
 }
 
-void remmina_rdp_event_update_region(RemminaProtocolWidget* gp, RemminaPluginRdpUiObject* ui)
+static void remmina_rdp_event_update_region(RemminaProtocolWidget* gp, RemminaPluginRdpUiObject* ui, cairo_region_t* damage)
 {
 	TRACE_CALL("remmina_rdp_event_update_region");
-	rfContext* rfi = GET_PLUGIN_DATA(gp);
-	gint x, y, w, h;
+	cairo_rectangle_int_t rect;
 
-	x = ui->region.x;
-	y = ui->region.y;
-	w = ui->region.width;
-	h = ui->region.height;
+	rect.x = ui->region.x;
+	rect.y = ui->region.y;
+	rect.width = ui->region.width;
+	rect.height = ui->region.height;
 
 	if (remmina_plugin_service->protocol_plugin_get_scale(gp))
-		remmina_rdp_event_scale_area(gp, &x, &y, &w, &h);
+		remmina_rdp_event_scale_area(gp, &rect.x, &rect.y, &rect.width, &rect.height);
 
-	gtk_widget_queue_draw_area(rfi->drawing_area, x, y, w, h);
+	/* Only accumulated here, remmina_rdp_event_flush_damage() queues the redraw */
+	cairo_region_union_rectangle(damage, &rect);
+}
+
+static void remmina_rdp_event_flush_damage(RemminaProtocolWidget* gp, cairo_region_t* damage)
+{
+	TRACE_CALL("remmina_rdp_event_flush_damage");
+	rfContext* rfi = GET_PLUGIN_DATA(gp);
+	cairo_rectangle_int_t rect;
+	gint i, n;
+
+	n = cairo_region_num_rectangles(damage);
+	for (i = 0; i < n; i++)
+	{
+		cairo_region_get_rectangle(damage, i, &rect);
+		gtk_widget_queue_draw_area(rfi->drawing_area, rect.x, rect.y, rect.width, rect.height);
+	}
+
+	cairo_region_subtract(damage, damage);
 }
 
 void remmina_rdp_event_update_rect(RemminaProtocolWidget* gp, gint x, gint y, gint w, gint h)
@@ -511,7 +529,7 @@ gboolean remmina_rdp_event_on_clipboard(GtkClipboard *gtkClipboard, GdkEvent *ev
 	clipboard = &(rfi->clipboard);
 
 	if ( clipboard->sync ) {
-		ui = g_new0(RemminaPluginRdpUiObject, 1);
+		ui = rf_object_new(gp);
 		ui->type = REMMINA_RDP_UI_CLIPBOARD;
 		ui->clipboard.clipboard = clipboard;
 		ui->clipboard.type = REMMINA_RDP_UI_CLIPBOARD_FORMATLIST;
@@ -521,6 +539,82 @@ gboolean remmina_rdp_event_on_clipboard(GtkClipboard *gtkClipboard, GdkEvent *ev
 	return TRUE;
 }
 
+/* A converted cursor, identified by everything its conversion depends on */
+typedef struct remmina_plugin_rdp_cursor_entry
+{
+	guint hash;
+	UINT32 width;
+	UINT32 height;
+	UINT32 xorBpp;
+	UINT32 xPos;
+	UINT32 yPos;
+	UINT32 lengthAndMask;
+	UINT32 lengthXorMask;
+	const BYTE* andMaskData;
+	const BYTE* xorMaskData;
+	GdkCursor* cursor;
+	GList* link;
+} RemminaPluginRdpCursorEntry;
+
+static guint remmina_rdp_event_cursor_hash(gconstpointer key)
+{
+	return ((const RemminaPluginRdpCursorEntry*) key)->hash;
+}
+
+static gboolean remmina_rdp_event_cursor_equal(gconstpointer a, gconstpointer b)
+{
+	const RemminaPluginRdpCursorEntry* ea = a;
+	const RemminaPluginRdpCursorEntry* eb = b;
+
+	return ea->hash == eb->hash && ea->width == eb->width && ea->height == eb->height && ea->xorBpp == eb->xorBpp
+		&& ea->xPos == eb->xPos && ea->yPos == eb->yPos
+		&& ea->lengthAndMask == eb->lengthAndMask && ea->lengthXorMask == eb->lengthXorMask
+		&& memcmp(ea->andMaskData, eb->andMaskData, ea->lengthAndMask) == 0
+		&& memcmp(ea->xorMaskData, eb->xorMaskData, ea->lengthXorMask) == 0;
+}
+
+static guint remmina_rdp_event_cursor_hash_bytes(guint hash, const BYTE* data, UINT32 length)
+{
+	UINT32 i;
+
+	/* FNV-1a */
+	for (i = 0; i < length; i++)
+		hash = (hash ^ data[i]) * 16777619;
+	return hash;
+}
+
+static void remmina_rdp_event_cursor_entry_init(RemminaPluginRdpCursorEntry* entry, rdpPointer* pointer)
+{
+	UINT32 fields[5];
+
+	entry->width = pointer->width;
+	entry->height = pointer->height;
+	entry->xorBpp = pointer->xorBpp;
+	entry->xPos = pointer->xPos;
+	entry->yPos = pointer->yPos;
+	entry->lengthAndMask = pointer->lengthAndMask;
+	entry->lengthXorMask = pointer->lengthXorMask;
+	entry->andMaskData = pointer->andMaskData;
+	entry->xorMaskData = pointer->xorMaskData;
+
+	fields[0] = entry->width;
+	fields[1] = entry->height;
+	fields[2] = entry->xorBpp;
+	fields[3] = entry->xPos;
+	fields[4] = entry->yPos;
+	entry->hash = remmina_rdp_event_cursor_hash_bytes(2166136261U, (const BYTE*) fields, sizeof(fields));
+	entry->hash = remmina_rdp_event_cursor_hash_bytes(entry->hash, entry->andMaskData, entry->lengthAndMask);
+	entry->hash = remmina_rdp_event_cursor_hash_bytes(entry->hash, entry->xorMaskData, entry->lengthXorMask);
+}
+
+static void remmina_rdp_event_cursor_entry_free(RemminaPluginRdpCursorEntry* entry)
+{
+	g_object_unref(entry->cursor);
+	/* Both masks live in one block, starting with the and mask */
+	g_free((gpointer) entry->andMaskData);
+	g_free(entry);
+}
+
 void remmina_rdp_event_init(RemminaProtocolWidget* gp)
 {
 	TRACE_CALL("remmina_rdp_event_init");
@@ -572,7 +666,9 @@ void remmina_rdp_event_init(RemminaProtocolWidget* gp)
 	}
 
 	rfi->pressed_keys = g_array_new(FALSE, TRUE, sizeof (DWORD));
-	rfi->event_queue = g_async_queue_new_full(g_free);
+	rf_pool_init(&rfi->ui_pool, sizeof(RemminaPluginRdpUiObject));
+	rf_pool_init(&rfi->event_pool, sizeof(RemminaPluginRdpEvent));
+	rfi->event_queue = g_async_queue_new();
 	rfi->ui_queue = g_async_queue_new();
 
 	if (pipe(rfi->event_pipe))
@@ -588,6 +684,8 @@ void remmina_rdp_event_init(RemminaProtocolWidget* gp)
 	}
 
 	rfi->object_table = g_hash_table_new_full(NULL, NULL, NULL, g_free);
+	rfi->cursor_cache = g_hash_table_new(remmina_rdp_event_cursor_hash, remmina_rdp_event_cursor_equal);
+	rfi->cursor_lru = g_queue_new();
 
 	rfi->display = gdk_display_get_default();
 	rfi->bpp = gdk_visual_get_best_depth();
@@ -598,6 +696,8 @@ void remmina_rdp_event_uninit(RemminaProtocolWidget* gp)
 	TRACE_CALL("remmina_rdp_event_uninit");
 	rfContext* rfi = GET_PLUGIN_DATA(gp);
 	RemminaPluginRdpUiObject* ui;
+	RemminaPluginRdpEvent* event;
+	RemminaPluginRdpCursorEntry* entry;
 
 	if ( !rfi ) return;
 
@@ -629,7 +729,24 @@ void remmina_rdp_event_uninit(RemminaProtocolWidget* gp)
 
 	g_hash_table_destroy(rfi->object_table);
 
+	if (rfi->cursor_hits + rfi->cursor_misses > 0)
+	{
+		remmina_plugin_service->log_printf("[RDP] Cursor cache: %u hits, %u misses, %u%% hit rate\n",
+				rfi->cursor_hits, rfi->cursor_misses,
+				rfi->cursor_hits * 100 / (rfi->cursor_hits + rfi->cursor_misses));
+	}
+	g_hash_table_destroy(rfi->cursor_cache);
+	while ((entry = g_queue_pop_head(rfi->cursor_lru)) != NULL)
+	{
+		remmina_rdp_event_cursor_entry_free(entry);
+	}
+	g_queue_free(rfi->cursor_lru);
+
 	g_array_free(rfi->pressed_keys, TRUE);
+	while ((event = (RemminaPluginRdpEvent*) g_async_queue_try_pop(rfi->event_queue)) != NULL)
+	{
+		rf_pool_release(&rfi->event_pool, event);
+	}
 	g_async_queue_unref(rfi->event_queue);
 	rfi->event_queue = NULL;
 	g_async_queue_unref(rfi->ui_queue);
@@ -713,12 +830,11 @@ static void remmina_rdp_event_connected(RemminaProtocolWidget* gp, RemminaPlugin
 	remmina_rdp_event_update_scale(gp);
 }
 
-static void remmina_rdp_event_create_cursor(RemminaProtocolWidget* gp, RemminaPluginRdpUiObject* ui)
+static GdkCursor* remmina_rdp_event_convert_cursor(rfContext* rfi, rdpPointer* pointer)
 {
-	TRACE_CALL("remmina_rdp_event_create_cursor");
+	TRACE_CALL("remmina_rdp_event_convert_cursor");
 	GdkPixbuf* pixbuf;
-	rfContext* rfi = GET_PLUGIN_DATA(gp);
-	rdpPointer* pointer = (rdpPointer*)ui->cursor.pointer;
+	GdkCursor* cursor;
 	cairo_surface_t* surface;
 	UINT8* data = malloc(pointer->width * pointer->height * 4);
 
@@ -726,7 +842,62 @@ static void remmina_rdp_event_create_cursor(RemminaProtocolWidget* gp, RemminaPl
 	surface = cairo_image_surface_create_for_data(data, CAIRO_FORMAT_ARGB32, pointer->width, pointer->height, cairo_format_stride_for_width(CAIRO_FORMAT_ARGB32, pointer->width));
 	pixbuf = gdk_pixbuf_get_from_surface(surface, 0, 0, pointer->width, pointer->height);
 	cairo_surface_destroy(surface);
-	((rfPointer*)ui->cursor.pointer)->cursor = gdk_cursor_new_from_pixbuf(rfi->display, pixbuf, pointer->xPos, pointer->yPos);
+	free(data);
+	cursor = gdk_cursor_new_from_pixbuf(rfi->display, pixbuf, pointer->xPos, pointer->yPos);
+	g_object_unref(pixbuf);
+	return cursor;
+}
+
+static void remmina_rdp_event_create_cursor(RemminaProtocolWidget* gp, RemminaPluginRdpUiObject* ui)
+{
+	TRACE_CALL("remmina_rdp_event_create_cursor");
+	rfContext* rfi = GET_PLUGIN_DATA(gp);
+	rdpPointer* pointer = (rdpPointer*)ui->cursor.pointer;
+	RemminaPluginRdpCursorEntry key;
+	RemminaPluginRdpCursorEntry* entry;
+	RemminaPluginRdpCursorEntry* evicted;
+	BYTE* masks;
+
+	remmina_rdp_event_cursor_entry_init(&key, pointer);
+	entry = g_hash_table_lookup(rfi->cursor_cache, &key);
+	if (entry)
+	{
+		rfi->cursor_hits++;
+		g_queue_unlink(rfi->cursor_lru, entry->link);
+		g_queue_push_head_link(rfi->cursor_lru, entry->link);
+	}
+	else
+	{
+		rfi->cursor_misses++;
+		entry = g_memdup(&key, sizeof(RemminaPluginRdpCursorEntry));
+		masks = g_malloc(key.lengthAndMask + key.lengthXorMask);
+		memcpy(masks, key.andMaskData, key.lengthAndMask);
+		memcpy(masks + key.lengthAndMask, key.xorMaskData, key.lengthXorMask);
+		entry->andMaskData = masks;
+		entry->xorMaskData = masks + key.lengthAndMask;
+		entry->cursor = remmina_rdp_event_convert_cursor(rfi, pointer);
+
+		g_queue_push_head(rfi->cursor_lru, entry);
+		entry->link = g_queue_peek_head_link(rfi->cursor_lru);
+		g_hash_table_insert(rfi->cursor_cache, entry, entry);
+
+		if (g_queue_get_length(rfi->cursor_lru) > REMMINA_RDP_CURSOR_CACHE_SIZE)
+		{
+			/* Pointers still using the evicted cursor keep their own reference */
+			evicted = g_queue_pop_tail(rfi->cursor_lru);
+			g_hash_table_remove(rfi->cursor_cache, evicted);
+			remmina_rdp_event_cursor_entry_free(evicted);
+		}
+	}
+
+	if ((rfi->cursor_hits + rfi->cursor_misses) % REMMINA_RDP_CURSOR_CACHE_LOG == 0)
+	{
+		remmina_plugin_service->log_printf("[RDP] Cursor cache: %u hits, %u misses, %u%% hit rate\n",
+				rfi->cursor_hits, rfi->cursor_misses,
+				rfi->cursor_hits * 100 / (rfi->cursor_hits + rfi->cursor_misses));
+	}
+
+	((rfPointer*)ui->cursor.pointer)->cursor = g_object_ref(entry->cursor);
 }
 
 static void remmina_rdp_event_free_cursor(RemminaProtocolWidget* gp, RemminaPluginRdpUiObject* ui)
@@ -789,18 +960,39 @@ gboolean remmina_rdp_event_queue_ui(RemminaProtocolWidget* gp)
 	TRACE_CALL("remmina_rdp_event_queue_ui");
 	rfContext* rfi = GET_PLUGIN_DATA(gp);
 	RemminaPluginRdpUiObject* ui;
+	cairo_region_t* damage;
+	gint64 deadline;
+	gboolean pending = TRUE;
 
-	LOCK_BUFFER(FALSE);
-	ui = (RemminaPluginRdpUiObject*) g_async_queue_try_pop(rfi->ui_queue);
+	/* Drain as many objects as fit in the budget, so a burst of updates does
+	 * not cost one main loop iteration each. Consecutive region updates are
+	 * merged and redrawn together. */
+	damage = cairo_region_create();
+	deadline = g_get_monotonic_time() + REMMINA_RDP_UI_QUEUE_BUDGET;
 
-	if (ui)
+	do
 	{
+		LOCK_BUFFER(FALSE);
+		ui = (RemminaPluginRdpUiObject*) g_async_queue_try_pop(rfi->ui_queue);
+		if (!ui)
+		{
+			rfi->ui_handler = 0;
+			pending = FALSE;
+		}
 		UNLOCK_BUFFER(FALSE)
+
+		if (!ui)
+			break;
+
 		if ( !rfi->thread_cancelled ) {
+			/* Other objects may depend on the pending redraws, keep the order */
+			if (ui->type != REMMINA_RDP_UI_UPDATE_REGION)
+				remmina_rdp_event_flush_damage(gp, damage);
+
 			switch (ui->type)
 			{
 				case REMMINA_RDP_UI_UPDATE_REGION:
-					remmina_rdp_event_update_region(gp, ui);
+					remmina_rdp_event_update_region(gp, ui, damage);
 					break;
 
 				case REMMINA_RDP_UI_CONNECTED:
@@ -832,15 +1024,15 @@ gboolean remmina_rdp_event_queue_ui(RemminaProtocolWidget* gp)
 		} else {
 			rf_object_free(gp, ui);
 		}
-
-		return TRUE;
-	}
-	else
-	{
-		rfi->ui_handler = 0;
-		UNLOCK_BUFFER(FALSE)
-		return FALSE;
 	}
+	while (g_get_monotonic_time() < deadline);
+
+	if (!rfi->thread_cancelled)
+		remmina_rdp_event_flush_damage(gp, damage);
+	cairo_region_destroy(damage);
+
+	/* Leftovers are handled on the next idle, after GTK had a chance to draw */
+	return pending;
 }
 
 void remmina_rdp_event_unfocus(RemminaProtocolWidget* gp)
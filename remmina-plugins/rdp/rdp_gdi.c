@@ -40,6 +40,7 @@
 #include "rdp_plugin.h"
 #include "rdp_event.h"
 #include "rdp_gdi.h"
+#include "rdp_settings.h"
 #include <freerdp/freerdp.h>
 #include <freerdp/constants.h>
 #include <freerdp/cache/cache.h>
@@ -61,7 +62,7 @@ static void rf_desktop_resize(rdpContext* context)
 
 	UNLOCK_BUFFER(TRUE)
 
-	ui = g_new0(RemminaPluginRdpUiObject, 1);
+	ui = rf_object_new(gp);
 	ui->sync = TRUE;	// Wait for completion too
 	ui->type = REMMINA_RDP_UI_EVENT;
 	ui->event.type = REMMINA_RDP_UI_EVENT_UPDATE_SCALE;
@@ -135,47 +136,258 @@ static void rf_gdi_fast_index(rdpContext* context, FAST_INDEX_ORDER* fast_index)
 	g_print("fast_index\n");
 }
 
+/* Below this many tiles per worker, handing a message to the pool costs more than it saves */
+#define RF_GDI_RFX_TILES_PER_JOB	16
+
+/* A contiguous slice of the tiles of one RFX message, composited by one worker */
+struct rf_rfx_job
+{
+	rfContext* rfi;
+	RFX_MESSAGE* message;
+	gint left;
+	gint top;
+	gint first;
+	gint last;
+	gint* pending;
+	pthread_mutex_t* mutex;
+	pthread_cond_t* cond;
+};
+typedef struct rf_rfx_job rfRfxJob;
+
+static void rf_gdi_rfx_composite(rfRfxJob* job)
+{
+	TRACE_CALL("rf_gdi_rfx_composite");
+	rfContext* rfi = job->rfi;
+	RFX_MESSAGE* message = job->message;
+	RFX_TILE* tile;
+	RFX_RECT* rect;
+	UINT8* src;
+	UINT8* dst;
+	gint stride;
+	gint i, j, y;
+	gint x1, y1, x2, y2;
+
+	stride = cairo_format_stride_for_width(rfi->cairo_format, rfi->width);
+
+	/* Tiles are always 64x64, only the parts inside the message rectangles are valid.
+	 * Tiles never overlap, so the slices of different workers never touch the same pixels */
+	for (i = job->first; i < job->last; i++)
+	{
+		tile = message->tiles[i];
+
+		for (j = 0; j < message->numRects; j++)
+		{
+			rect = &message->rects[j];
+
+			x1 = MAX(MAX(tile->x, rect->x) + job->left, 0);
+			y1 = MAX(MAX(tile->y, rect->y) + job->top, 0);
+			x2 = MIN(MIN(tile->x + 64, rect->x + rect->width) + job->left, rfi->width);
+			y2 = MIN(MIN(tile->y + 64, rect->y + rect->height) + job->top, rfi->height);
+
+			if (x1 >= x2 || y1 >= y2)
+				continue;
+
+			src = tile->data + ((y1 - job->top - tile->y) * 64 + (x1 - job->left - tile->x)) * 4;
+			dst = rfi->primary_buffer + y1 * stride + x1 * 4;
+
+			for (y = y1; y < y2; y++)
+			{
+				memcpy(dst, src, (x2 - x1) * 4);
+				src += 64 * 4;
+				dst += stride;
+			}
+		}
+	}
+}
+
+static void rf_gdi_rfx_worker(gpointer data, gpointer user_data)
+{
+	TRACE_CALL("rf_gdi_rfx_worker");
+	rfRfxJob* job = (rfRfxJob*) data;
+
+	rf_gdi_rfx_composite(job);
+
+	pthread_mutex_lock(job->mutex);
+	if (--(*job->pending) == 0)
+		pthread_cond_signal(job->cond);
+	pthread_mutex_unlock(job->mutex);
+}
+
+/* Splits the tiles of the message across the pool, keeps the first slice for the
+ * calling thread and returns only when every slice has been written */
+static void rf_gdi_rfx_composite_message(rfContext* rfi, RFX_MESSAGE* message, gint left, gint top)
+{
+	TRACE_CALL("rf_gdi_rfx_composite_message");
+	rfRfxJob jobs[REMMINA_RDP_RFX_MAX_THREADS];
+	gint njobs, pending, i;
+	int cancel_state;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+
+	njobs = 1;
+	if (rfi->rfx_pool)
+		njobs = CLAMP(message->numTiles / RF_GDI_RFX_TILES_PER_JOB, 1, rfi->rfx_threads);
+
+	/* The workers point into this stack frame: the rdp thread must not be
+	 * cancelled until all of them are done */
+	pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &cancel_state);
+
+	pthread_mutex_init(&mutex, NULL);
+	pthread_cond_init(&cond, NULL);
+	pending = njobs - 1;
+
+	for (i = 0; i < njobs; i++)
+	{
+		jobs[i].rfi = rfi;
+		jobs[i].message = message;
+		jobs[i].left = left;
+		jobs[i].top = top;
+		jobs[i].first = message->numTiles * i / njobs;
+		jobs[i].last = message->numTiles * (i + 1) / njobs;
+		jobs[i].pending = &pending;
+		jobs[i].mutex = &mutex;
+		jobs[i].cond = &cond;
+
+		if (i > 0)
+			g_thread_pool_push(rfi->rfx_pool, &jobs[i], NULL);
+	}
+
+	rf_gdi_rfx_composite(&jobs[0]);
+
+	pthread_mutex_lock(&mutex);
+	while (pending > 0)
+		pthread_cond_wait(&cond, &mutex);
+	pthread_mutex_unlock(&mutex);
+
+	pthread_cond_destroy(&cond);
+	pthread_mutex_destroy(&mutex);
+
+	pthread_setcancelstate(cancel_state, NULL);
+}
+
+/* Uncompressed bitmaps are stored bottom-up, copied straight into the 32bpp primary buffer */
+static void rf_gdi_nocodec_composite(rfContext* rfi, SURFACE_BITS_COMMAND* cmd)
+{
+	TRACE_CALL("rf_gdi_nocodec_composite");
+	UINT8* src;
+	UINT8* dst;
+	gint stride;
+	gint x1, y1, x2, y2, y;
+
+	if (cmd->bitmapDataLength < cmd->width * cmd->height * 4)
+		return;
+
+	stride = cairo_format_stride_for_width(rfi->cairo_format, rfi->width);
+
+	x1 = MAX(cmd->destLeft, 0);
+	y1 = MAX(cmd->destTop, 0);
+	x2 = MIN(cmd->destLeft + cmd->width, rfi->width);
+	y2 = MIN(cmd->destTop + cmd->height, rfi->height);
+	if (x1 >= x2 || y1 >= y2)
+		return;
+
+	for (y = y1; y < y2; y++)
+	{
+		src = cmd->bitmapData + ((cmd->height - 1 - (y - cmd->destTop)) * cmd->width + (x1 - cmd->destLeft)) * 4;
+		dst = rfi->primary_buffer + y * stride + x1 * 4;
+		memcpy(dst, src, (x2 - x1) * 4);
+	}
+}
+
+static void rf_gdi_queue_update_region(rfContext* rfi, gint x, gint y, gint width, gint height)
+{
+	TRACE_CALL("rf_gdi_queue_update_region");
+	RemminaPluginRdpUiObject* ui;
+
+	ui = rf_object_new(rfi->protocol_widget);
+	ui->type = REMMINA_RDP_UI_UPDATE_REGION;
+	ui->region.x = x;
+	ui->region.y = y;
+	ui->region.width = width;
+	ui->region.height = height;
+
+	rf_queue_ui(rfi->protocol_widget, ui);
+}
+
+/* Everything is written into the primary buffer here on the rdp thread, in order
+ * with the GDI orders. Only 32bpp RemoteFX and uncompressed bitmaps are handled
+ * directly, the rest goes to the FreeRDP gdi which also converts other depths */
 static void rf_gdi_surface_bits(rdpContext* context, SURFACE_BITS_COMMAND* surface_bits_command)
 {
 	TRACE_CALL("rf_gdi_surface_bits");
-	UINT8* bitmap;
 	RFX_MESSAGE* message;
-	RemminaPluginRdpUiObject* ui;
+	RFX_RECT* rect;
 	rfContext* rfi = (rfContext*) context;
+	gint i;
+
+	if (rfi->bpp != 32 || !rfi->primary_buffer)
+	{
+		if (rfi->gdi_surface_bits)
+			rfi->gdi_surface_bits(context, surface_bits_command);
+		return;
+	}
 
 	if (surface_bits_command->codecID == RDP_CODEC_ID_REMOTEFX && rfi->rfx_context)
 	{
 		message = rfx_process_message(rfi->rfx_context, surface_bits_command->bitmapData,
 				surface_bits_command->bitmapDataLength);
 
-		ui = g_new0(RemminaPluginRdpUiObject, 1);
-		ui->type = REMMINA_RDP_UI_RFX;
-		ui->rfx.left = surface_bits_command->destLeft;
-		ui->rfx.top = surface_bits_command->destTop;
-		ui->rfx.message = message;
+		if (!message)
+			return;
 
-		rf_queue_ui(rfi->protocol_widget, ui);
+		rf_gdi_rfx_composite_message(rfi, message, surface_bits_command->destLeft, surface_bits_command->destTop);
+
+		for (i = 0; i < message->numRects; i++)
+		{
+			rect = &message->rects[i];
+			rf_gdi_queue_update_region(rfi, surface_bits_command->destLeft + rect->x,
+					surface_bits_command->destTop + rect->y, rect->width, rect->height);
+		}
+
+		rfx_message_free(rfi->rfx_context, message);
 	}
-	else if (surface_bits_command->codecID == RDP_CODEC_ID_NONE)
+	else if (surface_bits_command->codecID == RDP_CODEC_ID_NONE && surface_bits_command->bpp == 32)
 	{
-		bitmap = (UINT8*) calloc(1, surface_bits_command->width * surface_bits_command->height * 4);
+		rf_gdi_nocodec_composite(rfi, surface_bits_command);
+		rf_gdi_queue_update_region(rfi, surface_bits_command->destLeft, surface_bits_command->destTop,
+				surface_bits_command->width, surface_bits_command->height);
+	}
+	else if (rfi->gdi_surface_bits)
+	{
+		rfi->gdi_surface_bits(context, surface_bits_command);
+	}
+}
 
-		freerdp_image_flip(surface_bits_command->bitmapData, bitmap,
-				surface_bits_command->width, surface_bits_command->height, 32);
+/* Only replaces the SurfaceBits handler of the FreeRDP software gdi, which is
+ * kept for the codecs and depths handled there */
+void rf_gdi_register_surface_bits_callback(rdpUpdate* update)
+{
+	TRACE_CALL("rf_gdi_register_surface_bits_callback");
+	rfContext* rfi = (rfContext*) update->context;
 
-		ui = g_new0(RemminaPluginRdpUiObject, 1);
-		ui->type = REMMINA_RDP_UI_NOCODEC;
-		ui->nocodec.left = surface_bits_command->destLeft;
-		ui->nocodec.top = surface_bits_command->destTop;
-		ui->nocodec.width = surface_bits_command->width;
-		ui->nocodec.height = surface_bits_command->height;
-		ui->nocodec.bitmap = bitmap;
+	rfi->gdi_surface_bits = update->SurfaceBits;
+	update->SurfaceBits = rf_gdi_surface_bits;
+}
 
-		rf_queue_ui(rfi->protocol_widget, ui);
-	}
-	else
+void rf_gdi_rfx_pool_init(rfContext* rfi)
+{
+	TRACE_CALL("rf_gdi_rfx_pool_init");
+
+	rfi->rfx_threads = remmina_rdp_settings_get_rfx_threads();
+
+	/* The rdp thread always composites one slice itself */
+	if (rfi->rfx_threads > 1)
+		rfi->rfx_pool = g_thread_pool_new(rf_gdi_rfx_worker, NULL, rfi->rfx_threads - 1, FALSE, NULL);
+}
+
+void rf_gdi_rfx_pool_free(rfContext* rfi)
+{
+	TRACE_CALL("rf_gdi_rfx_pool_free");
+
+	if (rfi->rfx_pool)
 	{
-		printf("Unsupported codecID %d\n", surface_bits_command->codecID);
+		g_thread_pool_free(rfi->rfx_pool, FALSE, TRUE);
+		rfi->rfx_pool = NULL;
 	}
 }
 
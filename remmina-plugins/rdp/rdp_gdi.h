@@ -40,6 +40,9 @@
 G_BEGIN_DECLS
 
 void rf_gdi_register_update_callbacks(rdpUpdate* update);
+void rf_gdi_register_surface_bits_callback(rdpUpdate* update);
+void rf_gdi_rfx_pool_init(rfContext* rfi);
+void rf_gdi_rfx_pool_free(rfContext* rfi);
 
 G_END_DECLS
 
@@ -193,7 +193,7 @@ void rf_Pointer_New(rdpContext* context, rdpPointer* pointer)
 
 	if ((pointer->andMaskData != 0) && (pointer->xorMaskData != 0))
 	{
-		ui = g_new0(RemminaPluginRdpUiObject, 1);
+		ui = rf_object_new(rfi->protocol_widget);
 		ui->type = REMMINA_RDP_UI_CURSOR;
 		ui->sync = TRUE;	// Also wait for completion
 		ui->cursor.pointer = (rfPointer*) pointer;
@@ -215,7 +215,7 @@ void rf_Pointer_Free(rdpContext* context, rdpPointer* pointer)
 	if (G_IS_OBJECT(((rfPointer*) pointer)->cursor))
 #endif
 	{
-		ui = g_new0(RemminaPluginRdpUiObject, 1);
+		ui = rf_object_new(rfi->protocol_widget);
 		ui->type = REMMINA_RDP_UI_CURSOR;
 		ui->sync = TRUE;	// Also wait for completion
 		ui->cursor.pointer = (rfPointer*) pointer;
@@ -231,7 +231,7 @@ void rf_Pointer_Set(rdpContext* context, rdpPointer* pointer)
 	RemminaPluginRdpUiObject* ui;
 	rfContext* rfi = (rfContext*) context;
 
-	ui = g_new0(RemminaPluginRdpUiObject, 1);
+	ui = rf_object_new(rfi->protocol_widget);
 	ui->type = REMMINA_RDP_UI_CURSOR;
 	ui->sync = TRUE;	// Also wait for completion
 	ui->cursor.pointer = (rfPointer*) pointer;
@@ -246,7 +246,7 @@ void rf_Pointer_SetNull(rdpContext* context)
 	RemminaPluginRdpUiObject* ui;
 	rfContext* rfi = (rfContext*) context;
 
-	ui = g_new0(RemminaPluginRdpUiObject, 1);
+	ui = rf_object_new(rfi->protocol_widget);
 	ui->type = REMMINA_RDP_UI_CURSOR;
 	ui->sync = TRUE;	// Also wait for completion
 	ui->cursor.type = REMMINA_RDP_POINTER_NULL;
@@ -260,7 +260,7 @@ void rf_Pointer_SetDefault(rdpContext* context)
 	RemminaPluginRdpUiObject* ui;
 	rfContext* rfi = (rfContext*) context;
 
-	ui = g_new0(RemminaPluginRdpUiObject, 1);
+	ui = rf_object_new(rfi->protocol_widget);
 	ui->type = REMMINA_RDP_UI_CURSOR;
 	ui->sync = TRUE;	// Also wait for completion
 	ui->cursor.type = REMMINA_RDP_POINTER_DEFAULT;
@@ -44,6 +44,13 @@
 
 #include <errno.h>
 #include <pthread.h>
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#include <sys/stat.h>
+#endif
+#ifdef HAVE_SYS_TIMERFD_H
+#include <sys/timerfd.h>
+#endif
 #include <cairo/cairo-xlib.h>
 #include <freerdp/freerdp.h>
 #include <freerdp/constants.h>
@@ -81,14 +88,34 @@ BOOL rf_check_fds(RemminaProtocolWidget* gp)
 	rdpInput* input;
 	rfContext* rfi = GET_PLUGIN_DATA(gp);
 	RemminaPluginRdpEvent* event;
+	RemminaPluginRdpEvent* motion;
 
 	if (rfi->event_queue == NULL)
 		return True;
 
 	input = rfi->instance->input;
 
+	/* A plain pointer motion is held back until the next event is known:
+	 * if that is another motion the held one is dropped, otherwise it is
+	 * sent first, so buttons and keys keep their order */
+	motion = NULL;
 	while ((event =(RemminaPluginRdpEvent*) g_async_queue_try_pop(rfi->event_queue)) != NULL)
 	{
+		if (event->type == REMMINA_RDP_EVENT_TYPE_MOUSE && event->mouse_event.flags == PTR_FLAGS_MOVE)
+		{
+			if (motion)
+				rf_pool_release(&rfi->event_pool, motion);
+			motion = event;
+			continue;
+		}
+		if (motion)
+		{
+			input->MouseEvent(input, motion->mouse_event.flags,
+					motion->mouse_event.x, motion->mouse_event.y);
+			rf_pool_release(&rfi->event_pool, motion);
+			motion = NULL;
+		}
+
 		switch (event->type)
 		{
 			case REMMINA_RDP_EVENT_TYPE_SCANCODE:
@@ -103,7 +130,14 @@ BOOL rf_check_fds(RemminaProtocolWidget* gp)
 				break;
 		}
 
-		g_free(event);
+		rf_pool_release(&rfi->event_pool, event);
+	}
+
+	if (motion)
+	{
+		input->MouseEvent(input, motion->mouse_event.flags,
+				motion->mouse_event.x, motion->mouse_event.y);
+		rf_pool_release(&rfi->event_pool, motion);
 	}
 
 	if (read(rfi->event_pipe[0], buf, sizeof (buf)))
@@ -140,6 +174,25 @@ void rf_queue_ui(RemminaProtocolWidget* gp, RemminaPluginRdpUiObject* ui)
 	}
 }
 
+static void rf_pool_log(rfPool* pool, const gchar* name)
+{
+	TRACE_CALL("rf_pool_log");
+
+	if (pool->allocated > 0)
+	{
+		remmina_plugin_service->log_printf("[RDP] %s pool: %u allocations, peak of %u objects in use\n",
+				name, pool->allocated, pool->peak);
+	}
+}
+
+RemminaPluginRdpUiObject* rf_object_new(RemminaProtocolWidget* gp)
+{
+	TRACE_CALL("rf_object_new");
+	rfContext* rfi = GET_PLUGIN_DATA(gp);
+
+	return (RemminaPluginRdpUiObject*) rf_pool_alloc(&rfi->ui_pool);
+}
+
 void rf_object_free(RemminaProtocolWidget* gp, RemminaPluginRdpUiObject* obj)
 {
 	TRACE_CALL("rf_object_free");
@@ -159,7 +212,7 @@ void rf_object_free(RemminaProtocolWidget* gp, RemminaPluginRdpUiObject* obj)
 			break;
 	}
 
-	g_free(obj);
+	rf_pool_release(&rfi->ui_pool, obj);
 }
 
 void rf_begin_paint(rdpContext* context)
@@ -192,7 +245,7 @@ void rf_end_paint(rdpContext* context)
 	w = gdi->primary->hdc->hwnd->invalid->w;
 	h = gdi->primary->hdc->hwnd->invalid->h;
 
-	ui = g_new0(RemminaPluginRdpUiObject, 1);
+	ui = rf_object_new(gp);
 	ui->type = REMMINA_RDP_UI_UPDATE_REGION;
 	ui->region.x = x;
 	ui->region.y = y;
@@ -221,7 +274,7 @@ static void rf_desktop_resize(rdpContext* context)
 
 	/* Call to remmina_rdp_event_update_scale(gp) on the main UI thread */
 
-	ui = g_new0(RemminaPluginRdpUiObject, 1);
+	ui = rf_object_new(gp);
 	ui->sync = TRUE;	// Wait for completion too
 	ui->type = REMMINA_RDP_UI_EVENT;
 	ui->event.type = REMMINA_RDP_UI_EVENT_UPDATE_SCALE;
@@ -363,13 +416,19 @@ static BOOL remmina_rdp_post_connect(freerdp* instance)
 	instance->update->EndPaint = rf_end_paint;
 	instance->update->DesktopResize = rf_desktop_resize;
 
+	if (rfi->rfx_context)
+	{
+		rf_gdi_rfx_pool_init(rfi);
+		rf_gdi_register_surface_bits_callback(instance->update);
+	}
+
 	remmina_rdp_clipboard_init(rfi);
 	freerdp_channels_post_connect(instance->context->channels, instance);
 	rfi->connected = True;
 
 	remmina_plugin_service->protocol_plugin_emit_signal(gp, "connect");
 
-	ui = g_new0(RemminaPluginRdpUiObject, 1);
+	ui = rf_object_new(gp);
 	ui->type = REMMINA_RDP_UI_CONNECTED;
 	rf_queue_ui(gp, ui);
 
@@ -474,16 +533,16 @@ static int remmina_rdp_receive_channel_data(freerdp* instance, int channelId, UI
 	return freerdp_channels_data(instance, channelId, data, size, flags, total_size);
 }
 
-static void remmina_rdp_main_loop(RemminaProtocolWidget* gp)
+static void remmina_rdp_main_loop_select(RemminaProtocolWidget* gp)
 {
-	TRACE_CALL("remmina_rdp_main_loop");
+	TRACE_CALL("remmina_rdp_main_loop_select");
 	int i;
 	int fds;
 	int rcount;
 	int wcount;
 	int max_fds;
-	void *rfds[32];
-	void *wfds[32];
+	void *rfds[REMMINA_RDP_MAX_FDS];
+	void *wfds[REMMINA_RDP_MAX_FDS];
 	fd_set rfds_set;
 	fd_set wfds_set;
 	rfContext* rfi = GET_PLUGIN_DATA(gp);
@@ -551,6 +610,7 @@ static void remmina_rdp_main_loop(RemminaProtocolWidget* gp)
 				break;
 			}
 		}
+		rfi->loop_wakeups++;
 
 		/* check the libfreerdp fds */
 		if (!freerdp_check_fds(rfi->instance))
@@ -570,6 +630,255 @@ static void remmina_rdp_main_loop(RemminaProtocolWidget* gp)
 	}
 }
 
+#ifdef HAVE_SYS_EPOLL_H
+typedef struct remmina_plugin_rdp_loop
+{
+	int epfd;
+	int timerfd;
+	/* Descriptors currently registered, with the file each one referred to */
+	int nfds;
+	int fds[REMMINA_RDP_MAX_FDS * 2];
+	uint32_t events[REMMINA_RDP_MAX_FDS * 2];
+	dev_t devs[REMMINA_RDP_MAX_FDS * 2];
+	ino_t inos[REMMINA_RDP_MAX_FDS * 2];
+} RemminaPluginRdpLoop;
+
+static void remmina_rdp_main_loop_cleanup(gpointer data)
+{
+	RemminaPluginRdpLoop* loop = (RemminaPluginRdpLoop*) data;
+
+	/* May run on cancellation, so nothing but close() here */
+	if (loop->timerfd != -1)
+		close(loop->timerfd);
+	if (loop->epfd != -1)
+		close(loop->epfd);
+}
+
+static void remmina_rdp_main_loop_add(int* fds, uint32_t* events, int* nfds, int fd, uint32_t event)
+{
+	int i;
+
+	/* The same descriptor may be waited on for reading and writing */
+	for (i = 0; i < *nfds; i++)
+	{
+		if (fds[i] == fd)
+		{
+			events[i] |= event;
+			return;
+		}
+	}
+	fds[*nfds] = fd;
+	events[*nfds] = event;
+	(*nfds)++;
+}
+
+static gboolean remmina_rdp_main_loop_register(RemminaPluginRdpLoop* loop, void** rfds, int rcount, void** wfds, int wcount)
+{
+	TRACE_CALL("remmina_rdp_main_loop_register");
+	int i;
+	int nfds;
+	int fds[REMMINA_RDP_MAX_FDS * 2];
+	uint32_t events[REMMINA_RDP_MAX_FDS * 2];
+	dev_t devs[REMMINA_RDP_MAX_FDS * 2];
+	ino_t inos[REMMINA_RDP_MAX_FDS * 2];
+	struct epoll_event ev;
+	struct stat st;
+
+	nfds = 0;
+	for (i = 0; i < rcount; i++)
+		remmina_rdp_main_loop_add(fds, events, &nfds, GPOINTER_TO_INT(rfds[i]), EPOLLIN);
+	for (i = 0; i < wcount; i++)
+		remmina_rdp_main_loop_add(fds, events, &nfds, GPOINTER_TO_INT(wfds[i]), EPOLLOUT);
+
+	/* A descriptor number FreeRDP closed and reused between two wakeups
+	 * looks the same, but refers to another file that epoll has not seen */
+	for (i = 0; i < nfds; i++)
+	{
+		if (fstat(fds[i], &st) == 0)
+		{
+			devs[i] = st.st_dev;
+			inos[i] = st.st_ino;
+		}
+		else
+		{
+			devs[i] = 0;
+			inos[i] = 0;
+		}
+	}
+
+	/* Most wakeups see the same descriptors as the previous one */
+	if (nfds == loop->nfds &&
+		memcmp(fds, loop->fds, nfds * sizeof(int)) == 0 &&
+		memcmp(events, loop->events, nfds * sizeof(uint32_t)) == 0 &&
+		memcmp(devs, loop->devs, nfds * sizeof(dev_t)) == 0 &&
+		memcmp(inos, loop->inos, nfds * sizeof(ino_t)) == 0)
+	{
+		return TRUE;
+	}
+
+	/* Closed descriptors already left the set, so errors are expected here */
+	for (i = 0; i < loop->nfds; i++)
+		epoll_ctl(loop->epfd, EPOLL_CTL_DEL, loop->fds[i], NULL);
+	loop->nfds = 0;
+
+	for (i = 0; i < nfds; i++)
+	{
+		memset(&ev, 0, sizeof(ev));
+		ev.events = events[i];
+		ev.data.fd = fds[i];
+		if (epoll_ctl(loop->epfd, EPOLL_CTL_ADD, fds[i], &ev) == -1 &&
+			(errno != EEXIST || epoll_ctl(loop->epfd, EPOLL_CTL_MOD, fds[i], &ev) == -1))
+		{
+			remmina_plugin_service->log_printf("[RDP] Error registering descriptor %d: %s\n", fds[i], g_strerror(errno));
+			return FALSE;
+		}
+	}
+
+	memcpy(loop->fds, fds, nfds * sizeof(int));
+	memcpy(loop->events, events, nfds * sizeof(uint32_t));
+	memcpy(loop->devs, devs, nfds * sizeof(dev_t));
+	memcpy(loop->inos, inos, nfds * sizeof(ino_t));
+	loop->nfds = nfds;
+
+	return TRUE;
+}
+
+static void remmina_rdp_main_loop(RemminaProtocolWidget* gp)
+{
+	TRACE_CALL("remmina_rdp_main_loop");
+	int i;
+	int n;
+	int rcount;
+	int wcount;
+	void *rfds[REMMINA_RDP_MAX_FDS];
+	void *wfds[REMMINA_RDP_MAX_FDS];
+	struct epoll_event events[REMMINA_RDP_MAX_FDS];
+	RemminaPluginRdpLoop loop;
+	gboolean fallback = FALSE;
+	rfContext* rfi = GET_PLUGIN_DATA(gp);
+#ifdef HAVE_SYS_TIMERFD_H
+	struct epoll_event ev;
+	struct itimerspec tick;
+	uint64_t expirations;
+#endif
+
+	rdpChannels *channels;
+
+	loop.epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (loop.epfd == -1)
+	{
+		remmina_rdp_main_loop_select(gp);
+		return;
+	}
+	loop.timerfd = -1;
+	loop.nfds = 0;
+
+#ifdef HAVE_SYS_TIMERFD_H
+	/* Periodic wakeup: the check functions run even when no descriptor fires */
+	loop.timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (loop.timerfd != -1)
+	{
+		tick.it_interval.tv_sec = REMMINA_RDP_LOOP_TICK / 1000;
+		tick.it_interval.tv_nsec = (REMMINA_RDP_LOOP_TICK % 1000) * 1000000;
+		tick.it_value = tick.it_interval;
+		timerfd_settime(loop.timerfd, 0, &tick, NULL);
+
+		memset(&ev, 0, sizeof(ev));
+		ev.events = EPOLLIN;
+		ev.data.fd = loop.timerfd;
+		epoll_ctl(loop.epfd, EPOLL_CTL_ADD, loop.timerfd, &ev);
+	}
+#endif
+
+	memset(rfds, 0, sizeof(rfds));
+	memset(wfds, 0, sizeof(wfds));
+
+	channels = rfi->instance->context->channels;
+
+	pthread_cleanup_push(remmina_rdp_main_loop_cleanup, &loop);
+
+	while (!freerdp_shall_disconnect(rfi->instance))
+	{
+		rcount = 0;
+		wcount = 0;
+
+		if (!freerdp_get_fds(rfi->instance, rfds, &rcount, wfds, &wcount))
+		{
+			break;
+		}
+		if (!freerdp_channels_get_fds(channels, rfi->instance, rfds, &rcount, wfds, &wcount))
+		{
+			break;
+		}
+		rf_get_fds(gp, rfds, &rcount);
+
+		/* exit if nothing to do */
+		if (rcount + wcount == 0)
+		{
+			break;
+		}
+
+		/* epoll failing is no reason to end the session, select() takes over */
+		if (!remmina_rdp_main_loop_register(&loop, rfds, rcount, wfds, wcount))
+		{
+			fallback = TRUE;
+			break;
+		}
+
+		/* do the wait */
+		n = epoll_wait(loop.epfd, events, G_N_ELEMENTS(events), -1);
+		if (n == -1 && errno != EINTR)
+		{
+			remmina_plugin_service->log_printf("[RDP] Error waiting for descriptors: %s\n", g_strerror(errno));
+			fallback = TRUE;
+			break;
+		}
+		rfi->loop_wakeups++;
+
+		for (i = 0; i < n; i++)
+		{
+			if (events[i].data.fd == loop.timerfd)
+			{
+#ifdef HAVE_SYS_TIMERFD_H
+				(void) read(loop.timerfd, &expirations, sizeof(expirations));
+#endif
+			}
+		}
+
+		/* check the libfreerdp fds */
+		if (!freerdp_check_fds(rfi->instance))
+		{
+			break;
+		}
+		/* check channel fds */
+		if (!freerdp_channels_check_fds(channels, rfi->instance))
+		{
+			break;
+		}
+		/* check ui */
+		if (!rf_check_fds(gp))
+		{
+			break;
+		}
+	}
+
+	pthread_cleanup_pop(1);
+
+	if (fallback)
+	{
+		remmina_plugin_service->log_printf("[RDP] Falling back to select() for the session loop\n");
+		remmina_rdp_main_loop_select(gp);
+	}
+}
+#else
+static void remmina_rdp_main_loop(RemminaProtocolWidget* gp)
+{
+	TRACE_CALL("remmina_rdp_main_loop");
+
+	remmina_rdp_main_loop_select(gp);
+}
+#endif
+
 int remmina_rdp_load_static_channel_addin(rdpChannels* channels, rdpSettings* settings, char* name, void* data)
 {
 	TRACE_CALL("remmina_rdp_load_static_channel_addin");
@@ -969,7 +1278,8 @@ static gboolean remmina_rdp_main(RemminaProtocolWidget* gp)
 	}
 
 
-
+	rfi->loop_wakeups = 0;
+	rfi->loop_start = g_get_monotonic_time();
 	remmina_rdp_main_loop(gp);
 
 	return TRUE;
@@ -1063,6 +1373,12 @@ static gboolean remmina_rdp_close_connection(RemminaProtocolWidget* gp)
 		if (rfi->thread)
 			pthread_join(rfi->thread, NULL);
 
+		if (rfi->loop_start > 0 && g_get_monotonic_time() > rfi->loop_start)
+		{
+			remmina_plugin_service->log_printf("[RDP] Main loop: %u wakeups, %.1f per second\n",
+					rfi->loop_wakeups,
+					(gdouble) rfi->loop_wakeups * G_USEC_PER_SEC / (g_get_monotonic_time() - rfi->loop_start));
+		}
 	}
 
 	pthread_mutex_destroy(&rfi->mutex);
@@ -1082,6 +1398,8 @@ static gboolean remmina_rdp_close_connection(RemminaProtocolWidget* gp)
 
 	remmina_rdp_clipboard_free(rfi);
 
+	rf_gdi_rfx_pool_free(rfi);
+
 	if (rfi->rfx_context)
 	{
 		rfx_context_free(rfi->rfx_context);
@@ -1098,6 +1416,13 @@ static gboolean remmina_rdp_close_connection(RemminaProtocolWidget* gp)
 			instance->context->channels = NULL;
 		}
 
+		/* Disconnecting still runs callbacks which take UI objects, the pools live
+		 * in the context and go away with it */
+		rf_pool_log(&rfi->ui_pool, "UI object");
+		rf_pool_clear(&rfi->ui_pool);
+		rf_pool_log(&rfi->event_pool, "Input event");
+		rf_pool_clear(&rfi->event_pool);
+
 		freerdp_context_free(instance); /* context is rfContext* rfi */
 		freerdp_free(instance);
 		rfi->instance = NULL;
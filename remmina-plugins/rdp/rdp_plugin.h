@@ -49,6 +49,8 @@
 
 #include <winpr/clipboard.h>
 
+#include "rdp_pool.h"
+
 typedef struct rf_context rfContext;
 
 #define LOCK_BUFFER(t)	  	if (t) {CANCEL_DEFER} pthread_mutex_lock(&rfi->mutex);
@@ -61,6 +63,20 @@ typedef struct rf_context rfContext;
 #define DEFAULT_QUALITY_2	0x01
 #define DEFAULT_QUALITY_9	0x80
 
+/* Upper bound of the RemoteFX compositing workers, 0 in the settings means one per core */
+#define REMMINA_RDP_RFX_MAX_THREADS	16
+
+/* Number of converted cursor shapes kept for reuse */
+#define REMMINA_RDP_CURSOR_CACHE_SIZE	32
+/* The cursor cache hit rate is logged every this many lookups */
+#define REMMINA_RDP_CURSOR_CACHE_LOG	256
+/* Time in microseconds a single idle dispatch may spend draining the UI queue */
+#define REMMINA_RDP_UI_QUEUE_BUDGET	4000
+/* Room for the descriptors FreeRDP and its channels wait on at once */
+#define REMMINA_RDP_MAX_FDS	256
+/* Interval in milliseconds of the periodic checks done by the main loop */
+#define REMMINA_RDP_LOOP_TICK	1000
+
 extern RemminaPluginService* remmina_plugin_service;
 
 
@@ -132,6 +148,10 @@ struct rf_context
 	gchar rdpsnd_options[20];
 
 	RFX_CONTEXT* rfx_context;
+	GThreadPool* rfx_pool;
+	gint rfx_threads;
+	/* SurfaceBits handler of the FreeRDP gdi, for what rf_gdi_surface_bits leaves to it */
+	pSurfaceBits gdi_surface_bits;
 
 	gboolean connected;
 
@@ -161,14 +181,26 @@ struct rf_context
 	guint object_id_seq;
 	GHashTable* object_table;
 
+	/* Converted cursors by shape, most recently used first in cursor_lru */
+	GHashTable* cursor_cache;
+	GQueue* cursor_lru;
+	guint cursor_hits;
+	guint cursor_misses;
+
 	GAsyncQueue* ui_queue;
 	guint ui_handler;
+	rfPool ui_pool;
+
 
 
+	/* Main loop statistics, logged at disconnection */
+	guint loop_wakeups;
+	gint64 loop_start;
 
 	GArray* pressed_keys;
 	GAsyncQueue* event_queue;
 	gint event_pipe[2];
+	rfPool event_pool;
 
 	rfClipboard clipboard;
 };
@@ -287,6 +319,7 @@ void rf_uninit(RemminaProtocolWidget* gp);
 void rf_get_fds(RemminaProtocolWidget* gp, void** rfds, int* rcount);
 BOOL rf_check_fds(RemminaProtocolWidget* gp);
 void rf_queue_ui(RemminaProtocolWidget* gp, RemminaPluginRdpUiObject* ui);
+RemminaPluginRdpUiObject* rf_object_new(RemminaProtocolWidget* gp);
 void rf_object_free(RemminaProtocolWidget* gp, RemminaPluginRdpUiObject* obj);
 
 #endif
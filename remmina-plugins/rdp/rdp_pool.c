@@ -0,0 +1,123 @@
+/*
+ * Remmina - The GTK+ Remote Desktop Client
+ * Copyright (C) 2010-2011 Vic Lee 
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, 
+ * Boston, MA  02110-1301, USA.
+ *
+ *  In addition, as a special exception, the copyright holders give
+ *  permission to link the code of portions of this program with the
+ *  OpenSSL library under certain conditions as described in each
+ *  individual source file, and distribute linked combinations
+ *  including the two.
+ *  You must obey the GNU General Public License in all respects
+ *  for all of the code used other than OpenSSL. *  If you modify
+ *  file(s) with this exception, you may extend this exception to your
+ *  version of the file(s), but you are not obligated to do so. *  If you
+ *  do not wish to do so, delete this exception statement from your
+ *  version. *  If you delete this exception statement from all source
+ *  files in the program, then also delete it here.
+ *
+ */
+
+#include <string.h>
+#include "remmina/remmina_trace_calls.h"
+#include "rdp_pool.h"
+
+void rf_pool_init(rfPool* pool, gsize size)
+{
+	TRACE_CALL("rf_pool_init");
+
+	pthread_mutex_init(&pool->mutex, NULL);
+	/* Free objects are chained through their first bytes */
+	pool->size = MAX(size, sizeof(gpointer));
+	pool->free_list = NULL;
+	pool->free_count = 0;
+	pool->in_use = 0;
+	pool->peak = 0;
+	pool->allocated = 0;
+}
+
+gpointer rf_pool_alloc(rfPool* pool)
+{
+	TRACE_CALL("rf_pool_alloc");
+	gpointer obj;
+	int cancel_state;
+
+	/* The rdp thread is cancelled asynchronously, never while holding the pool */
+	pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &cancel_state);
+	pthread_mutex_lock(&pool->mutex);
+
+	obj = pool->free_list;
+	if (obj)
+	{
+		pool->free_list = *(gpointer*) obj;
+		pool->free_count--;
+	}
+	else
+	{
+		pool->allocated++;
+	}
+	pool->in_use++;
+	pool->peak = MAX(pool->peak, pool->in_use);
+
+	pthread_mutex_unlock(&pool->mutex);
+	pthread_setcancelstate(cancel_state, NULL);
+
+	if (obj)
+		memset(obj, 0, pool->size);
+	else
+		obj = g_malloc0(pool->size);
+
+	return obj;
+}
+
+void rf_pool_release(rfPool* pool, gpointer obj)
+{
+	TRACE_CALL("rf_pool_release");
+	int cancel_state;
+
+	pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &cancel_state);
+	pthread_mutex_lock(&pool->mutex);
+
+	pool->in_use--;
+	if (pool->free_count < REMMINA_RDP_POOL_MAX_FREE)
+	{
+		*(gpointer*) obj = pool->free_list;
+		pool->free_list = obj;
+		pool->free_count++;
+		obj = NULL;
+	}
+
+	pthread_mutex_unlock(&pool->mutex);
+	pthread_setcancelstate(cancel_state, NULL);
+
+	g_free(obj);
+}
+
+void rf_pool_clear(rfPool* pool)
+{
+	TRACE_CALL("rf_pool_clear");
+	gpointer obj;
+
+	while ((obj = pool->free_list) != NULL)
+	{
+		pool->free_list = *(gpointer*) obj;
+		g_free(obj);
+	}
+	pool->free_count = 0;
+
+	pthread_mutex_destroy(&pool->mutex);
+}
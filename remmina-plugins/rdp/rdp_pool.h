@@ -0,0 +1,66 @@
+/*
+ * Remmina - The GTK+ Remote Desktop Client
+ * Copyright (C) 2010-2011 Vic Lee 
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, 
+ * Boston, MA  02110-1301, USA.
+ *
+ *  In addition, as a special exception, the copyright holders give
+ *  permission to link the code of portions of this program with the
+ *  OpenSSL library under certain conditions as described in each
+ *  individual source file, and distribute linked combinations
+ *  including the two.
+ *  You must obey the GNU General Public License in all respects
+ *  for all of the code used other than OpenSSL. *  If you modify
+ *  file(s) with this exception, you may extend this exception to your
+ *  version of the file(s), but you are not obligated to do so. *  If you
+ *  do not wish to do so, delete this exception statement from your
+ *  version. *  If you delete this exception statement from all source
+ *  files in the program, then also delete it here.
+ *
+ */
+
+#ifndef __REMMINA_RDP_POOL_H__
+#define __REMMINA_RDP_POOL_H__
+
+#include <glib.h>
+#include <pthread.h>
+
+G_BEGIN_DECLS
+
+/* Released objects kept for reuse by each rfPool, the rest goes back to the heap */
+#define REMMINA_RDP_POOL_MAX_FREE	128
+
+/* Free list of fixed size objects shared by the rdp and the GTK thread */
+struct rf_pool
+{
+	pthread_mutex_t mutex;
+	gsize size;
+	gpointer free_list;
+	guint free_count;
+	guint in_use;
+	guint peak;
+	guint allocated;
+};
+typedef struct rf_pool rfPool;
+
+void rf_pool_init(rfPool* pool, gsize size);
+gpointer rf_pool_alloc(rfPool* pool);
+void rf_pool_release(rfPool* pool, gpointer obj);
+void rf_pool_clear(rfPool* pool);
+
+G_END_DECLS
+
+#endif /* __REMMINA_RDP_POOL_H__ */
@@ -0,0 +1,216 @@
+/*
+ * Remmina - The GTK+ Remote Desktop Client
+ * Copyright (C) 2010-2011 Vic Lee 
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, 
+ * Boston, MA  02110-1301, USA.
+ *
+ *  In addition, as a special exception, the copyright holders give
+ *  permission to link the code of portions of this program with the
+ *  OpenSSL library under certain conditions as described in each
+ *  individual source file, and distribute linked combinations
+ *  including the two.
+ *  You must obey the GNU General Public License in all respects
+ *  for all of the code used other than OpenSSL. *  If you modify
+ *  file(s) with this exception, you may extend this exception to your
+ *  version of the file(s), but you are not obligated to do so. *  If you
+ *  do not wish to do so, delete this exception statement from your
+ *  version. *  If you delete this exception statement from all source
+ *  files in the program, then also delete it here.
+ *
+ */
+
+/* Drives the pools of UI objects and input events the way a session does:
+ * objects taken by the rdp thread and given back by the GTK one with a bounded
+ * number in flight. Checks on the allocated and peak counters that a steady
+ * state stops allocating once the pool is warm, that a burst past the free
+ * list only costs what does not fit in it, and that reused objects are zeroed. */
+
+#include <stdio.h>
+#include <string.h>
+#include <glib.h>
+#include "rdp_pool.h"
+
+#define REMMINA_RDP_TEST_OBJECT_SIZE 200
+#define REMMINA_RDP_TEST_ROUNDS 10000
+/* Objects in flight in the steady state, below REMMINA_RDP_POOL_MAX_FREE */
+#define REMMINA_RDP_TEST_IN_FLIGHT 64
+/* Objects in flight during a burst, past REMMINA_RDP_POOL_MAX_FREE */
+#define REMMINA_RDP_TEST_BURST 300
+/* Objects passed from the producer to the consumer thread */
+#define REMMINA_RDP_TEST_PASSED 1000000
+
+/* Reused objects found dirty, only the first one is reported */
+static gint uncleared;
+
+static gint remmina_rdp_test_check(const gchar* name, rfPool* pool, guint allocated, guint peak, guint in_use)
+{
+	if (pool->allocated == allocated && pool->peak == peak && pool->in_use == in_use)
+		return 0;
+	printf("%s: %u allocations, peak of %u, %u in use instead of %u, %u, %u, WRONG\n", name,
+			pool->allocated, pool->peak, pool->in_use, allocated, peak, in_use);
+	return 1;
+}
+
+/* Takes count objects, scribbles over them and gives them all back */
+static gint remmina_rdp_test_round(rfPool* pool, gint count)
+{
+	gpointer objs[REMMINA_RDP_TEST_BURST];
+	guchar zero[REMMINA_RDP_TEST_OBJECT_SIZE];
+	gint errors = 0;
+	gint i;
+
+	memset(zero, 0, sizeof(zero));
+	for (i = 0; i < count; i++)
+	{
+		objs[i] = rf_pool_alloc(pool);
+		if (memcmp(objs[i], zero, sizeof(zero)) != 0 && !errors)
+		{
+			if (!uncleared++)
+				printf("round: object handed out without being cleared, WRONG\n");
+			errors++;
+		}
+		memset(objs[i], 0xa5, REMMINA_RDP_TEST_OBJECT_SIZE);
+	}
+	for (i = 0; i < count; i++)
+		rf_pool_release(pool, objs[i]);
+	return errors;
+}
+
+static gint remmina_rdp_test_steady(void)
+{
+	rfPool pool;
+	gint errors = 0;
+	gint i;
+
+	rf_pool_init(&pool, REMMINA_RDP_TEST_OBJECT_SIZE);
+
+	errors += remmina_rdp_test_round(&pool, REMMINA_RDP_TEST_IN_FLIGHT);
+	errors += remmina_rdp_test_check("steady warm up", &pool, REMMINA_RDP_TEST_IN_FLIGHT, REMMINA_RDP_TEST_IN_FLIGHT, 0);
+
+	for (i = 0; i < REMMINA_RDP_TEST_ROUNDS; i++)
+		errors += remmina_rdp_test_round(&pool, REMMINA_RDP_TEST_IN_FLIGHT);
+	errors += remmina_rdp_test_check("steady", &pool, REMMINA_RDP_TEST_IN_FLIGHT, REMMINA_RDP_TEST_IN_FLIGHT, 0);
+	printf("steady: %u allocations for %d objects taken\n", pool.allocated,
+			(REMMINA_RDP_TEST_ROUNDS + 1) * REMMINA_RDP_TEST_IN_FLIGHT);
+
+	rf_pool_clear(&pool);
+	return errors;
+}
+
+/* Only REMMINA_RDP_POOL_MAX_FREE objects are kept, the rest of a burst is allocated again every time */
+static gint remmina_rdp_test_burst(void)
+{
+	rfPool pool;
+	gint errors = 0;
+	guint allocated;
+
+	rf_pool_init(&pool, REMMINA_RDP_TEST_OBJECT_SIZE);
+
+	errors += remmina_rdp_test_round(&pool, REMMINA_RDP_TEST_BURST);
+	errors += remmina_rdp_test_check("burst", &pool, REMMINA_RDP_TEST_BURST, REMMINA_RDP_TEST_BURST, 0);
+	if (pool.free_count != REMMINA_RDP_POOL_MAX_FREE)
+	{
+		printf("burst: %u objects kept instead of %d, WRONG\n", pool.free_count, REMMINA_RDP_POOL_MAX_FREE);
+		errors++;
+	}
+
+	allocated = pool.allocated;
+	errors += remmina_rdp_test_round(&pool, REMMINA_RDP_TEST_BURST);
+	errors += remmina_rdp_test_check("second burst", &pool,
+			allocated + REMMINA_RDP_TEST_BURST - REMMINA_RDP_POOL_MAX_FREE, REMMINA_RDP_TEST_BURST, 0);
+
+	/* Back to a steady state under the free list size: nothing more is allocated */
+	allocated = pool.allocated;
+	errors += remmina_rdp_test_round(&pool, REMMINA_RDP_TEST_IN_FLIGHT);
+	errors += remmina_rdp_test_check("after burst", &pool, allocated, REMMINA_RDP_TEST_BURST, 0);
+
+	rf_pool_clear(&pool);
+	return errors;
+}
+
+typedef struct _RemminaRdpTestPassing
+{
+	rfPool pool;
+	GAsyncQueue* queue;
+	/* Objects the consumer gave back, the producer waits when too many are in flight */
+	gint released;
+} RemminaRdpTestPassing;
+
+static gpointer remmina_rdp_test_consumer(gpointer data)
+{
+	RemminaRdpTestPassing* passing = (RemminaRdpTestPassing*) data;
+	gint i;
+
+	for (i = 0; i < REMMINA_RDP_TEST_PASSED; i++)
+	{
+		rf_pool_release(&passing->pool, g_async_queue_pop(passing->queue));
+		g_atomic_int_inc(&passing->released);
+	}
+	return NULL;
+}
+
+/* Taken on one thread and given back on another, as UI objects and input events are */
+static gint remmina_rdp_test_passing(void)
+{
+	RemminaRdpTestPassing passing;
+	GThread* thread;
+	gint64 start;
+	gint errors = 0;
+	gint i;
+
+	rf_pool_init(&passing.pool, REMMINA_RDP_TEST_OBJECT_SIZE);
+	passing.queue = g_async_queue_new();
+	passing.released = 0;
+
+	start = g_get_monotonic_time();
+	thread = g_thread_new("consumer", remmina_rdp_test_consumer, &passing);
+	for (i = 0; i < REMMINA_RDP_TEST_PASSED; i++)
+	{
+		while (i - g_atomic_int_get(&passing.released) >= REMMINA_RDP_TEST_IN_FLIGHT)
+			g_thread_yield();
+		g_async_queue_push(passing.queue, rf_pool_alloc(&passing.pool));
+	}
+	g_thread_join(thread);
+
+	if (passing.pool.in_use != 0)
+	{
+		printf("passing: %u objects still in use, WRONG\n", passing.pool.in_use);
+		errors++;
+	}
+	if (passing.pool.peak > REMMINA_RDP_TEST_IN_FLIGHT || passing.pool.allocated > passing.pool.peak)
+	{
+		printf("passing: %u allocations, peak of %u with at most %d in flight, WRONG\n",
+				passing.pool.allocated, passing.pool.peak, REMMINA_RDP_TEST_IN_FLIGHT);
+		errors++;
+	}
+	printf("passing: %u allocations for %d objects passed in %.2f s\n", passing.pool.allocated,
+			REMMINA_RDP_TEST_PASSED, (g_get_monotonic_time() - start) / 1000000.0);
+
+	g_async_queue_unref(passing.queue);
+	rf_pool_clear(&passing.pool);
+	return errors;
+}
+
+int main(int argc, char* argv[])
+{
+	gint errors = 0;
+
+	errors += remmina_rdp_test_steady();
+	errors += remmina_rdp_test_burst();
+	errors += remmina_rdp_test_passing();
+
+	return errors ? 1 : 0;
+}
@@ -36,9 +36,11 @@
 #include "rdp_plugin.h"
 #include "rdp_settings.h"
 #include <freerdp/locale/keyboard.h>
+#include <unistd.h>
 
 static guint keyboard_layout = 0;
 static guint rdp_keyboard_layout = 0;
+static gint rdp_rfx_threads = 0;
 
 static void remmina_rdp_settings_kbd_init(void)
 {
@@ -58,6 +60,13 @@ void remmina_rdp_settings_init(void)
 
 	g_free(value);
 
+	value = remmina_plugin_service->pref_get_value("rdp_rfx_threads");
+
+	if (value && value[0])
+		rdp_rfx_threads = CLAMP(atoi(value), 0, REMMINA_RDP_RFX_MAX_THREADS);
+
+	g_free(value);
+
 	remmina_rdp_settings_kbd_init();
 }
 
@@ -67,6 +76,17 @@ guint remmina_rdp_settings_get_keyboard_layout(void)
 	return keyboard_layout;
 }
 
+gint remmina_rdp_settings_get_rfx_threads(void)
+{
+	TRACE_CALL("remmina_rdp_settings_get_rfx_threads");
+
+	/* 0 means automatic: one worker per core */
+	if (rdp_rfx_threads > 0)
+		return rdp_rfx_threads;
+
+	return CLAMP(sysconf(_SC_NPROCESSORS_ONLN), 1, REMMINA_RDP_RFX_MAX_THREADS);
+}
+
 #define REMMINA_TYPE_PLUGIN_RDPSET_GRID		(remmina_rdp_settings_grid_get_type())
 #define REMMINA_RDPSET_GRID(obj)			(G_TYPE_CHECK_INSTANCE_CAST((obj), REMMINA_TYPE_PLUGIN_RDPSET_GRID, RemminaPluginRdpsetGrid))
 #define REMMINA_RDPSET_GRID_CLASS(klass)		(G_TYPE_CHECK_CLASS_CAST((klass), REMMINA_TYPE_PLUGIN_RDPSET_GRID, RemminaPluginRdpsetGridClass))
@@ -93,6 +113,7 @@ typedef struct _RemminaPluginRdpsetGrid
 	GtkWidget* fontsmoothing_check;
 	GtkWidget* composition_check;
 	GtkWidget* use_client_keymap_check;
+	GtkWidget* rfx_threads_spin;
 
 	guint quality_values[10];
 } RemminaPluginRdpsetGrid;
@@ -154,6 +175,11 @@ static void remmina_rdp_settings_grid_destroy(GtkWidget* widget, gpointer data)
 	s = g_strdup_printf("%X", grid->quality_values[9]);
 	remmina_plugin_service->pref_set_value("rdp_quality_9", s);
 	g_free(s);
+
+	rdp_rfx_threads = gtk_spin_button_get_value_as_int(GTK_SPIN_BUTTON(grid->rfx_threads_spin));
+	s = g_strdup_printf("%d", rdp_rfx_threads);
+	remmina_plugin_service->pref_set_value("rdp_rfx_threads", s);
+	g_free(s);
 }
 
 static void remmina_rdp_settings_grid_load_layout(RemminaPluginRdpsetGrid* grid)
@@ -418,6 +444,19 @@ static void remmina_rdp_settings_grid_init(RemminaPluginRdpsetGrid *grid)
 		G_CALLBACK(remmina_rdp_settings_quality_option_on_toggled), grid);
 	grid->composition_check = widget;
 
+	widget = gtk_label_new(_("RemoteFX threads"));
+	gtk_widget_show(widget);
+	gtk_misc_set_alignment(GTK_MISC(widget), 0.0, 0.5);
+	gtk_grid_attach(GTK_GRID(grid), widget, 0, 27, 1, 1);
+
+	/* 0 = one thread per core */
+	widget = gtk_spin_button_new_with_range(0, REMMINA_RDP_RFX_MAX_THREADS, 1);
+	gtk_spin_button_set_value(GTK_SPIN_BUTTON(widget), rdp_rfx_threads);
+	gtk_widget_set_tooltip_text(widget, _("Threads used to draw RemoteFX tiles, 0 for one per CPU core"));
+	gtk_widget_show(widget);
+	gtk_grid_attach(GTK_GRID(grid), widget, 1, 27, 1, 1);
+	grid->rfx_threads_spin = widget;
+
 	gtk_combo_box_set_active(GTK_COMBO_BOX (grid->quality_combo), 0);
 }
 
@@ -39,6 +39,7 @@ G_BEGIN_DECLS
 
 void remmina_rdp_settings_init(void);
 guint remmina_rdp_settings_get_keyboard_layout(void);
+gint remmina_rdp_settings_get_rfx_threads(void);
 GtkWidget* remmina_rdp_settings_new(void);
 
 G_END_DECLS
@@ -0,0 +1,65 @@
+/*
+ * Remmina - The GTK+ Remote Desktop Client
+ * Copyright (C) 2014-2015 Antenore Gatta, Fabio Castelli, Giovanni Panozzo
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ *
+ *  In addition, as a special exception, the copyright holders give
+ *  permission to link the code of portions of this program with the
+ *  OpenSSL library under certain conditions as described in each
+ *  individual source file, and distribute linked combinations
+ *  including the two.
+ *  You must obey the GNU General Public License in all respects
+ *  for all of the code used other than OpenSSL. *  If you modify
+ *  file(s) with this exception, you may extend this exception to your
+ *  version of the file(s), but you are not obligated to do so. *  If you
+ *  do not wish to do so, delete this exception statement from your
+ *  version. *  If you delete this exception statement from all source
+ *  files in the program, then also delete it here.
+ *
+ */
+/* Damage accumulated by the VNC thread is handed to GTK as a region. Every
+ * rectangle costs a clip and a composite, so a region split in many pieces is
+ * cheaper to redraw as its bounding box. */
+
+#include "remmina/remmina_trace_calls.h"
+#include "vnc_damage.h"
+
+void remmina_plugin_vnc_damage_coalesce(cairo_region_t *region)
+{
+	TRACE_CALL("remmina_plugin_vnc_damage_coalesce");
+	cairo_rectangle_int_t extents, rect;
+	gint64 area;
+	gint i, n;
+
+	n = cairo_region_num_rectangles(region);
+	if (n <= 1)
+		return;
+
+	cairo_region_get_extents(region, &extents);
+	if (n <= REMMINA_PLUGIN_VNC_DAMAGE_MAX_RECTS)
+	{
+		area = 0;
+		for (i = 0; i < n; i++)
+		{
+			cairo_region_get_rectangle(region, i, &rect);
+			area += (gint64) rect.width * rect.height;
+		}
+		if (area * 100 < (gint64) extents.width * extents.height * REMMINA_PLUGIN_VNC_DAMAGE_MAX_COVERAGE)
+			return;
+	}
+	cairo_region_union_rectangle(region, &extents);
+}
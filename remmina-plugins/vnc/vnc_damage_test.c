@@ -0,0 +1,220 @@
+/*
+ * Remmina - The GTK+ Remote Desktop Client
+ * Copyright (C) 2014-2015 Antenore Gatta, Fabio Castelli, Giovanni Panozzo
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ *
+ *  In addition, as a special exception, the copyright holders give
+ *  permission to link the code of portions of this program with the
+ *  OpenSSL library under certain conditions as described in each
+ *  individual source file, and distribute linked combinations
+ *  including the two.
+ *  You must obey the GNU General Public License in all respects
+ *  for all of the code used other than OpenSSL. *  If you modify
+ *  file(s) with this exception, you may extend this exception to your
+ *  version of the file(s), but you are not obligated to do so. *  If you
+ *  do not wish to do so, delete this exception statement from your
+ *  version. *  If you delete this exception statement from all source
+ *  files in the program, then also delete it here.
+ *
+ */
+
+/* Replays synthetic update patterns through the damage coalescing of the VNC
+ * plugin: the VNC thread adds the damage of each server message to the pending
+ * region, GTK takes it every few messages. Checks that nothing damaged is left
+ * out and prints the pixels and rectangles repainted against the exact damage. */
+
+#include <stdio.h>
+#include <string.h>
+#include "vnc_damage.h"
+
+#define REMMINA_VNC_TEST_WIDTH 1920
+#define REMMINA_VNC_TEST_HEIGHT 1080
+#define REMMINA_VNC_TEST_MESSAGES 200
+
+typedef struct _RemminaPluginVncTestRun
+{
+	cairo_region_t *pending;
+	cairo_region_t *exact;
+	gint64 exact_pixels;
+	gint64 repainted_pixels;
+	gint repainted_rects;
+	gint draws;
+	gint uncovered;
+} RemminaPluginVncTestRun;
+
+typedef void (*RemminaPluginVncTestPattern)(gint message, cairo_region_t *damage);
+
+static gint64 remmina_plugin_vnc_test_area(const cairo_region_t *region)
+{
+	cairo_rectangle_int_t rect;
+	gint64 area = 0;
+	gint i;
+
+	for (i = 0; i < cairo_region_num_rectangles(region); i++)
+	{
+		cairo_region_get_rectangle(region, i, &rect);
+		area += (gint64) rect.width * rect.height;
+	}
+	return area;
+}
+
+static void remmina_plugin_vnc_test_rect(cairo_region_t *damage, gint x, gint y, gint width, gint height)
+{
+	cairo_rectangle_int_t rect;
+
+	rect.x = x;
+	rect.y = y;
+	rect.width = width;
+	rect.height = height;
+	cairo_region_union_rectangle(damage, &rect);
+}
+
+/* What remmina_plugin_vnc_queue_draw_area_real() hands to GTK */
+static void remmina_plugin_vnc_test_draw(RemminaPluginVncTestRun *run)
+{
+	cairo_region_t *missed;
+
+	missed = cairo_region_copy(run->exact);
+	cairo_region_subtract(missed, run->pending);
+	if (!cairo_region_is_empty(missed))
+		run->uncovered++;
+	cairo_region_destroy(missed);
+
+	run->exact_pixels += remmina_plugin_vnc_test_area(run->exact);
+	run->repainted_pixels += remmina_plugin_vnc_test_area(run->pending);
+	run->repainted_rects += cairo_region_num_rectangles(run->pending);
+	run->draws++;
+	cairo_region_subtract(run->pending, run->pending);
+	cairo_region_subtract(run->exact, run->exact);
+}
+
+static void remmina_plugin_vnc_test_run(const gchar *name, RemminaPluginVncTestPattern pattern, gint drain,
+		RemminaPluginVncTestRun *run)
+{
+	cairo_region_t *damage;
+	gint message;
+
+	memset(run, 0, sizeof(RemminaPluginVncTestRun));
+	run->pending = cairo_region_create();
+	run->exact = cairo_region_create();
+	damage = cairo_region_create();
+
+	for (message = 0; message < REMMINA_VNC_TEST_MESSAGES; message++)
+	{
+		/* As remmina_plugin_vnc_queue_draw_region() on each published frame */
+		cairo_region_subtract(damage, damage);
+		pattern(message, damage);
+		cairo_region_union(run->exact, damage);
+		cairo_region_union(run->pending, damage);
+		remmina_plugin_vnc_damage_coalesce(run->pending);
+		if ((message + 1) % drain == 0)
+			remmina_plugin_vnc_test_draw(run);
+	}
+	if (!cairo_region_is_empty(run->pending))
+		remmina_plugin_vnc_test_draw(run);
+
+	cairo_region_destroy(damage);
+	cairo_region_destroy(run->pending);
+	cairo_region_destroy(run->exact);
+
+	printf("%s: %d draws, %" G_GINT64_FORMAT " pixels damaged, %" G_GINT64_FORMAT " repainted (%.2fx) in %d rectangles%s\n",
+			name, run->draws, run->exact_pixels, run->repainted_pixels,
+			(gdouble) run->repainted_pixels / MAX(run->exact_pixels, 1), run->repainted_rects,
+			run->uncovered ? ", DAMAGE LEFT OUT" : "");
+}
+
+/* A caret and the character typed next to it, with a clock in the corner */
+static void remmina_plugin_vnc_test_typing(gint message, cairo_region_t *damage)
+{
+	remmina_plugin_vnc_test_rect(damage, 100 + (message % 150) * 10, 500, 12, 20);
+	if (message % 50 == 0)
+		remmina_plugin_vnc_test_rect(damage, 1850, 1060, 60, 20);
+}
+
+/* A window scrolling, sent as strips */
+static void remmina_plugin_vnc_test_scroll(gint message, cairo_region_t *damage)
+{
+	gint y;
+
+	for (y = 100; y < 900; y += 32)
+		remmina_plugin_vnc_test_rect(damage, 300, y, 1200, 32);
+}
+
+/* A video playing while the pointer moves elsewhere */
+static void remmina_plugin_vnc_test_video(gint message, cairo_region_t *damage)
+{
+	remmina_plugin_vnc_test_rect(damage, 200, 200, 640, 360);
+	remmina_plugin_vnc_test_rect(damage, 1200 + (message % 40) * 10, 800, 16, 16);
+}
+
+/* Small changes all over the screen, as a desktop with many animated icons */
+static void remmina_plugin_vnc_test_scattered(gint message, cairo_region_t *damage)
+{
+	guint seed = 12345 + message;
+	gint i;
+
+	for (i = 0; i < 48; i++)
+	{
+		seed = seed * 1103515245 + 12345;
+		remmina_plugin_vnc_test_rect(damage, (seed >> 8) % (REMMINA_VNC_TEST_WIDTH - 16),
+				(seed >> 20) % (REMMINA_VNC_TEST_HEIGHT - 16), 16, 16);
+	}
+}
+
+/* Most tiles of one area, as a tiled encoder sends a changing picture */
+static void remmina_plugin_vnc_test_tiles(gint message, cairo_region_t *damage)
+{
+	gint tx, ty;
+
+	for (ty = 0; ty < 8; ty++)
+	{
+		for (tx = 0; tx < 8; tx++)
+		{
+			if ((tx + ty * 8 + message) % 5 != 0)
+				remmina_plugin_vnc_test_rect(damage, 640 + tx * 64, 256 + ty * 64, 64, 64);
+		}
+	}
+}
+
+int main(int argc, char **argv)
+{
+	RemminaPluginVncTestRun run;
+	gint errors = 0;
+
+	/* Far apart small rectangles stay apart */
+	remmina_plugin_vnc_test_run("typing", remmina_plugin_vnc_test_typing, 4, &run);
+	errors += run.uncovered || run.repainted_pixels != run.exact_pixels;
+
+	/* Strips of one area end up as that area */
+	remmina_plugin_vnc_test_run("scroll", remmina_plugin_vnc_test_scroll, 1, &run);
+	errors += run.uncovered || run.repainted_pixels != run.exact_pixels || run.repainted_rects != run.draws;
+
+	remmina_plugin_vnc_test_run("video", remmina_plugin_vnc_test_video, 2, &run);
+	errors += run.uncovered || run.repainted_pixels != run.exact_pixels;
+
+	/* Too many pieces: one box per draw, whatever it costs in pixels */
+	remmina_plugin_vnc_test_run("scattered", remmina_plugin_vnc_test_scattered, 2, &run);
+	errors += run.uncovered || run.repainted_rects != run.draws ||
+			run.repainted_pixels > (gint64) run.draws * REMMINA_VNC_TEST_WIDTH * REMMINA_VNC_TEST_HEIGHT;
+
+	/* Mostly covered: one box, within the coverage threshold */
+	remmina_plugin_vnc_test_run("tiles", remmina_plugin_vnc_test_tiles, 1, &run);
+	errors += run.uncovered || run.repainted_rects != run.draws ||
+			run.repainted_pixels * REMMINA_PLUGIN_VNC_DAMAGE_MAX_COVERAGE > run.exact_pixels * 100;
+
+	return errors ? 1 : 0;
+}
@@ -0,0 +1,237 @@
+/*
+ * Remmina - The GTK+ Remote Desktop Client
+ * Copyright (C) 2014-2015 Antenore Gatta, Fabio Castelli, Giovanni Panozzo
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ *
+ *  In addition, as a special exception, the copyright holders give
+ *  permission to link the code of portions of this program with the
+ *  OpenSSL library under certain conditions as described in each
+ *  individual source file, and distribute linked combinations
+ *  including the two.
+ *  You must obey the GNU General Public License in all respects
+ *  for all of the code used other than OpenSSL. *  If you modify
+ *  file(s) with this exception, you may extend this exception to your
+ *  version of the file(s), but you are not obligated to do so. *  If you
+ *  do not wish to do so, delete this exception statement from your
+ *  version. *  If you delete this exception statement from all source
+ *  files in the program, then also delete it here.
+ *
+ */
+
+/* Paints the desktop the way the draw callback does while another thread
+ * floods it with full screen updates, as the VNC thread does during a video,
+ * and prints the latency histogram of the paints. Unscaled sessions share the
+ * buffer lock with the updates, scaled ones swap published frames instead. */
+
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <cairo.h>
+#include "vnc_histogram.h"
+
+#define REMMINA_VNC_TEST_WIDTH 1920
+#define REMMINA_VNC_TEST_HEIGHT 1080
+#define REMMINA_VNC_TEST_SCALED_WIDTH 1280
+#define REMMINA_VNC_TEST_SCALED_HEIGHT 720
+#define REMMINA_VNC_TEST_DRAWS 400
+#define REMMINA_VNC_TEST_FRAMES 3
+#define REMMINA_VNC_TEST_FRESH 0x100
+#define REMMINA_VNC_TEST_INDEX 0x0ff
+
+typedef struct _RemminaPluginVncTestStorm
+{
+	pthread_mutex_t buffer_mutex;
+	/* Unscaled: the desktop, written under buffer_mutex */
+	cairo_surface_t *rgb_buffer;
+	/* Scaled: frames handed over through frame_ready */
+	cairo_surface_t *frames[REMMINA_VNC_TEST_FRAMES];
+	gint frame_back;
+	gint frame_front;
+	gint frame_ready;
+	gboolean scaled;
+	gint stop;
+	gint updates;
+} RemminaPluginVncTestStorm;
+
+static void remmina_plugin_vnc_test_fill(cairo_surface_t *surface, gint update)
+{
+	guchar *data;
+	gint stride, height, y;
+
+	cairo_surface_flush(surface);
+	data = cairo_image_surface_get_data(surface);
+	stride = cairo_image_surface_get_stride(surface);
+	height = cairo_image_surface_get_height(surface);
+	for (y = 0; y < height; y++)
+		memset(data + y * stride, (update + y) & 0xff, stride);
+	cairo_surface_mark_dirty(surface);
+}
+
+/* The VNC thread side: one full screen update after another */
+static gpointer remmina_plugin_vnc_test_storm(gpointer data)
+{
+	RemminaPluginVncTestStorm *storm = data;
+	gint ready;
+
+	while (!g_atomic_int_get(&storm->stop))
+	{
+		pthread_mutex_lock(&storm->buffer_mutex);
+		if (storm->scaled)
+		{
+			/* Every pixel changes, so the new back frame needs no catching up */
+			remmina_plugin_vnc_test_fill(storm->frames[storm->frame_back], storm->updates);
+			do
+			{
+				ready = g_atomic_int_get(&storm->frame_ready);
+			} while (!g_atomic_int_compare_and_exchange(&storm->frame_ready, ready,
+					storm->frame_back | REMMINA_VNC_TEST_FRESH));
+			storm->frame_back = ready & REMMINA_VNC_TEST_INDEX;
+		}
+		else
+		{
+			remmina_plugin_vnc_test_fill(storm->rgb_buffer, storm->updates);
+		}
+		pthread_mutex_unlock(&storm->buffer_mutex);
+		g_atomic_int_inc(&storm->updates);
+	}
+	return NULL;
+}
+
+/* The GTK thread side, as remmina_plugin_vnc_paint() */
+static void remmina_plugin_vnc_test_paint(RemminaPluginVncTestStorm *storm, cairo_t *context)
+{
+	gint ready;
+
+	cairo_set_operator(context, CAIRO_OPERATOR_SOURCE);
+	if (!storm->scaled)
+	{
+		pthread_mutex_lock(&storm->buffer_mutex);
+		cairo_set_source_surface(context, storm->rgb_buffer, 0, 0);
+		cairo_paint(context);
+		pthread_mutex_unlock(&storm->buffer_mutex);
+		return;
+	}
+
+	ready = g_atomic_int_get(&storm->frame_ready);
+	if (ready & REMMINA_VNC_TEST_FRESH)
+	{
+		while (!g_atomic_int_compare_and_exchange(&storm->frame_ready, ready, storm->frame_front))
+			ready = g_atomic_int_get(&storm->frame_ready);
+		storm->frame_front = ready & REMMINA_VNC_TEST_INDEX;
+	}
+	cairo_set_source_surface(context, storm->frames[storm->frame_front], 0, 0);
+	cairo_paint(context);
+}
+
+static gint remmina_plugin_vnc_test_draw(gboolean scaled)
+{
+	RemminaPluginVncTestStorm storm;
+	RemminaPluginVncHistogram histogram;
+	cairo_surface_t *window;
+	cairo_t *context;
+	pthread_t thread;
+	gint64 start;
+	gchar *summary;
+	gint width, height, i;
+
+	width = scaled ? REMMINA_VNC_TEST_SCALED_WIDTH : REMMINA_VNC_TEST_WIDTH;
+	height = scaled ? REMMINA_VNC_TEST_SCALED_HEIGHT : REMMINA_VNC_TEST_HEIGHT;
+
+	memset(&storm, 0, sizeof(storm));
+	pthread_mutex_init(&storm.buffer_mutex, NULL);
+	storm.scaled = scaled;
+	if (scaled)
+	{
+		for (i = 0; i < REMMINA_VNC_TEST_FRAMES; i++)
+			storm.frames[i] = cairo_image_surface_create(CAIRO_FORMAT_RGB24, width, height);
+		storm.frame_back = 0;
+		storm.frame_front = 1;
+		storm.frame_ready = 2;
+	}
+	else
+	{
+		storm.rgb_buffer = cairo_image_surface_create(CAIRO_FORMAT_RGB24, width, height);
+	}
+	window = cairo_image_surface_create(CAIRO_FORMAT_RGB24, width, height);
+	context = cairo_create(window);
+
+	remmina_plugin_vnc_histogram_reset(&histogram);
+	pthread_create(&thread, NULL, remmina_plugin_vnc_test_storm, &storm);
+	for (i = 0; i < REMMINA_VNC_TEST_DRAWS; i++)
+	{
+		start = g_get_monotonic_time();
+		remmina_plugin_vnc_test_paint(&storm, context);
+		remmina_plugin_vnc_histogram_add(&histogram, g_get_monotonic_time() - start);
+	}
+	g_atomic_int_set(&storm.stop, 1);
+	pthread_join(thread, NULL);
+
+	summary = remmina_plugin_vnc_histogram_to_string(&histogram);
+	printf("%s %dx%d, %d updates: %s\n", scaled ? "scaled" : "unscaled", width, height, storm.updates, summary);
+	g_free(summary);
+
+	cairo_destroy(context);
+	cairo_surface_destroy(window);
+	if (storm.rgb_buffer)
+		cairo_surface_destroy(storm.rgb_buffer);
+	for (i = 0; i < REMMINA_VNC_TEST_FRAMES; i++)
+	{
+		if (storm.frames[i])
+			cairo_surface_destroy(storm.frames[i]);
+	}
+	pthread_mutex_destroy(&storm.buffer_mutex);
+
+	return histogram.count == REMMINA_VNC_TEST_DRAWS ? 0 : 1;
+}
+
+/* Known durations land in the expected buckets and percentiles */
+static gint remmina_plugin_vnc_test_buckets(void)
+{
+	RemminaPluginVncHistogram histogram;
+	gint errors = 0;
+	gint i;
+
+	remmina_plugin_vnc_histogram_reset(&histogram);
+	for (i = 0; i < 90; i++)
+		remmina_plugin_vnc_histogram_add(&histogram, 100);
+	for (i = 0; i < 9; i++)
+		remmina_plugin_vnc_histogram_add(&histogram, 5000);
+	remmina_plugin_vnc_histogram_add(&histogram, 40000000);
+
+	if (histogram.buckets[7] != 90 || histogram.buckets[13] != 9 ||
+			histogram.buckets[REMMINA_PLUGIN_VNC_HISTOGRAM_BUCKETS - 1] != 1)
+		errors++;
+	if (remmina_plugin_vnc_histogram_percentile(&histogram, 50) != 128 ||
+			remmina_plugin_vnc_histogram_percentile(&histogram, 90) != 128 ||
+			remmina_plugin_vnc_histogram_percentile(&histogram, 99) != 8192 ||
+			remmina_plugin_vnc_histogram_percentile(&histogram, 100) != 40000000)
+		errors++;
+
+	printf("buckets: %u samples%s\n", histogram.count, errors ? ", WRONG" : "");
+	return errors;
+}
+
+int main(int argc, char **argv)
+{
+	gint errors = 0;
+
+	errors += remmina_plugin_vnc_test_buckets();
+	errors += remmina_plugin_vnc_test_draw(FALSE);
+	errors += remmina_plugin_vnc_test_draw(TRUE);
+
+	return errors ? 1 : 0;
+}
@@ -0,0 +1,279 @@
+/*
+ * Remmina - The GTK+ Remote Desktop Client
+ * Copyright (C) 2014-2015 Antenore Gatta, Fabio Castelli, Giovanni Panozzo
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ *
+ *  In addition, as a special exception, the copyright holders give
+ *  permission to link the code of portions of this program with the
+ *  OpenSSL library under certain conditions as described in each
+ *  individual source file, and distribute linked combinations
+ *  including the two.
+ *  You must obey the GNU General Public License in all respects
+ *  for all of the code used other than OpenSSL. *  If you modify
+ *  file(s) with this exception, you may extend this exception to your
+ *  version of the file(s), but you are not obligated to do so. *  If you
+ *  do not wish to do so, delete this exception statement from your
+ *  version. *  If you delete this exception statement from all source
+ *  files in the program, then also delete it here.
+ *
+ */
+/* Input events travel from the GTK thread to the VNC thread through a ring of
+ * preallocated slots, with a locked list behind it for when the ring is full.
+ * Pointer motions are coalesced on the way out, only when they neither change
+ * the buttons nor are needed to keep a button change or a key event at its
+ * position in the stream. */
+
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include "remmina/remmina_trace_calls.h"
+#include "vnc_event.h"
+
+#define REMMINA_PLUGIN_VNC_EVENT_SLOT(queue, n) (&(queue)->ring[(n) & (REMMINA_PLUGIN_VNC_EVENT_RING_SIZE - 1)])
+
+gboolean remmina_plugin_vnc_event_queue_init(RemminaPluginVncEventQueue *queue)
+{
+	TRACE_CALL("remmina_plugin_vnc_event_queue_init");
+	gint flags;
+
+	queue->ring = g_new0(RemminaPluginVncEvent, REMMINA_PLUGIN_VNC_EVENT_RING_SIZE);
+	queue->head = 0;
+	queue->tail = 0;
+	pthread_mutex_init(&queue->overflow_mutex, NULL);
+	g_queue_init(&queue->overflow);
+	queue->overflow_active = 0;
+	queue->push_mask = 0;
+	queue->overflow_motion = FALSE;
+	g_queue_init(&queue->taken);
+	queue->sent_mask = 0;
+	if (pipe(queue->pipe))
+	{
+		queue->pipe[0] = -1;
+		queue->pipe[1] = -1;
+		return FALSE;
+	}
+	flags = fcntl(queue->pipe[0], F_GETFL, 0);
+	fcntl(queue->pipe[0], F_SETFL, flags | O_NONBLOCK);
+	return TRUE;
+}
+
+/* Only once the consumer thread is gone */
+void remmina_plugin_vnc_event_queue_clear(RemminaPluginVncEventQueue *queue)
+{
+	TRACE_CALL("remmina_plugin_vnc_event_queue_clear");
+	RemminaPluginVncEvent *event;
+	guint head;
+
+	for (head = (guint) queue->head; head != (guint) queue->tail; head++)
+		remmina_plugin_vnc_event_free(REMMINA_PLUGIN_VNC_EVENT_SLOT(queue, head));
+	queue->head = queue->tail;
+	g_free(queue->ring);
+	queue->ring = NULL;
+	while ((event = g_queue_pop_head(&queue->taken)) != NULL)
+	{
+		remmina_plugin_vnc_event_free(event);
+		g_free(event);
+	}
+	while ((event = g_queue_pop_head(&queue->overflow)) != NULL)
+	{
+		remmina_plugin_vnc_event_free(event);
+		g_free(event);
+	}
+	queue->overflow_active = 0;
+	pthread_mutex_destroy(&queue->overflow_mutex);
+	if (queue->pipe[0] >= 0)
+	{
+		close(queue->pipe[0]);
+		close(queue->pipe[1]);
+	}
+}
+
+/* Readable whenever events are waiting */
+gint remmina_plugin_vnc_event_queue_get_fd(RemminaPluginVncEventQueue *queue)
+{
+	TRACE_CALL("remmina_plugin_vnc_event_queue_get_fd");
+	return queue->pipe[0];
+}
+
+static void remmina_plugin_vnc_event_queue_wakeup(RemminaPluginVncEventQueue *queue)
+{
+	if (write(queue->pipe[1], "\0", 1))
+	{
+		/* Ignore */
+	}
+}
+
+/* Appends to the overflow list. A pure motion right after another one only
+ * moves it, so that a stalled consumer costs memory for button and key
+ * events alone */
+static void remmina_plugin_vnc_event_queue_push_overflow(RemminaPluginVncEventQueue *queue, const RemminaPluginVncEvent *event,
+		gboolean motion)
+{
+	RemminaPluginVncEvent *last;
+	gboolean wakeup;
+
+	pthread_mutex_lock(&queue->overflow_mutex);
+	last = g_queue_peek_tail(&queue->overflow);
+	if (motion && last && queue->overflow_motion
+			&& last->event_data.pointer.button_mask == event->event_data.pointer.button_mask)
+	{
+		last->event_data.pointer.x = event->event_data.pointer.x;
+		last->event_data.pointer.y = event->event_data.pointer.y;
+	}
+	else
+	{
+		last = g_new(RemminaPluginVncEvent, 1);
+		*last = *event;
+		g_queue_push_tail(&queue->overflow, last);
+		queue->overflow_motion = motion;
+	}
+	wakeup = !queue->overflow_active;
+	g_atomic_int_set(&queue->overflow_active, 1);
+	pthread_mutex_unlock(&queue->overflow_mutex);
+
+	if (wakeup)
+		remmina_plugin_vnc_event_queue_wakeup(queue);
+}
+
+/* Copies the event into the queue, which owns its text from now on. Returns
+ * TRUE when the ring was full and the event went to the overflow list */
+gboolean remmina_plugin_vnc_event_queue_push(RemminaPluginVncEventQueue *queue, const RemminaPluginVncEvent *event)
+{
+	TRACE_CALL("remmina_plugin_vnc_event_queue_push");
+	gboolean motion = FALSE;
+	guint head, tail;
+
+	if (event->event_type == REMMINA_PLUGIN_VNC_EVENT_POINTER)
+	{
+		motion = (event->event_data.pointer.button_mask == queue->push_mask);
+		queue->push_mask = event->event_data.pointer.button_mask;
+	}
+
+	tail = (guint) queue->tail;
+	head = (guint) g_atomic_int_get(&queue->head);
+	if (g_atomic_int_get(&queue->overflow_active) || tail - head >= REMMINA_PLUGIN_VNC_EVENT_RING_SIZE)
+	{
+		remmina_plugin_vnc_event_queue_push_overflow(queue, event, motion);
+		return TRUE;
+	}
+
+	*REMMINA_PLUGIN_VNC_EVENT_SLOT(queue, tail) = *event;
+
+	/* Publish the slot, then wake up the consumer only if it may have
+	 * already found the ring empty */
+	g_atomic_int_set(&queue->tail, (gint)(tail + 1));
+	if ((guint) g_atomic_int_get(&queue->head) == tail)
+		remmina_plugin_vnc_event_queue_wakeup(queue);
+	return FALSE;
+}
+
+/* Clears the wakeup before draining, so that a push racing with the end of
+ * the drain leaves the descriptor readable */
+void remmina_plugin_vnc_event_queue_ack(RemminaPluginVncEventQueue *queue)
+{
+	TRACE_CALL("remmina_plugin_vnc_event_queue_ack");
+	gchar buf[100];
+
+	if (read(queue->pipe[0], buf, sizeof(buf)))
+	{
+		/* Ignore */
+	}
+}
+
+/* A pointer event that keeps the buttons as they were last sent is a pure
+ * motion. It is superseded by a following pure motion, but not by a button
+ * change, which must still see the pointer arrive where the user moved it */
+static gboolean remmina_plugin_vnc_event_superseded(RemminaPluginVncEventQueue *queue, const RemminaPluginVncEvent *event,
+		const RemminaPluginVncEvent *next)
+{
+	return event->event_type == REMMINA_PLUGIN_VNC_EVENT_POINTER
+			&& event->event_data.pointer.button_mask == queue->sent_mask
+			&& next != NULL
+			&& next->event_type == REMMINA_PLUGIN_VNC_EVENT_POINTER
+			&& next->event_data.pointer.button_mask == event->event_data.pointer.button_mask;
+}
+
+/* Takes the next event to send, in order. The caller owns its text and
+ * releases it with remmina_plugin_vnc_event_free() */
+gboolean remmina_plugin_vnc_event_queue_pop(RemminaPluginVncEventQueue *queue, RemminaPluginVncEvent *event)
+{
+	TRACE_CALL("remmina_plugin_vnc_event_queue_pop");
+	RemminaPluginVncEvent *next;
+	RemminaPluginVncEvent *taken;
+	gboolean superseded;
+	gboolean overflow;
+	guint head, tail;
+
+	head = (guint) queue->head;
+	for (;;)
+	{
+		if ((taken = g_queue_pop_head(&queue->taken)) != NULL)
+		{
+			/* Taken over from the overflow list, older than anything the ring got since */
+			*event = *taken;
+			g_free(taken);
+			superseded = remmina_plugin_vnc_event_superseded(queue, event, g_queue_peek_head(&queue->taken));
+		}
+		else
+		{
+			/* Once the list is in use the producer leaves the ring alone. Seeing
+			 * it in use and then the ring empty means the ring held nothing older */
+			overflow = g_atomic_int_get(&queue->overflow_active);
+			tail = (guint) g_atomic_int_get(&queue->tail);
+			if (head == tail)
+			{
+				if (!overflow)
+					return FALSE;
+				pthread_mutex_lock(&queue->overflow_mutex);
+				queue->taken = queue->overflow;
+				g_queue_init(&queue->overflow);
+				g_atomic_int_set(&queue->overflow_active, 0);
+				pthread_mutex_unlock(&queue->overflow_mutex);
+				continue;
+			}
+
+			*event = *REMMINA_PLUGIN_VNC_EVENT_SLOT(queue, head);
+			next = (head + 1 != tail) ? REMMINA_PLUGIN_VNC_EVENT_SLOT(queue, head + 1) : NULL;
+			superseded = remmina_plugin_vnc_event_superseded(queue, event, next);
+
+			/* Hand the slot back to the producer */
+			head++;
+			g_atomic_int_set(&queue->head, (gint) head);
+		}
+
+		if (superseded)
+			continue;
+		if (event->event_type == REMMINA_PLUGIN_VNC_EVENT_POINTER)
+			queue->sent_mask = event->event_data.pointer.button_mask;
+		return TRUE;
+	}
+}
+
+void remmina_plugin_vnc_event_free(RemminaPluginVncEvent *event)
+{
+	TRACE_CALL("remmina_plugin_vnc_event_free");
+	switch (event->event_type)
+	{
+		case REMMINA_PLUGIN_VNC_EVENT_CUTTEXT:
+		case REMMINA_PLUGIN_VNC_EVENT_CHAT_SEND:
+			g_free(event->event_data.text.text);
+			event->event_data.text.text = NULL;
+			break;
+		default:
+			break;
+	}
+}
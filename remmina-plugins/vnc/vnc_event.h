@@ -0,0 +1,121 @@
+/*
+ * Remmina - The GTK+ Remote Desktop Client
+ * Copyright (C) 2014-2015 Antenore Gatta, Fabio Castelli, Giovanni Panozzo
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ *
+ *  In addition, as a special exception, the copyright holders give
+ *  permission to link the code of portions of this program with the
+ *  OpenSSL library under certain conditions as described in each
+ *  individual source file, and distribute linked combinations
+ *  including the two.
+ *  You must obey the GNU General Public License in all respects
+ *  for all of the code used other than OpenSSL. *  If you modify
+ *  file(s) with this exception, you may extend this exception to your
+ *  version of the file(s), but you are not obligated to do so. *  If you
+ *  do not wish to do so, delete this exception statement from your
+ *  version. *  If you delete this exception statement from all source
+ *  files in the program, then also delete it here.
+ *
+ */
+
+#ifndef __REMMINA_VNC_EVENT_H__
+#define __REMMINA_VNC_EVENT_H__
+
+#include <glib.h>
+#include <pthread.h>
+
+G_BEGIN_DECLS
+
+/* Capacity of the input event ring, must be a power of two */
+#define REMMINA_PLUGIN_VNC_EVENT_RING_SIZE      1024
+
+enum
+{
+	REMMINA_PLUGIN_VNC_EVENT_KEY,
+	REMMINA_PLUGIN_VNC_EVENT_POINTER,
+	REMMINA_PLUGIN_VNC_EVENT_CUTTEXT,
+	REMMINA_PLUGIN_VNC_EVENT_CHAT_OPEN,
+	REMMINA_PLUGIN_VNC_EVENT_CHAT_SEND,
+	REMMINA_PLUGIN_VNC_EVENT_CHAT_CLOSE,
+	REMMINA_PLUGIN_VNC_EVENT_QUALITY
+};
+
+typedef struct _RemminaPluginVncEvent
+{
+	gint event_type;
+	union
+	{
+		struct
+		{
+			guint keyval;
+			gboolean pressed;
+		} key;
+		struct
+		{
+			gint x;
+			gint y;
+			gint button_mask;
+		} pointer;
+		struct
+		{
+			gchar *text;
+		} text;
+		struct
+		{
+			gint quality;
+			gboolean adaptive;
+			gint quality_min;
+		} quality;
+	} event_data;
+} RemminaPluginVncEvent;
+
+/* Single producer (GTK thread), single consumer (VNC thread) queue of input
+ * events. The ring counters only grow, the slot is counter & (size - 1) */
+typedef struct _RemminaPluginVncEventQueue
+{
+	RemminaPluginVncEvent *ring;
+	gint head;
+	gint tail;
+	/* Events pushed while the ring is full, nothing is ever dropped. Once in
+	 * use the producer keeps appending there until the consumer took the list
+	 * over, so that the order is kept */
+	pthread_mutex_t overflow_mutex;
+	GQueue overflow;
+	gint overflow_active;
+	/* Producer side: button mask of the last pointer event pushed, and whether
+	 * the last event of the overflow list is a pure motion */
+	gint push_mask;
+	gboolean overflow_motion;
+	/* Consumer side: overflow events taken over, and the button mask of the
+	 * last pointer event handed out */
+	GQueue taken;
+	gint sent_mask;
+	/* Written only when the queue goes from empty to non-empty */
+	gint pipe[2];
+} RemminaPluginVncEventQueue;
+
+gboolean remmina_plugin_vnc_event_queue_init(RemminaPluginVncEventQueue *queue);
+void remmina_plugin_vnc_event_queue_clear(RemminaPluginVncEventQueue *queue);
+gint remmina_plugin_vnc_event_queue_get_fd(RemminaPluginVncEventQueue *queue);
+gboolean remmina_plugin_vnc_event_queue_push(RemminaPluginVncEventQueue *queue, const RemminaPluginVncEvent *event);
+void remmina_plugin_vnc_event_queue_ack(RemminaPluginVncEventQueue *queue);
+gboolean remmina_plugin_vnc_event_queue_pop(RemminaPluginVncEventQueue *queue, RemminaPluginVncEvent *event);
+void remmina_plugin_vnc_event_free(RemminaPluginVncEvent *event);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,445 @@
+/*
+ * Remmina - The GTK+ Remote Desktop Client
+ * Copyright (C) 2014-2015 Antenore Gatta, Fabio Castelli, Giovanni Panozzo
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ *
+ *  In addition, as a special exception, the copyright holders give
+ *  permission to link the code of portions of this program with the
+ *  OpenSSL library under certain conditions as described in each
+ *  individual source file, and distribute linked combinations
+ *  including the two.
+ *  You must obey the GNU General Public License in all respects
+ *  for all of the code used other than OpenSSL. *  If you modify
+ *  file(s) with this exception, you may extend this exception to your
+ *  version of the file(s), but you are not obligated to do so. *  If you
+ *  do not wish to do so, delete this exception statement from your
+ *  version. *  If you delete this exception statement from all source
+ *  files in the program, then also delete it here.
+ *
+ */
+
+/* Checks the ordering and the motion coalescing of the VNC input event queue
+ * on synthetic pointer traces, and measures the cost of a push, which runs on
+ * the GTK thread for every input event. */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/select.h>
+#include "vnc_event.h"
+
+#define REMMINA_VNC_TEST_MAX_EVENTS 64
+
+typedef struct _RemminaPluginVncTestTrace
+{
+	RemminaPluginVncEvent events[REMMINA_VNC_TEST_MAX_EVENTS];
+	gint n;
+} RemminaPluginVncTestTrace;
+
+static void remmina_plugin_vnc_test_pointer(RemminaPluginVncTestTrace *trace, gint x, gint y, gint mask)
+{
+	RemminaPluginVncEvent *event = &trace->events[trace->n++];
+
+	event->event_type = REMMINA_PLUGIN_VNC_EVENT_POINTER;
+	event->event_data.pointer.x = x;
+	event->event_data.pointer.y = y;
+	event->event_data.pointer.button_mask = mask;
+}
+
+static void remmina_plugin_vnc_test_key(RemminaPluginVncTestTrace *trace, guint keyval, gboolean pressed)
+{
+	RemminaPluginVncEvent *event = &trace->events[trace->n++];
+
+	event->event_type = REMMINA_PLUGIN_VNC_EVENT_KEY;
+	event->event_data.key.keyval = keyval;
+	event->event_data.key.pressed = pressed;
+}
+
+static gboolean remmina_plugin_vnc_test_same(const RemminaPluginVncEvent *a, const RemminaPluginVncEvent *b)
+{
+	if (a->event_type != b->event_type)
+		return FALSE;
+	if (a->event_type == REMMINA_PLUGIN_VNC_EVENT_KEY)
+		return a->event_data.key.keyval == b->event_data.key.keyval && a->event_data.key.pressed == b->event_data.key.pressed;
+	return a->event_data.pointer.x == b->event_data.pointer.x && a->event_data.pointer.y == b->event_data.pointer.y
+			&& a->event_data.pointer.button_mask == b->event_data.pointer.button_mask;
+}
+
+static void remmina_plugin_vnc_test_print(const gchar *what, const RemminaPluginVncEvent *event)
+{
+	if (event->event_type == REMMINA_PLUGIN_VNC_EVENT_KEY)
+		printf("  %s key %u %s\n", what, event->event_data.key.keyval, event->event_data.key.pressed ? "down" : "up");
+	else
+		printf("  %s pointer %d,%d mask %d\n", what, event->event_data.pointer.x, event->event_data.pointer.y,
+				event->event_data.pointer.button_mask);
+}
+
+/* Pushes the whole trace before draining it, as when the VNC thread is busy,
+ * and compares what comes out with the expected packets */
+static gint remmina_plugin_vnc_test_run(const gchar *name, const RemminaPluginVncTestTrace *input,
+		const RemminaPluginVncTestTrace *expected)
+{
+	RemminaPluginVncEventQueue queue;
+	RemminaPluginVncTestTrace output;
+	RemminaPluginVncEvent event;
+	gint i, errors = 0;
+
+	remmina_plugin_vnc_event_queue_init(&queue);
+	for (i = 0; i < input->n; i++)
+		remmina_plugin_vnc_event_queue_push(&queue, &input->events[i]);
+	remmina_plugin_vnc_event_queue_ack(&queue);
+	output.n = 0;
+	while (output.n < REMMINA_VNC_TEST_MAX_EVENTS && remmina_plugin_vnc_event_queue_pop(&queue, &event))
+		output.events[output.n++] = event;
+	remmina_plugin_vnc_event_queue_clear(&queue);
+
+	if (output.n != expected->n)
+		errors++;
+	for (i = 0; !errors && i < output.n; i++)
+	{
+		if (!remmina_plugin_vnc_test_same(&output.events[i], &expected->events[i]))
+			errors++;
+	}
+
+	printf("%s: %d events, %d sent%s\n", name, input->n, output.n, errors ? ", WRONG" : "");
+	if (errors)
+	{
+		for (i = 0; i < expected->n; i++)
+			remmina_plugin_vnc_test_print("expected", &expected->events[i]);
+		for (i = 0; i < output.n; i++)
+			remmina_plugin_vnc_test_print("sent", &output.events[i]);
+	}
+	return errors;
+}
+
+/* Moves to a window, drags it with the first button and lets it go */
+static gint remmina_plugin_vnc_test_drag(void)
+{
+	RemminaPluginVncTestTrace input, expected;
+	gint i;
+
+	input.n = 0;
+	for (i = 1; i <= 5; i++)
+		remmina_plugin_vnc_test_pointer(&input, i * 2, i * 2, 0);
+	remmina_plugin_vnc_test_pointer(&input, 10, 10, 1);
+	for (i = 1; i <= 20; i++)
+		remmina_plugin_vnc_test_pointer(&input, 10 + i * 2, 10 + i, 1);
+	remmina_plugin_vnc_test_pointer(&input, 50, 30, 0);
+	for (i = 1; i <= 5; i++)
+		remmina_plugin_vnc_test_pointer(&input, 50 + i, 30, 0);
+
+	/* The press and the release keep their own position, each of them
+	 * preceded by the last motion that led to it */
+	expected.n = 0;
+	remmina_plugin_vnc_test_pointer(&expected, 10, 10, 0);
+	remmina_plugin_vnc_test_pointer(&expected, 10, 10, 1);
+	remmina_plugin_vnc_test_pointer(&expected, 50, 30, 1);
+	remmina_plugin_vnc_test_pointer(&expected, 50, 30, 0);
+	remmina_plugin_vnc_test_pointer(&expected, 55, 30, 0);
+
+	return remmina_plugin_vnc_test_run("drag", &input, &expected);
+}
+
+/* A click right after a motion, then a motion right after the release */
+static gint remmina_plugin_vnc_test_click(void)
+{
+	RemminaPluginVncTestTrace input, expected;
+
+	input.n = 0;
+	remmina_plugin_vnc_test_pointer(&input, 5, 5, 0);
+	remmina_plugin_vnc_test_pointer(&input, 7, 7, 4);
+	remmina_plugin_vnc_test_pointer(&input, 8, 8, 4);
+	remmina_plugin_vnc_test_pointer(&input, 9, 9, 0);
+	remmina_plugin_vnc_test_pointer(&input, 12, 12, 0);
+
+	/* Nothing is a pure motion followed by another one */
+	expected = input;
+
+	return remmina_plugin_vnc_test_run("click", &input, &expected);
+}
+
+/* Keys typed while moving the pointer stay between the same motions */
+static gint remmina_plugin_vnc_test_keys(void)
+{
+	RemminaPluginVncTestTrace input, expected;
+	gint i;
+
+	input.n = 0;
+	for (i = 1; i <= 4; i++)
+		remmina_plugin_vnc_test_pointer(&input, i, 0, 0);
+	remmina_plugin_vnc_test_key(&input, 'a', TRUE);
+	remmina_plugin_vnc_test_key(&input, 'a', FALSE);
+	for (i = 5; i <= 8; i++)
+		remmina_plugin_vnc_test_pointer(&input, i, 0, 0);
+	remmina_plugin_vnc_test_key(&input, 'b', TRUE);
+	remmina_plugin_vnc_test_pointer(&input, 9, 0, 1);
+	remmina_plugin_vnc_test_pointer(&input, 9, 0, 0);
+	remmina_plugin_vnc_test_key(&input, 'b', FALSE);
+
+	expected.n = 0;
+	remmina_plugin_vnc_test_pointer(&expected, 4, 0, 0);
+	remmina_plugin_vnc_test_key(&expected, 'a', TRUE);
+	remmina_plugin_vnc_test_key(&expected, 'a', FALSE);
+	remmina_plugin_vnc_test_pointer(&expected, 8, 0, 0);
+	remmina_plugin_vnc_test_key(&expected, 'b', TRUE);
+	remmina_plugin_vnc_test_pointer(&expected, 9, 0, 1);
+	remmina_plugin_vnc_test_pointer(&expected, 9, 0, 0);
+	remmina_plugin_vnc_test_key(&expected, 'b', FALSE);
+
+	return remmina_plugin_vnc_test_run("keys", &input, &expected);
+}
+
+/* Keeps the ring half full across many wraps and checks the order of the keys */
+static gint remmina_plugin_vnc_test_wrap(void)
+{
+	RemminaPluginVncEventQueue queue;
+	RemminaPluginVncEvent event;
+	guint pushed = 0, popped = 0;
+	gint round, i, errors = 0;
+
+	remmina_plugin_vnc_event_queue_init(&queue);
+	for (round = 0; round < 20; round++)
+	{
+		for (i = 0; i < REMMINA_PLUGIN_VNC_EVENT_RING_SIZE / 2 + 7; i++)
+		{
+			event.event_type = REMMINA_PLUGIN_VNC_EVENT_KEY;
+			event.event_data.key.keyval = pushed++;
+			event.event_data.key.pressed = TRUE;
+			remmina_plugin_vnc_event_queue_push(&queue, &event);
+		}
+		for (i = 0; i < REMMINA_PLUGIN_VNC_EVENT_RING_SIZE / 2 && remmina_plugin_vnc_event_queue_pop(&queue, &event); i++)
+		{
+			if (event.event_data.key.keyval != popped++)
+				errors++;
+		}
+	}
+	while (remmina_plugin_vnc_event_queue_pop(&queue, &event))
+	{
+		if (event.event_data.key.keyval != popped++)
+			errors++;
+	}
+	remmina_plugin_vnc_event_queue_clear(&queue);
+
+	if (popped != pushed)
+		errors++;
+	printf("wrap: %u events, %u received in order%s\n", pushed, popped, errors ? ", WRONG" : "");
+	return errors;
+}
+
+/* Event number n of a long synthetic session: drags with the first button
+ * and typing, keys and button changes are numbered through their x or keyval */
+static void remmina_plugin_vnc_test_session_event(gint n, RemminaPluginVncEvent *event)
+{
+	switch (n % 8)
+	{
+		case 0:
+			event->event_type = REMMINA_PLUGIN_VNC_EVENT_KEY;
+			event->event_data.key.keyval = n;
+			event->event_data.key.pressed = TRUE;
+			break;
+		case 4:
+			event->event_type = REMMINA_PLUGIN_VNC_EVENT_KEY;
+			event->event_data.key.keyval = n;
+			event->event_data.key.pressed = FALSE;
+			break;
+		default:
+			event->event_type = REMMINA_PLUGIN_VNC_EVENT_POINTER;
+			event->event_data.pointer.x = n;
+			event->event_data.pointer.y = n % 8;
+			event->event_data.pointer.button_mask = (n % 16) < 8 ? 1 : 0;
+			break;
+	}
+}
+
+/* Checks that the events of remmina_plugin_vnc_test_session_event() come out
+ * in order, with every key and every button change. Returns the last event
+ * number seen, or -1 on an error */
+static gint remmina_plugin_vnc_test_session_check(const RemminaPluginVncEvent *event, gint last, gint *mask)
+{
+	RemminaPluginVncEvent expected;
+	gint n, i;
+
+	n = (event->event_type == REMMINA_PLUGIN_VNC_EVENT_KEY) ? (gint) event->event_data.key.keyval : event->event_data.pointer.x;
+	if (n <= last)
+		return -1;
+	/* Only pure motions may be missing in between */
+	for (i = last + 1; i < n; i++)
+	{
+		remmina_plugin_vnc_test_session_event(i, &expected);
+		if (expected.event_type != REMMINA_PLUGIN_VNC_EVENT_POINTER || expected.event_data.pointer.button_mask != *mask)
+			return -1;
+	}
+	remmina_plugin_vnc_test_session_event(n, &expected);
+	if (!remmina_plugin_vnc_test_same(event, &expected))
+		return -1;
+	if (event->event_type == REMMINA_PLUGIN_VNC_EVENT_POINTER)
+		*mask = event->event_data.pointer.button_mask;
+	return n;
+}
+
+/* The VNC thread does not read anything while connecting: far more events than
+ * the ring holds must all be kept, key and button releases included */
+static gint remmina_plugin_vnc_test_stalled(void)
+{
+	RemminaPluginVncEventQueue queue;
+	RemminaPluginVncEvent event;
+	gint total = 20000, sent = 0, overflowed = 0;
+	gint last = -1, mask = 0;
+	gint n;
+
+	remmina_plugin_vnc_event_queue_init(&queue);
+	for (n = 0; n < total; n++)
+	{
+		remmina_plugin_vnc_test_session_event(n, &event);
+		if (remmina_plugin_vnc_event_queue_push(&queue, &event))
+			overflowed++;
+	}
+	remmina_plugin_vnc_event_queue_ack(&queue);
+	while (last >= 0 || sent == 0)
+	{
+		if (!remmina_plugin_vnc_event_queue_pop(&queue, &event))
+			break;
+		last = remmina_plugin_vnc_test_session_check(&event, last, &mask);
+		sent++;
+	}
+	remmina_plugin_vnc_event_queue_clear(&queue);
+
+	printf("stalled: %d events, %d past the ring, %d sent%s\n", total, overflowed, sent,
+			last == total - 1 ? "" : ", WRONG");
+	return last == total - 1 ? 0 : 1;
+}
+
+typedef struct _RemminaPluginVncTestProducer
+{
+	RemminaPluginVncEventQueue *queue;
+	gint total;
+	gint overflowed;
+} RemminaPluginVncTestProducer;
+
+static gpointer remmina_plugin_vnc_test_producer(gpointer data)
+{
+	RemminaPluginVncTestProducer *producer = (RemminaPluginVncTestProducer*) data;
+	RemminaPluginVncEvent event;
+	gint n;
+
+	for (n = 0; n < producer->total; n++)
+	{
+		remmina_plugin_vnc_test_session_event(n, &event);
+		if (remmina_plugin_vnc_event_queue_push(producer->queue, &event))
+			producer->overflowed++;
+		if (n % 50000 == 0)
+			usleep(1000);
+	}
+	return NULL;
+}
+
+/* Producer and consumer run concurrently, the consumer waiting on the wakeup
+ * descriptor and sometimes stalling, as a VNC thread busy with an update */
+static gint remmina_plugin_vnc_test_threads(void)
+{
+	RemminaPluginVncEventQueue queue;
+	RemminaPluginVncTestProducer producer;
+	RemminaPluginVncEvent event;
+	pthread_t thread;
+	struct timeval timeout;
+	fd_set fds;
+	gint last = -1, mask = 0, sent = 0;
+	gint fd;
+
+	remmina_plugin_vnc_event_queue_init(&queue);
+	producer.queue = &queue;
+	producer.total = 1000000;
+	producer.overflowed = 0;
+	pthread_create(&thread, NULL, remmina_plugin_vnc_test_producer, &producer);
+
+	fd = remmina_plugin_vnc_event_queue_get_fd(&queue);
+	while (last >= 0 || sent == 0)
+	{
+		if (last == producer.total - 1)
+			break;
+		FD_ZERO(&fds);
+		FD_SET(fd, &fds);
+		timeout.tv_sec = 5;
+		timeout.tv_usec = 0;
+		if (select(fd + 1, &fds, NULL, NULL, &timeout) <= 0)
+			break;
+		remmina_plugin_vnc_event_queue_ack(&queue);
+		while (remmina_plugin_vnc_event_queue_pop(&queue, &event))
+		{
+			last = remmina_plugin_vnc_test_session_check(&event, last, &mask);
+			if (last < 0)
+				break;
+			if (++sent % 20000 == 0)
+				usleep(2000);
+		}
+	}
+	pthread_join(thread, NULL);
+	remmina_plugin_vnc_event_queue_clear(&queue);
+
+	printf("threads: %d events, %d past the ring, %d sent%s\n", producer.total, producer.overflowed, sent,
+			last == producer.total - 1 ? "" : ", WRONG");
+	return last == producer.total - 1 ? 0 : 1;
+}
+
+/* Replays a long motion trace and reports the producer cost per event */
+static void remmina_plugin_vnc_test_bench(void)
+{
+	RemminaPluginVncEventQueue queue;
+	RemminaPluginVncEvent event;
+	gint64 start, push_time = 0;
+	gint total = 0, sent = 0;
+	gint round, i;
+
+	remmina_plugin_vnc_event_queue_init(&queue);
+	for (round = 0; round < 1000; round++)
+	{
+		start = g_get_monotonic_time();
+		for (i = 0; i < 200; i++)
+		{
+			event.event_type = REMMINA_PLUGIN_VNC_EVENT_POINTER;
+			event.event_data.pointer.x = (round * 7 + i) % 1920;
+			event.event_data.pointer.y = (round * 3 + i / 2) % 1080;
+			event.event_data.pointer.button_mask = (i >= 50 && i < 150) ? 1 : 0;
+			remmina_plugin_vnc_event_queue_push(&queue, &event);
+		}
+		push_time += g_get_monotonic_time() - start;
+		total += i;
+
+		remmina_plugin_vnc_event_queue_ack(&queue);
+		while (remmina_plugin_vnc_event_queue_pop(&queue, &event))
+			sent++;
+	}
+	remmina_plugin_vnc_event_queue_clear(&queue);
+
+	printf("bench: %d pointer events, %d sent, %.1f ns per push\n", total, sent, push_time * 1000.0 / total);
+}
+
+int main(int argc, char **argv)
+{
+	gint errors = 0;
+
+	errors += remmina_plugin_vnc_test_drag();
+	errors += remmina_plugin_vnc_test_click();
+	errors += remmina_plugin_vnc_test_keys();
+	errors += remmina_plugin_vnc_test_wrap();
+	errors += remmina_plugin_vnc_test_stalled();
+	errors += remmina_plugin_vnc_test_threads();
+	remmina_plugin_vnc_test_bench();
+
+	return errors ? 1 : 0;
+}
@@ -0,0 +1,106 @@
+/*
+ * Remmina - The GTK+ Remote Desktop Client
+ * Copyright (C) 2014-2015 Antenore Gatta, Fabio Castelli, Giovanni Panozzo
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ *
+ *  In addition, as a special exception, the copyright holders give
+ *  permission to link the code of portions of this program with the
+ *  OpenSSL library under certain conditions as described in each
+ *  individual source file, and distribute linked combinations
+ *  including the two.
+ *  You must obey the GNU General Public License in all respects
+ *  for all of the code used other than OpenSSL. *  If you modify
+ *  file(s) with this exception, you may extend this exception to your
+ *  version of the file(s), but you are not obligated to do so. *  If you
+ *  do not wish to do so, delete this exception statement from your
+ *  version. *  If you delete this exception statement from all source
+ *  files in the program, then also delete it here.
+ *
+ */
+/* Power of two latency buckets: cheap enough to feed from every draw callback,
+ * fine enough to tell a frame in budget from a missed one. */
+
+#include <string.h>
+#include "remmina/remmina_trace_calls.h"
+#include "vnc_histogram.h"
+
+void remmina_plugin_vnc_histogram_reset(RemminaPluginVncHistogram *histogram)
+{
+	TRACE_CALL("remmina_plugin_vnc_histogram_reset");
+	memset(histogram, 0, sizeof(RemminaPluginVncHistogram));
+}
+
+void remmina_plugin_vnc_histogram_add(RemminaPluginVncHistogram *histogram, gint64 usec)
+{
+	gint i;
+
+	if (usec < 0)
+		usec = 0;
+	for (i = 0; i < REMMINA_PLUGIN_VNC_HISTOGRAM_BUCKETS - 1 && usec >= ((gint64) 1 << i); i++)
+		;
+	histogram->buckets[i]++;
+	histogram->count++;
+	histogram->total += usec;
+	if (usec > histogram->max)
+		histogram->max = usec;
+}
+
+gint64 remmina_plugin_vnc_histogram_percentile(const RemminaPluginVncHistogram *histogram, gint percent)
+{
+	TRACE_CALL("remmina_plugin_vnc_histogram_percentile");
+	guint64 rank, seen = 0;
+	gint i;
+
+	if (histogram->count == 0)
+		return 0;
+	/* Rank of the percentile, rounded up so that p100 is the slowest one */
+	rank = ((guint64) histogram->count * percent + 99) / 100;
+	if (rank == 0)
+		rank = 1;
+	for (i = 0; i < REMMINA_PLUGIN_VNC_HISTOGRAM_BUCKETS - 1; i++)
+	{
+		seen += histogram->buckets[i];
+		if (seen >= rank)
+			return MIN((gint64) 1 << i, histogram->max);
+	}
+	return histogram->max;
+}
+
+gchar* remmina_plugin_vnc_histogram_to_string(const RemminaPluginVncHistogram *histogram)
+{
+	TRACE_CALL("remmina_plugin_vnc_histogram_to_string");
+	GString *str;
+	gint i;
+
+	str = g_string_new(NULL);
+	g_string_append_printf(str, "%u samples, mean %" G_GINT64_FORMAT " us, p50 %" G_GINT64_FORMAT " us, p90 %"
+			G_GINT64_FORMAT " us, p99 %" G_GINT64_FORMAT " us, max %" G_GINT64_FORMAT " us",
+			histogram->count, histogram->count ? histogram->total / histogram->count : 0,
+			remmina_plugin_vnc_histogram_percentile(histogram, 50),
+			remmina_plugin_vnc_histogram_percentile(histogram, 90),
+			remmina_plugin_vnc_histogram_percentile(histogram, 99), histogram->max);
+	for (i = 0; i < REMMINA_PLUGIN_VNC_HISTOGRAM_BUCKETS; i++)
+	{
+		if (!histogram->buckets[i])
+			continue;
+		if (i < REMMINA_PLUGIN_VNC_HISTOGRAM_BUCKETS - 1)
+			g_string_append_printf(str, ", <%" G_GINT64_FORMAT ":%u", (gint64) 1 << i, histogram->buckets[i]);
+		else
+			g_string_append_printf(str, ", more:%u", histogram->buckets[i]);
+	}
+	return g_string_free(str, FALSE);
+}
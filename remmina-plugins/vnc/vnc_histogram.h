@@ -0,0 +1,62 @@
+/*
+ * Remmina - The GTK+ Remote Desktop Client
+ * Copyright (C) 2014-2015 Antenore Gatta, Fabio Castelli, Giovanni Panozzo
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ *
+ *  In addition, as a special exception, the copyright holders give
+ *  permission to link the code of portions of this program with the
+ *  OpenSSL library under certain conditions as described in each
+ *  individual source file, and distribute linked combinations
+ *  including the two.
+ *  You must obey the GNU General Public License in all respects
+ *  for all of the code used other than OpenSSL. *  If you modify
+ *  file(s) with this exception, you may extend this exception to your
+ *  version of the file(s), but you are not obligated to do so. *  If you
+ *  do not wish to do so, delete this exception statement from your
+ *  version. *  If you delete this exception statement from all source
+ *  files in the program, then also delete it here.
+ *
+ */
+#ifndef __REMMINA_VNC_HISTOGRAM_H__
+#define __REMMINA_VNC_HISTOGRAM_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Bucket i counts the durations below 2^i microseconds, the last one all the longer ones */
+#define REMMINA_PLUGIN_VNC_HISTOGRAM_BUCKETS    24
+
+/* Latency histogram, only used by one thread */
+typedef struct _RemminaPluginVncHistogram
+{
+	guint buckets[REMMINA_PLUGIN_VNC_HISTOGRAM_BUCKETS];
+	guint count;
+	gint64 total;
+	gint64 max;
+} RemminaPluginVncHistogram;
+
+void remmina_plugin_vnc_histogram_reset(RemminaPluginVncHistogram *histogram);
+void remmina_plugin_vnc_histogram_add(RemminaPluginVncHistogram *histogram, gint64 usec);
+/* Upper bound of the bucket holding the given percentile, in microseconds */
+gint64 remmina_plugin_vnc_histogram_percentile(const RemminaPluginVncHistogram *histogram, gint percent);
+/* One line summary with the non-empty buckets, to be freed with g_free() */
+gchar* remmina_plugin_vnc_histogram_to_string(const RemminaPluginVncHistogram *histogram);
+
+G_END_DECLS
+
+#endif /* __REMMINA_VNC_HISTOGRAM_H__ */
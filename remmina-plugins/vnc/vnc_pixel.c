@@ -0,0 +1,442 @@
+/*
+ * Remmina - The GTK+ Remote Desktop Client
+ * Copyright (C) 2014-2015 Antenore Gatta, Fabio Castelli, Giovanni Panozzo
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ *
+ *  In addition, as a special exception, the copyright holders give
+ *  permission to link the code of portions of this program with the
+ *  OpenSSL library under certain conditions as described in each
+ *  individual source file, and distribute linked combinations
+ *  including the two.
+ *  You must obey the GNU General Public License in all respects
+ *  for all of the code used other than OpenSSL. *  If you modify
+ *  file(s) with this exception, you may extend this exception to your
+ *  version of the file(s), but you are not obligated to do so. *  If you
+ *  do not wish to do so, delete this exception statement from your
+ *  version. *  If you delete this exception statement from all source
+ *  files in the program, then also delete it here.
+ *
+ */
+
+/* Conversion of the VNC framebuffer pixels to the CAIRO_FORMAT_RGB24 layout
+ * of the render surface, or to the RGBA layout of cursor pixbufs. Runs inside
+ * the VNC thread. The SIMD kernels are selected once at runtime from the CPU
+ * features; every kernel produces exactly the same pixels as the scalar code. */
+
+#include <string.h>
+#include "remmina/remmina_trace_calls.h"
+#include "vnc_pixel.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define REMMINA_VNC_PIXEL_X86
+#include <immintrin.h>
+#endif
+
+/* Kernels write one row of native endian 0x00RRGGBB pixels */
+typedef void (*RemminaPluginVncRowFunc)(const RemminaPluginVncConverter *conv, guint32 *dest, const guchar *src, gint w);
+
+typedef struct _RemminaPluginVncPixelImpl
+{
+	const gchar *name;
+	RemminaPluginVncRowFunc row32;
+	RemminaPluginVncRowFunc row16;
+	RemminaPluginVncRowFunc row8;
+} RemminaPluginVncPixelImpl;
+
+static gint remmina_plugin_vnc_pixel_bits(gint n)
+{
+	TRACE_CALL("remmina_plugin_vnc_pixel_bits");
+	gint b = 0;
+	while (n)
+	{
+		b++;
+		n >>= 1;
+	}
+	return b ? b : 1;
+}
+
+static guchar remmina_plugin_vnc_pixel_channel(const RemminaPluginVncPixelChannel *ch, guint32 pixel)
+{
+	guchar c;
+	gint r;
+
+	c = (guchar)((pixel >> ch->shift) & ch->max) << ch->left;
+	for (r = ch->bits; r < 8; r *= 2)
+		c |= c >> r;
+	return c;
+}
+
+/* ----------------------------- Scalar kernels ----------------------------- */
+
+static void remmina_plugin_vnc_pixel_row32_c(const RemminaPluginVncConverter *conv, guint32 *dest, const guchar *src, gint w)
+{
+	gint ix;
+
+	for (ix = 0; ix < w; ix++)
+	{
+		*dest++ = (src[2] << 16) | (src[1] << 8) | src[0];
+		src += 4;
+	}
+}
+
+static void remmina_plugin_vnc_pixel_row16_c(const RemminaPluginVncConverter *conv, guint32 *dest, const guchar *src, gint w)
+{
+	gint ix;
+
+	for (ix = 0; ix < w; ix++)
+	{
+		*dest++ = conv->lut[0][src[0]] | conv->lut[1][src[1]];
+		src += 2;
+	}
+}
+
+static void remmina_plugin_vnc_pixel_row8_c(const RemminaPluginVncConverter *conv, guint32 *dest, const guchar *src, gint w)
+{
+	gint ix;
+
+	for (ix = 0; ix < w; ix++)
+		*dest++ = conv->lut[0][*src++];
+}
+
+static void remmina_plugin_vnc_pixel_row24_c(const RemminaPluginVncConverter *conv, guint32 *dest, const guchar *src, gint w)
+{
+	gint ix;
+
+	for (ix = 0; ix < w; ix++)
+	{
+		*dest++ = conv->lut[0][src[0]] | conv->lut[1][src[1]] | conv->lut[2][src[2]];
+		src += 3;
+	}
+}
+
+/* Cursor shapes: RGBA bytes with the alpha channel taken from the mask */
+static void remmina_plugin_vnc_pixel_row_rgba_c(const RemminaPluginVncConverter *conv, guchar *dest, const guchar *src,
+		const guchar *mask, gint w)
+{
+	guint32 v;
+	gint bytesPerPixel;
+	gint ix, i;
+
+	bytesPerPixel = conv->bits_per_pixel / 8;
+	for (ix = 0; ix < w; ix++)
+	{
+		if (bytesPerPixel == 4)
+		{
+			v = (src[2] << 16) | (src[1] << 8) | src[0];
+			src += 4;
+		}
+		else
+		{
+			v = 0;
+			for (i = 0; i < bytesPerPixel; i++)
+				v |= conv->lut[i][*src++];
+		}
+		*dest++ = v >> 16;
+		*dest++ = v >> 8;
+		*dest++ = v;
+		*dest++ = (*mask++) ? 0xff : 0x00;
+	}
+}
+
+#ifdef REMMINA_VNC_PIXEL_X86
+
+/* ------------------------------ SSE2 kernels ------------------------------ */
+
+/* Expands one channel of 8 pixels held in 16 bit lanes to 8 bits */
+static inline __attribute__((target("sse2"), always_inline))
+__m128i remmina_plugin_vnc_pixel_channel_sse2(__m128i p, const RemminaPluginVncPixelChannel *ch)
+{
+	__m128i c;
+	gint r;
+
+	c = _mm_srl_epi16(p, _mm_cvtsi32_si128(ch->shift));
+	c = _mm_and_si128(c, _mm_set1_epi16(ch->max));
+	c = _mm_sll_epi16(c, _mm_cvtsi32_si128(ch->left));
+	c = _mm_and_si128(c, _mm_set1_epi16(0xff));
+	for (r = ch->bits; r < 8; r *= 2)
+		c = _mm_or_si128(c, _mm_srl_epi16(c, _mm_cvtsi32_si128(r)));
+	return c;
+}
+
+/* Converts 8 pixels held in 16 bit lanes and writes them as 8 RGB24 pixels */
+static inline __attribute__((target("sse2"), always_inline))
+void remmina_plugin_vnc_pixel_rgb16_sse2(const RemminaPluginVncConverter *conv, guint32 *dest, __m128i p)
+{
+	__m128i r, g, b, gb;
+
+	r = remmina_plugin_vnc_pixel_channel_sse2(p, &conv->channel[0]);
+	g = remmina_plugin_vnc_pixel_channel_sse2(p, &conv->channel[1]);
+	b = remmina_plugin_vnc_pixel_channel_sse2(p, &conv->channel[2]);
+	gb = _mm_or_si128(b, _mm_slli_epi16(g, 8));
+	_mm_storeu_si128((__m128i*) dest, _mm_unpacklo_epi16(gb, r));
+	_mm_storeu_si128((__m128i*) (dest + 4), _mm_unpackhi_epi16(gb, r));
+}
+
+static __attribute__((target("sse2")))
+void remmina_plugin_vnc_pixel_row32_sse2(const RemminaPluginVncConverter *conv, guint32 *dest, const guchar *src, gint w)
+{
+	const __m128i rgb = _mm_set1_epi32(0x00ffffff);
+	gint ix;
+
+	for (ix = 0; ix + 4 <= w; ix += 4)
+		_mm_storeu_si128((__m128i*) (dest + ix),
+				_mm_and_si128(_mm_loadu_si128((const __m128i*) (src + ix * 4)), rgb));
+	remmina_plugin_vnc_pixel_row32_c(conv, dest + ix, src + ix * 4, w - ix);
+}
+
+static __attribute__((target("sse2")))
+void remmina_plugin_vnc_pixel_row16_sse2(const RemminaPluginVncConverter *conv, guint32 *dest, const guchar *src, gint w)
+{
+	gint ix;
+
+	for (ix = 0; ix + 8 <= w; ix += 8)
+		remmina_plugin_vnc_pixel_rgb16_sse2(conv, dest + ix, _mm_loadu_si128((const __m128i*) (src + ix * 2)));
+	remmina_plugin_vnc_pixel_row16_c(conv, dest + ix, src + ix * 2, w - ix);
+}
+
+static __attribute__((target("sse2")))
+void remmina_plugin_vnc_pixel_row8_sse2(const RemminaPluginVncConverter *conv, guint32 *dest, const guchar *src, gint w)
+{
+	gint ix;
+
+	for (ix = 0; ix + 8 <= w; ix += 8)
+		remmina_plugin_vnc_pixel_rgb16_sse2(conv, dest + ix,
+				_mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*) (src + ix)), _mm_setzero_si128()));
+	remmina_plugin_vnc_pixel_row8_c(conv, dest + ix, src + ix, w - ix);
+}
+
+/* ------------------------------ AVX2 kernels ------------------------------ */
+
+static inline __attribute__((target("avx2"), always_inline))
+__m256i remmina_plugin_vnc_pixel_channel_avx2(__m256i p, const RemminaPluginVncPixelChannel *ch)
+{
+	__m256i c;
+	gint r;
+
+	c = _mm256_srl_epi16(p, _mm_cvtsi32_si128(ch->shift));
+	c = _mm256_and_si256(c, _mm256_set1_epi16(ch->max));
+	c = _mm256_sll_epi16(c, _mm_cvtsi32_si128(ch->left));
+	c = _mm256_and_si256(c, _mm256_set1_epi16(0xff));
+	for (r = ch->bits; r < 8; r *= 2)
+		c = _mm256_or_si256(c, _mm256_srl_epi16(c, _mm_cvtsi32_si128(r)));
+	return c;
+}
+
+/* Converts 16 pixels held in 16 bit lanes and writes them as 16 RGB24 pixels */
+static inline __attribute__((target("avx2"), always_inline))
+void remmina_plugin_vnc_pixel_rgb16_avx2(const RemminaPluginVncConverter *conv, guint32 *dest, __m256i p)
+{
+	__m256i r, g, b, gb, lo, hi;
+
+	r = remmina_plugin_vnc_pixel_channel_avx2(p, &conv->channel[0]);
+	g = remmina_plugin_vnc_pixel_channel_avx2(p, &conv->channel[1]);
+	b = remmina_plugin_vnc_pixel_channel_avx2(p, &conv->channel[2]);
+	gb = _mm256_or_si256(b, _mm256_slli_epi16(g, 8));
+	/* unpack works inside each 128 bit lane: lo holds pixels 0-3 and 8-11, hi holds 4-7 and 12-15 */
+	lo = _mm256_unpacklo_epi16(gb, r);
+	hi = _mm256_unpackhi_epi16(gb, r);
+	_mm256_storeu_si256((__m256i*) dest, _mm256_permute2x128_si256(lo, hi, 0x20));
+	_mm256_storeu_si256((__m256i*) (dest + 8), _mm256_permute2x128_si256(lo, hi, 0x31));
+}
+
+static __attribute__((target("avx2")))
+void remmina_plugin_vnc_pixel_row32_avx2(const RemminaPluginVncConverter *conv, guint32 *dest, const guchar *src, gint w)
+{
+	const __m256i rgb = _mm256_set1_epi32(0x00ffffff);
+	gint ix;
+
+	for (ix = 0; ix + 8 <= w; ix += 8)
+		_mm256_storeu_si256((__m256i*) (dest + ix),
+				_mm256_and_si256(_mm256_loadu_si256((const __m256i*) (src + ix * 4)), rgb));
+	remmina_plugin_vnc_pixel_row32_sse2(conv, dest + ix, src + ix * 4, w - ix);
+}
+
+static __attribute__((target("avx2")))
+void remmina_plugin_vnc_pixel_row16_avx2(const RemminaPluginVncConverter *conv, guint32 *dest, const guchar *src, gint w)
+{
+	gint ix;
+
+	for (ix = 0; ix + 16 <= w; ix += 16)
+		remmina_plugin_vnc_pixel_rgb16_avx2(conv, dest + ix, _mm256_loadu_si256((const __m256i*) (src + ix * 2)));
+	remmina_plugin_vnc_pixel_row16_sse2(conv, dest + ix, src + ix * 2, w - ix);
+}
+
+static __attribute__((target("avx2")))
+void remmina_plugin_vnc_pixel_row8_avx2(const RemminaPluginVncConverter *conv, guint32 *dest, const guchar *src, gint w)
+{
+	gint ix;
+
+	for (ix = 0; ix + 16 <= w; ix += 16)
+		remmina_plugin_vnc_pixel_rgb16_avx2(conv, dest + ix,
+				_mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*) (src + ix))));
+	remmina_plugin_vnc_pixel_row8_sse2(conv, dest + ix, src + ix, w - ix);
+}
+
+#endif /* REMMINA_VNC_PIXEL_X86 */
+
+static const RemminaPluginVncPixelImpl remmina_plugin_vnc_pixel_impl_c =
+{ "scalar", remmina_plugin_vnc_pixel_row32_c, remmina_plugin_vnc_pixel_row16_c, remmina_plugin_vnc_pixel_row8_c };
+
+#ifdef REMMINA_VNC_PIXEL_X86
+static const RemminaPluginVncPixelImpl remmina_plugin_vnc_pixel_impl_sse2 =
+{ "sse2", remmina_plugin_vnc_pixel_row32_sse2, remmina_plugin_vnc_pixel_row16_sse2, remmina_plugin_vnc_pixel_row8_sse2 };
+static const RemminaPluginVncPixelImpl remmina_plugin_vnc_pixel_impl_avx2 =
+{ "avx2", remmina_plugin_vnc_pixel_row32_avx2, remmina_plugin_vnc_pixel_row16_avx2, remmina_plugin_vnc_pixel_row8_avx2 };
+#endif
+
+static const RemminaPluginVncPixelImpl *remmina_plugin_vnc_pixel_impl = &remmina_plugin_vnc_pixel_impl_c;
+
+/* Picks the fastest kernels supported by the running CPU. Must be called once
+ * before any VNC thread is started. WITH_SSE2 builds assume SSE2 is there */
+void remmina_plugin_vnc_pixel_select_impl(void)
+{
+	TRACE_CALL("remmina_plugin_vnc_pixel_select_impl");
+	remmina_plugin_vnc_pixel_impl = &remmina_plugin_vnc_pixel_impl_c;
+#ifdef REMMINA_VNC_PIXEL_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		remmina_plugin_vnc_pixel_impl = &remmina_plugin_vnc_pixel_impl_avx2;
+#if defined(WITH_SSE2) || defined(__SSE2__)
+	else
+		remmina_plugin_vnc_pixel_impl = &remmina_plugin_vnc_pixel_impl_sse2;
+#else
+	else if (__builtin_cpu_supports("sse2"))
+		remmina_plugin_vnc_pixel_impl = &remmina_plugin_vnc_pixel_impl_sse2;
+#endif
+#endif
+}
+
+/* Forces the kernels named "scalar", "sse2" or "avx2", for tests. Returns FALSE
+ * and keeps the current ones when the build or the CPU lacks them */
+gboolean remmina_plugin_vnc_pixel_set_impl(const gchar *name)
+{
+	TRACE_CALL("remmina_plugin_vnc_pixel_set_impl");
+	if (strcmp(name, remmina_plugin_vnc_pixel_impl_c.name) == 0)
+	{
+		remmina_plugin_vnc_pixel_impl = &remmina_plugin_vnc_pixel_impl_c;
+		return TRUE;
+	}
+#ifdef REMMINA_VNC_PIXEL_X86
+	__builtin_cpu_init();
+	if (strcmp(name, remmina_plugin_vnc_pixel_impl_sse2.name) == 0 && __builtin_cpu_supports("sse2"))
+	{
+		remmina_plugin_vnc_pixel_impl = &remmina_plugin_vnc_pixel_impl_sse2;
+		return TRUE;
+	}
+	if (strcmp(name, remmina_plugin_vnc_pixel_impl_avx2.name) == 0 && __builtin_cpu_supports("avx2"))
+	{
+		remmina_plugin_vnc_pixel_impl = &remmina_plugin_vnc_pixel_impl_avx2;
+		return TRUE;
+	}
+#endif
+	return FALSE;
+}
+
+const gchar *remmina_plugin_vnc_pixel_get_impl_name(void)
+{
+	TRACE_CALL("remmina_plugin_vnc_pixel_get_impl_name");
+	return remmina_plugin_vnc_pixel_impl->name;
+}
+
+static void remmina_plugin_vnc_pixel_channel_init(RemminaPluginVncPixelChannel *ch, gint max, gint shift)
+{
+	ch->max = max;
+	ch->shift = shift;
+	ch->bits = remmina_plugin_vnc_pixel_bits(max);
+	ch->left = 8 - ch->bits;
+}
+
+void remmina_plugin_vnc_converter_init(RemminaPluginVncConverter *conv, const rfbPixelFormat *format)
+{
+	TRACE_CALL("remmina_plugin_vnc_converter_init");
+	RemminaPluginVncPixelChannel *ch;
+	guint32 pixel;
+	gint i, b, c;
+
+	conv->bits_per_pixel = format->bitsPerPixel;
+	remmina_plugin_vnc_pixel_channel_init(&conv->channel[0], format->redMax, format->redShift);
+	remmina_plugin_vnc_pixel_channel_init(&conv->channel[1], format->greenMax, format->greenShift);
+	remmina_plugin_vnc_pixel_channel_init(&conv->channel[2], format->blueMax, format->blueShift);
+
+	conv->simd_ok = (conv->bits_per_pixel == 8 || conv->bits_per_pixel == 16);
+	for (c = 0; c < 3; c++)
+	{
+		ch = &conv->channel[c];
+		if (ch->bits > 8 || ch->shift > 15)
+			conv->simd_ok = FALSE;
+	}
+
+	for (i = 0; i < 3; i++)
+	{
+		for (b = 0; b < 256; b++)
+		{
+			pixel = (guint32) b << (8 * i);
+			conv->lut[i][b] = (remmina_plugin_vnc_pixel_channel(&conv->channel[0], pixel) << 16)
+					| (remmina_plugin_vnc_pixel_channel(&conv->channel[1], pixel) << 8)
+					| remmina_plugin_vnc_pixel_channel(&conv->channel[2], pixel);
+		}
+	}
+}
+
+gboolean remmina_plugin_vnc_converter_matches(const RemminaPluginVncConverter *conv, const rfbPixelFormat *format)
+{
+	TRACE_CALL("remmina_plugin_vnc_converter_matches");
+	return conv->bits_per_pixel == format->bitsPerPixel
+			&& conv->channel[0].max == format->redMax && conv->channel[0].shift == format->redShift
+			&& conv->channel[1].max == format->greenMax && conv->channel[1].shift == format->greenShift
+			&& conv->channel[2].max == format->blueMax && conv->channel[2].shift == format->blueShift;
+}
+
+/* Converts a w x h block of server pixels to CAIRO_FORMAT_RGB24. dest and
+ * dest_rowstride must be 4 bytes aligned, as cairo image surfaces are */
+void remmina_plugin_vnc_converter_fill(const RemminaPluginVncConverter *conv, guchar *dest, gint dest_rowstride,
+		const guchar *src, gint src_rowstride, gint w, gint h)
+{
+	TRACE_CALL("remmina_plugin_vnc_converter_fill");
+	RemminaPluginVncRowFunc row;
+	gint iy;
+
+	switch (conv->bits_per_pixel)
+	{
+		case 32:
+			row = remmina_plugin_vnc_pixel_impl->row32;
+			break;
+		case 16:
+			row = conv->simd_ok ? remmina_plugin_vnc_pixel_impl->row16 : remmina_plugin_vnc_pixel_row16_c;
+			break;
+		case 8:
+			row = conv->simd_ok ? remmina_plugin_vnc_pixel_impl->row8 : remmina_plugin_vnc_pixel_row8_c;
+			break;
+		default:
+			row = remmina_plugin_vnc_pixel_row24_c;
+			break;
+	}
+
+	for (iy = 0; iy < h; iy++)
+		row(conv, (guint32*) (dest + iy * dest_rowstride), src + iy * src_rowstride, w);
+}
+
+/* Converts a cursor shape to RGBA bytes, with the alpha taken from mask */
+void remmina_plugin_vnc_converter_fill_rgba(const RemminaPluginVncConverter *conv, guchar *dest, gint dest_rowstride,
+		const guchar *src, gint src_rowstride, const guchar *mask, gint w, gint h)
+{
+	TRACE_CALL("remmina_plugin_vnc_converter_fill_rgba");
+	gint iy;
+
+	for (iy = 0; iy < h; iy++)
+		remmina_plugin_vnc_pixel_row_rgba_c(conv, dest + iy * dest_rowstride, src + iy * src_rowstride, mask + iy * w, w);
+}
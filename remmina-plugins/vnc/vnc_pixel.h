@@ -0,0 +1,78 @@
+/*
+ * Remmina - The GTK+ Remote Desktop Client
+ * Copyright (C) 2014-2015 Antenore Gatta, Fabio Castelli, Giovanni Panozzo
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ *
+ *  In addition, as a special exception, the copyright holders give
+ *  permission to link the code of portions of this program with the
+ *  OpenSSL library under certain conditions as described in each
+ *  individual source file, and distribute linked combinations
+ *  including the two.
+ *  You must obey the GNU General Public License in all respects
+ *  for all of the code used other than OpenSSL. *  If you modify
+ *  file(s) with this exception, you may extend this exception to your
+ *  version of the file(s), but you are not obligated to do so. *  If you
+ *  do not wish to do so, delete this exception statement from your
+ *  version. *  If you delete this exception statement from all source
+ *  files in the program, then also delete it here.
+ *
+ */
+
+#ifndef __REMMINA_VNC_PIXEL_H__
+#define __REMMINA_VNC_PIXEL_H__
+
+#include <glib.h>
+#include <rfb/rfbproto.h>
+
+G_BEGIN_DECLS
+
+/* One color channel of the server pixel format, with the shifts needed to
+ * expand it to 8 bits exactly like the original per-pixel loop did */
+typedef struct _RemminaPluginVncPixelChannel
+{
+	gint shift;
+	gint max;
+	gint bits;
+	gint left;
+} RemminaPluginVncPixelChannel;
+
+typedef struct _RemminaPluginVncConverter
+{
+	gint bits_per_pixel;
+	RemminaPluginVncPixelChannel channel[3];
+	/* Whether the 8/16bpp format can be converted in 16 bit SIMD lanes */
+	gboolean simd_ok;
+	/* 8/16/24bpp: the 0x00RRGGBB contribution of each source byte. The channel
+	 * extraction is made only of shifts, masks and ORs, so a pixel converts
+	 * to the OR of the entries of its bytes */
+	guint32 lut[3][256];
+} RemminaPluginVncConverter;
+
+void remmina_plugin_vnc_pixel_select_impl(void);
+gboolean remmina_plugin_vnc_pixel_set_impl(const gchar *name);
+const gchar *remmina_plugin_vnc_pixel_get_impl_name(void);
+
+void remmina_plugin_vnc_converter_init(RemminaPluginVncConverter *conv, const rfbPixelFormat *format);
+gboolean remmina_plugin_vnc_converter_matches(const RemminaPluginVncConverter *conv, const rfbPixelFormat *format);
+void remmina_plugin_vnc_converter_fill(const RemminaPluginVncConverter *conv, guchar *dest, gint dest_rowstride,
+		const guchar *src, gint src_rowstride, gint w, gint h);
+void remmina_plugin_vnc_converter_fill_rgba(const RemminaPluginVncConverter *conv, guchar *dest, gint dest_rowstride,
+		const guchar *src, gint src_rowstride, const guchar *mask, gint w, gint h);
+
+G_END_DECLS
+
+#endif
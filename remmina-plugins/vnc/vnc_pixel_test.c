@@ -0,0 +1,266 @@
+/*
+ * Remmina - The GTK+ Remote Desktop Client
+ * Copyright (C) 2014-2015 Antenore Gatta, Fabio Castelli, Giovanni Panozzo
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ *
+ *  In addition, as a special exception, the copyright holders give
+ *  permission to link the code of portions of this program with the
+ *  OpenSSL library under certain conditions as described in each
+ *  individual source file, and distribute linked combinations
+ *  including the two.
+ *  You must obey the GNU General Public License in all respects
+ *  for all of the code used other than OpenSSL. *  If you modify
+ *  file(s) with this exception, you may extend this exception to your
+ *  version of the file(s), but you are not obligated to do so. *  If you
+ *  do not wish to do so, delete this exception statement from your
+ *  version. *  If you delete this exception statement from all source
+ *  files in the program, then also delete it here.
+ *
+ */
+
+/* Checks every pixel conversion kernel against the per-pixel loop the VNC
+ * plugin used before the converter existed. Each available implementation
+ * must produce exactly the same bytes for every tested pixel format. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "vnc_pixel.h"
+
+typedef struct _RemminaPluginVncTestFormat
+{
+	gint bits_per_pixel;
+	gint red_max, green_max, blue_max;
+	gint red_shift, green_shift, blue_shift;
+} RemminaPluginVncTestFormat;
+
+static const RemminaPluginVncTestFormat remmina_plugin_vnc_test_formats[] =
+{
+	{ 32, 255, 255, 255, 16, 8, 0 },
+	{ 32, 255, 255, 255, 0, 8, 16 },
+	{ 24, 255, 255, 255, 16, 8, 0 },
+	{ 24, 255, 255, 255, 0, 8, 16 },
+	{ 16, 31, 63, 31, 11, 5, 0 },
+	{ 16, 31, 63, 31, 0, 5, 11 },
+	{ 16, 31, 31, 31, 10, 5, 0 },
+	{ 16, 15, 15, 15, 8, 4, 0 },
+	{ 16, 255, 63, 15, 8, 2, 0 },
+	{ 8, 7, 7, 3, 0, 3, 6 },
+	{ 8, 3, 3, 3, 4, 2, 0 },
+	{ 8, 1, 1, 1, 2, 1, 0 }
+};
+
+static const gchar *remmina_plugin_vnc_test_impls[] = { "scalar", "sse2", "avx2" };
+
+static const gint remmina_plugin_vnc_test_widths[] = { 1, 2, 3, 4, 5, 7, 8, 9, 15, 16, 17, 31, 32, 33, 63, 64, 65, 100, 1027 };
+
+#define REMMINA_VNC_TEST_HEIGHT 3
+
+static guint32 remmina_plugin_vnc_test_seed = 12345;
+
+static guchar remmina_plugin_vnc_test_random(void)
+{
+	remmina_plugin_vnc_test_seed = remmina_plugin_vnc_test_seed * 1103515245 + 12345;
+	return (guchar)(remmina_plugin_vnc_test_seed >> 16);
+}
+
+static gint remmina_plugin_vnc_test_bits(gint n)
+{
+	gint b = 0;
+	while (n)
+	{
+		b++;
+		n >>= 1;
+	}
+	return b ? b : 1;
+}
+
+/* The original conversion loop, writing RGB bytes, plus an alpha byte when a mask is given */
+static void remmina_plugin_vnc_test_reference(const rfbPixelFormat *format, guchar *dest, gint dest_rowstride,
+		const guchar *src, gint src_rowstride, const guchar *mask, gint w, gint h)
+{
+	const guchar *srcptr;
+	guchar *destptr;
+	gint bytesPerPixel;
+	guint32 pixel;
+	gint ix, iy;
+	gint i;
+	guchar c;
+	gint rs, gs, bs, rm, gm, bm, rl, gl, bl, rr, gr, br;
+	gint r;
+
+	bytesPerPixel = format->bitsPerPixel / 8;
+	switch (format->bitsPerPixel)
+	{
+		case 32:
+			for (iy = 0; iy < h; iy++)
+			{
+				destptr = dest + iy * dest_rowstride;
+				srcptr = src + iy * src_rowstride;
+				for (ix = 0; ix < w; ix++)
+				{
+					*destptr++ = *(srcptr + 2);
+					*destptr++ = *(srcptr + 1);
+					*destptr++ = *srcptr;
+					if (mask)
+						*destptr++ = (*mask++) ? 0xff : 0x00;
+					srcptr += 4;
+				}
+			}
+			break;
+		default:
+			rm = format->redMax;
+			gm = format->greenMax;
+			bm = format->blueMax;
+			rr = remmina_plugin_vnc_test_bits(rm);
+			gr = remmina_plugin_vnc_test_bits(gm);
+			br = remmina_plugin_vnc_test_bits(bm);
+			rl = 8 - rr;
+			gl = 8 - gr;
+			bl = 8 - br;
+			rs = format->redShift;
+			gs = format->greenShift;
+			bs = format->blueShift;
+			for (iy = 0; iy < h; iy++)
+			{
+				destptr = dest + iy * dest_rowstride;
+				srcptr = src + iy * src_rowstride;
+				for (ix = 0; ix < w; ix++)
+				{
+					pixel = 0;
+					for (i = 0; i < bytesPerPixel; i++)
+						pixel += (*srcptr++) << (8 * i);
+					c = (guchar)((pixel >> rs) & rm) << rl;
+					for (r = rr; r < 8; r *= 2)
+						c |= c >> r;
+					*destptr++ = c;
+					c = (guchar)((pixel >> gs) & gm) << gl;
+					for (r = gr; r < 8; r *= 2)
+						c |= c >> r;
+					*destptr++ = c;
+					c = (guchar)((pixel >> bs) & bm) << bl;
+					for (r = br; r < 8; r *= 2)
+						c |= c >> r;
+					*destptr++ = c;
+					if (mask)
+						*destptr++ = (*mask++) ? 0xff : 0x00;
+				}
+			}
+			break;
+	}
+}
+
+/* Returns the number of mismatching pixels of one format and width */
+static gint remmina_plugin_vnc_test_run(const gchar *impl, const RemminaPluginVncTestFormat *tf, gint w)
+{
+	RemminaPluginVncConverter conv;
+	rfbPixelFormat format;
+	gint h = REMMINA_VNC_TEST_HEIGHT;
+	gint bpp, src_rowstride, dest_rowstride;
+	guchar *src_buf, *src, *mask, *dest, *rgba, *expected;
+	guint32 v;
+	gint ix, iy, i;
+	gint errors = 0;
+
+	memset(&format, 0, sizeof(format));
+	format.bitsPerPixel = tf->bits_per_pixel;
+	format.redMax = tf->red_max;
+	format.greenMax = tf->green_max;
+	format.blueMax = tf->blue_max;
+	format.redShift = tf->red_shift;
+	format.greenShift = tf->green_shift;
+	format.blueShift = tf->blue_shift;
+
+	/* Odd source strides and an unaligned start exercise the unaligned loads */
+	bpp = tf->bits_per_pixel / 8;
+	src_rowstride = w * bpp + 5;
+	dest_rowstride = w * 4 + 12;
+	src_buf = malloc(src_rowstride * h + 1);
+	src = src_buf + 1;
+	mask = malloc(w * h);
+	dest = malloc(dest_rowstride * h);
+	rgba = malloc(w * 4 * h);
+	expected = malloc(w * 4 * h);
+
+	for (i = 0; i < src_rowstride * h; i++)
+		src[i] = remmina_plugin_vnc_test_random();
+	for (i = 0; i < w * h; i++)
+		mask[i] = remmina_plugin_vnc_test_random() & 1;
+
+	remmina_plugin_vnc_converter_init(&conv, &format);
+
+	/* Framebuffer updates: native endian 0x00RRGGBB */
+	remmina_plugin_vnc_test_reference(&format, expected, w * 3, src, src_rowstride, NULL, w, h);
+	remmina_plugin_vnc_converter_fill(&conv, dest, dest_rowstride, src, src_rowstride, w, h);
+	for (iy = 0; iy < h; iy++)
+	{
+		for (ix = 0; ix < w; ix++)
+		{
+			v = *(guint32*) (dest + iy * dest_rowstride + ix * 4);
+			i = iy * w * 3 + ix * 3;
+			if (v != (((guint32) expected[i] << 16) | (expected[i + 1] << 8) | expected[i + 2]))
+			{
+				if (errors++ == 0)
+					printf("%s: %dbpp width %d, pixel %d,%d is %08x, expected %02x%02x%02x\n", impl,
+							tf->bits_per_pixel, w, ix, iy, v, expected[i], expected[i + 1], expected[i + 2]);
+			}
+		}
+	}
+
+	/* Cursor shapes: RGBA bytes */
+	remmina_plugin_vnc_test_reference(&format, expected, w * 4, src, src_rowstride, mask, w, h);
+	remmina_plugin_vnc_converter_fill_rgba(&conv, rgba, w * 4, src, src_rowstride, mask, w, h);
+	if (memcmp(rgba, expected, w * 4 * h) != 0)
+	{
+		printf("%s: %dbpp width %d, cursor shape differs\n", impl, tf->bits_per_pixel, w);
+		errors++;
+	}
+
+	free(src_buf);
+	free(mask);
+	free(dest);
+	free(rgba);
+	free(expected);
+	return errors;
+}
+
+int main(int argc, char **argv)
+{
+	guint i, f, w;
+	gint errors = 0;
+
+	for (i = 0; i < G_N_ELEMENTS(remmina_plugin_vnc_test_impls); i++)
+	{
+		if (!remmina_plugin_vnc_pixel_set_impl(remmina_plugin_vnc_test_impls[i]))
+		{
+			printf("%s: not available, skipped\n", remmina_plugin_vnc_test_impls[i]);
+			continue;
+		}
+		for (f = 0; f < G_N_ELEMENTS(remmina_plugin_vnc_test_formats); f++)
+			for (w = 0; w < G_N_ELEMENTS(remmina_plugin_vnc_test_widths); w++)
+				errors += remmina_plugin_vnc_test_run(remmina_plugin_vnc_test_impls[i],
+						&remmina_plugin_vnc_test_formats[f], remmina_plugin_vnc_test_widths[w]);
+		printf("%s: done\n", remmina_plugin_vnc_pixel_get_impl_name());
+	}
+
+	if (errors)
+	{
+		printf("%d mismatches\n", errors);
+		return 1;
+	}
+	return 0;
+}
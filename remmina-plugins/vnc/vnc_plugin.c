@@ -34,6 +34,11 @@
  */
 
 #include "common/remmina_plugin.h"
+#include "vnc_pixel.h"
+#include "vnc_scale.h"
+#include "vnc_event.h"
+#include "vnc_histogram.h"
+#include "vnc_damage.h"
 
 #define REMMINA_PLUGIN_VNC_FEATURE_PREF_QUALITY            1
 #define REMMINA_PLUGIN_VNC_FEATURE_PREF_VIEWONLY           2
@@ -46,6 +51,31 @@
 
 #define GET_PLUGIN_DATA(gp) (RemminaPluginVncData*) g_object_get_data(G_OBJECT(gp), "plugin-data")
 
+/* Number of display frames, see RemminaPluginVncData.frames. The frame_ready
+ * field holds a frame index, with the FRESH bit set while it has not been
+ * picked up by the GTK thread yet */
+#define REMMINA_PLUGIN_VNC_FRAMES               3
+#define REMMINA_PLUGIN_VNC_FRAME_INDEX          0x0ff
+#define REMMINA_PLUGIN_VNC_FRAME_FRESH          0x100
+
+/* While the window is being resized the frames are stretched by cairo when
+ * painted, they are rescaled for real once the size has not changed for
+ * this long (ms) */
+#define REMMINA_PLUGIN_VNC_SCALE_SETTLE         300
+
+/* Adaptive quality: link conditions are evaluated over this period (ms).
+ * Quality is lowered when framebuffer updates arrive at less than RATE_LOW
+ * pixels per ms of receiving time or the round trip exceeds RTT_HIGH (ms),
+ * and raised again when the rate is above RATE_HIGH and the round trip below
+ * RTT_LOW. The rate is only trusted once MIN_PIXELS were received */
+#define REMMINA_PLUGIN_VNC_ADAPT_PERIOD         2000
+#define REMMINA_PLUGIN_VNC_ADAPT_MIN_UPDATES    4
+#define REMMINA_PLUGIN_VNC_ADAPT_MIN_PIXELS     65536
+#define REMMINA_PLUGIN_VNC_ADAPT_RATE_LOW       1000
+#define REMMINA_PLUGIN_VNC_ADAPT_RATE_HIGH      4000
+#define REMMINA_PLUGIN_VNC_ADAPT_RTT_HIGH       300
+#define REMMINA_PLUGIN_VNC_ADAPT_RTT_LOW        100
+
 typedef struct _RemminaPluginVncData
 {
 	/* Whether the user requests to connect/disconnect */
@@ -59,14 +89,32 @@ typedef struct _RemminaPluginVncData
 
 	GtkWidget *drawing_area;
 	guchar *vnc_buffer;
-	GdkPixbuf *rgb_buffer;
-
-	GdkPixbuf *scale_buffer;
+	/* CAIRO_FORMAT_RGB24 render target, written directly by the VNC thread */
+	cairo_surface_t *rgb_buffer;
+
+	/* Triple buffered display frames of scale_width x scale_height, only
+	 * when scaling, unscaled sessions paint rgb_buffer. The VNC thread renders into frames[frame_back] and publishes
+	 * it by swapping it with frame_ready, the GTK thread paints
+	 * frames[frame_front] and swaps in a fresh frame_ready without locking.
+	 * Frames are only created and destroyed by the GTK thread */
+	cairo_surface_t *frames[REMMINA_PLUGIN_VNC_FRAMES];
+	/* Area of each frame that is older than the last published frame */
+	cairo_region_t *frame_stale[REMMINA_PLUGIN_VNC_FRAMES];
+	/* Damage rendered into the back frame and not published yet */
+	cairo_region_t *frame_damage;
+	gint frame_back;
+	gint frame_front;
+	gint frame_ready;
+	/* Box filter used instead of cairo when the frames are smaller */
+	RemminaPluginVncScaler *scaler;
 	gint scale_width;
 	gint scale_height;
 	guint scale_handler;
+	/* Time spent in the draw callback, logged when the connection closes */
+	RemminaPluginVncHistogram draw_latency;
 
-	gint queuedraw_x, queuedraw_y, queuedraw_w, queuedraw_h;
+	/* Damage accumulated by the VNC thread until the next redraw */
+	cairo_region_t *queuedraw_region;
 	guint queuedraw_handler;
 
 	gulong clipboard_handler;
@@ -83,12 +131,37 @@ typedef struct _RemminaPluginVncData
 
 	GPtrArray *pressed_keys;
 
-	pthread_mutex_t vnc_event_queue_mutex;
-	GQueue *vnc_event_queue;
-	gint vnc_event_pipe[2];
+	/* Input events from the GTK thread to the VNC thread */
+	RemminaPluginVncEventQueue vnc_events;
+	gboolean vnc_event_overflow;
 
 	pthread_t thread;
+	/* Protects rgb_buffer and the frames against the VNC thread */
 	pthread_mutex_t buffer_mutex;
+	/* Protects the queued damage and cursor, never held for long */
+	pthread_mutex_t queue_mutex;
+
+	/* Only used by the VNC thread */
+	RemminaPluginVncConverter converter;
+
+	/* Adaptive quality controller, only used by the VNC thread. The quality
+	 * preset chosen by the user is the best the controller may go to, the
+	 * lowest adaptive quality preset the worst */
+	gboolean adapt_enabled;
+	gint adapt_quality_max;
+	gint adapt_compress_min;
+	gint adapt_quality_min;
+	gint adapt_compress_max;
+	gint64 adapt_period_start;
+	gint64 adapt_last_update;
+	/* Time spent receiving updates and pixels received in this period */
+	gint64 adapt_busy;
+	gint64 adapt_period_pixels;
+	gint64 adapt_rtt;
+	gint adapt_updates;
+	/* Running totals: pixels updated, and time spent converting and scaling them */
+	gint64 adapt_pixels;
+	gint64 adapt_client;
 
 } RemminaPluginVncData;
 
@@ -102,47 +175,18 @@ static const gchar * dot_cursor_xpm[] =
 
 #define LOCK_BUFFER(t)      if(t){CANCEL_DEFER}pthread_mutex_lock(&gpdata->buffer_mutex);
 #define UNLOCK_BUFFER(t)    pthread_mutex_unlock(&gpdata->buffer_mutex);if(t){CANCEL_ASYNC}
+#define LOCK_QUEUE(t)       if(t){CANCEL_DEFER}pthread_mutex_lock(&gpdata->queue_mutex);
+#define UNLOCK_QUEUE(t)     pthread_mutex_unlock(&gpdata->queue_mutex);if(t){CANCEL_ASYNC}
 
-enum
-{
-	REMMINA_PLUGIN_VNC_EVENT_KEY,
-	REMMINA_PLUGIN_VNC_EVENT_POINTER,
-	REMMINA_PLUGIN_VNC_EVENT_CUTTEXT,
-	REMMINA_PLUGIN_VNC_EVENT_CHAT_OPEN,
-	REMMINA_PLUGIN_VNC_EVENT_CHAT_SEND,
-	REMMINA_PLUGIN_VNC_EVENT_CHAT_CLOSE
-};
-
-typedef struct _RemminaPluginVncEvent
-{
-	gint event_type;
-	union
-	{
-		struct
-		{
-			guint keyval;
-			gboolean pressed;
-		} key;
-		struct
-		{
-			gint x;
-			gint y;
-			gint button_mask;
-		} pointer;
-		struct
-		{
-			gchar *text;
-		} text;
-	} event_data;
-} RemminaPluginVncEvent;
 
 
 
 /* --------- Support for execution on main thread of GUI functions -------------- */
 static void remmina_plugin_vnc_update_scale(RemminaProtocolWidget *gp, gboolean scale);
+static gboolean remmina_plugin_vnc_update_scale_buffer(RemminaProtocolWidget *gp);
 
 struct onMainThread_cb_data {
-	enum { FUNC_GTK_WIDGET_QUEUE_DRAW_AREA, FUNC_UPDATE_SCALE } func;
+	enum { FUNC_UPDATE_SCALE_BUFFER, FUNC_UPDATE_SCALE } func;
 
 	GtkWidget *widget;
 	gint x, y, width, height;
@@ -160,8 +204,8 @@ static gboolean onMainThread_cb(struct onMainThread_cb_data *d)
 	TRACE_CALL("onMainThread_cb");
 	if ( !d->cancelled ) {
 		switch( d->func ) {
-			case FUNC_GTK_WIDGET_QUEUE_DRAW_AREA:
-				gtk_widget_queue_draw_area( d->widget, d->x, d->y, d->width, d->height );
+			case FUNC_UPDATE_SCALE_BUFFER:
+				remmina_plugin_vnc_update_scale_buffer( d->gp );
 				break;
 			case FUNC_UPDATE_SCALE:
 				remmina_plugin_vnc_update_scale( d->gp, d->scale );
@@ -199,14 +243,13 @@ static void onMainThread_schedule_callback_and_wait( struct onMainThread_cb_data
 	pthread_mutex_destroy( &d->mu );
 }
 
-static void onMainThread_gtk_widget_queue_draw_area(GtkWidget *widget, gint x, gint y, gint width, gint height )
+static void onMainThread_update_scale_buffer(RemminaProtocolWidget *gp)
 {
-	TRACE_CALL("onMainThread_gtk_widget_queue_draw_area");
+	TRACE_CALL("onMainThread_update_scale_buffer");
 	struct onMainThread_cb_data *d;
 	d = (struct onMainThread_cb_data *)g_malloc( sizeof(struct onMainThread_cb_data) );
-	d->func = FUNC_GTK_WIDGET_QUEUE_DRAW_AREA;
-	d->widget = widget;
-	d->x = x; d->y = y; d->width = width; d->height = height;
+	d->func = FUNC_UPDATE_SCALE_BUFFER;
+	d->gp = gp;
 	onMainThread_schedule_callback_and_wait( d );
 	g_free(d);
 }
@@ -220,66 +263,72 @@ static void remmina_plugin_vnc_event_push(RemminaProtocolWidget *gp, gint event_
 {
 	TRACE_CALL("remmina_plugin_vnc_event_push");
 	RemminaPluginVncData *gpdata = GET_PLUGIN_DATA(gp);
-	RemminaPluginVncEvent *event;
+	RemminaPluginVncEvent event;
 
-	event = g_new(RemminaPluginVncEvent, 1);
-	event->event_type = event_type;
+	event.event_type = event_type;
 	switch (event_type)
 	{
 		case REMMINA_PLUGIN_VNC_EVENT_KEY:
-			event->event_data.key.keyval = GPOINTER_TO_UINT(p1);
-			event->event_data.key.pressed = GPOINTER_TO_INT(p2);
+			event.event_data.key.keyval = GPOINTER_TO_UINT(p1);
+			event.event_data.key.pressed = GPOINTER_TO_INT(p2);
 			break;
 		case REMMINA_PLUGIN_VNC_EVENT_POINTER:
-			event->event_data.pointer.x = GPOINTER_TO_INT(p1);
-			event->event_data.pointer.y = GPOINTER_TO_INT(p2);
-			event->event_data.pointer.button_mask = GPOINTER_TO_INT(p3);
+			event.event_data.pointer.x = GPOINTER_TO_INT(p1);
+			event.event_data.pointer.y = GPOINTER_TO_INT(p2);
+			event.event_data.pointer.button_mask = GPOINTER_TO_INT(p3);
 			break;
 		case REMMINA_PLUGIN_VNC_EVENT_CUTTEXT:
 		case REMMINA_PLUGIN_VNC_EVENT_CHAT_SEND:
-			event->event_data.text.text = g_strdup((char*) p1);
+			event.event_data.text.text = g_strdup((char*) p1);
+			break;
+		case REMMINA_PLUGIN_VNC_EVENT_QUALITY:
+			event.event_data.quality.quality = GPOINTER_TO_INT(p1);
+			event.event_data.quality.adaptive = GPOINTER_TO_INT(p2);
+			event.event_data.quality.quality_min = GPOINTER_TO_INT(p3);
 			break;
 		default:
 			break;
 	}
 
-	pthread_mutex_lock(&gpdata->vnc_event_queue_mutex);
-	g_queue_push_tail(gpdata->vnc_event_queue, event);
-	pthread_mutex_unlock(&gpdata->vnc_event_queue_mutex);
-
-	if (write(gpdata->vnc_event_pipe[1], "\0", 1))
+	if (remmina_plugin_vnc_event_queue_push(&gpdata->vnc_events, &event))
 	{
-		/* Ignore */
+		/* The VNC thread is not keeping up (or not yet running), the event waits in the overflow list */
+		if (!gpdata->vnc_event_overflow)
+		{
+			remmina_plugin_service->log_printf("[VNC]Input event ring is full, queueing events until the connection catches up\n");
+			gpdata->vnc_event_overflow = TRUE;
+		}
+		return;
 	}
+	gpdata->vnc_event_overflow = FALSE;
 }
 
-static void remmina_plugin_vnc_event_free(RemminaPluginVncEvent *event)
+static cairo_filter_t remmina_plugin_vnc_get_scale_filter(void)
 {
-	TRACE_CALL("remmina_plugin_vnc_event_free");
-	switch (event->event_type)
+	TRACE_CALL("remmina_plugin_vnc_get_scale_filter");
+	switch (remmina_plugin_service->pref_get_scale_quality())
 	{
-		case REMMINA_PLUGIN_VNC_EVENT_CUTTEXT:
-		case REMMINA_PLUGIN_VNC_EVENT_CHAT_SEND:
-			g_free(event->event_data.text.text);
-			break;
+		case GDK_INTERP_NEAREST:
+			return CAIRO_FILTER_NEAREST;
+		case GDK_INTERP_TILES:
+			return CAIRO_FILTER_FAST;
+		case GDK_INTERP_BILINEAR:
+			return CAIRO_FILTER_BILINEAR;
+		case GDK_INTERP_HYPER:
 		default:
-			break;
+			return CAIRO_FILTER_BEST;
 	}
-	g_free(event);
 }
 
-static void remmina_plugin_vnc_event_free_all(RemminaProtocolWidget *gp)
+/* Size of the widget, which the frames are scaled to once it settles */
+static void remmina_plugin_vnc_get_view_size(RemminaProtocolWidget *gp, gint *width, gint *height)
 {
-	TRACE_CALL("remmina_plugin_vnc_event_free_all");
-	RemminaPluginVncData *gpdata = GET_PLUGIN_DATA(gp);
-	RemminaPluginVncEvent *event;
+	TRACE_CALL("remmina_plugin_vnc_get_view_size");
+	GtkAllocation a;
 
-	/* This is called from main thread after plugin thread has
-	   been closed, so no queue locking is nessesary here */
-	while ((event = g_queue_pop_head(gpdata->vnc_event_queue)) != NULL)
-	{
-		remmina_plugin_vnc_event_free(event);
-	}
+	gtk_widget_get_allocation(GTK_WIDGET(gp), &a);
+	*width = MAX(a.width, 1);
+	*height = MAX(a.height, 1);
 }
 
 static void remmina_plugin_vnc_scale_area(RemminaProtocolWidget *gp, gint *x, gint *y, gint *w, gint *h)
@@ -288,17 +337,42 @@ static void remmina_plugin_vnc_scale_area(RemminaProtocolWidget *gp, gint *x, gi
 	RemminaPluginVncData *gpdata = GET_PLUGIN_DATA(gp);
 	gint sx, sy, sw, sh;
 	gint width, height;
+	cairo_surface_t *frame;
+	cairo_t *cr;
 
-	if (gpdata->rgb_buffer == NULL || gpdata->scale_buffer == NULL)
+	frame = gpdata->frames[gpdata->frame_back];
+	if (gpdata->rgb_buffer == NULL || frame == NULL)
 		return;
 
+	if (gpdata->scaler)
+	{
+		/* Left from before a desktop resize, until the frames are replaced */
+		if (gpdata->scaler->x.src_len != cairo_image_surface_get_width(gpdata->rgb_buffer)
+				|| gpdata->scaler->y.src_len != cairo_image_surface_get_height(gpdata->rgb_buffer))
+			return;
+		cairo_surface_flush(frame);
+		remmina_plugin_vnc_scaler_scale(gpdata->scaler,
+				cairo_image_surface_get_data(frame), cairo_image_surface_get_stride(frame),
+				cairo_image_surface_get_data(gpdata->rgb_buffer), cairo_image_surface_get_stride(gpdata->rgb_buffer),
+				x, y, w, h);
+		cairo_surface_mark_dirty_rectangle(frame, *x, *y, *w, *h);
+		return;
+	}
+
 	width = remmina_plugin_service->protocol_plugin_get_width(gp);
 	height = remmina_plugin_service->protocol_plugin_get_height(gp);
 
+	cr = cairo_create(frame);
+	cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+
 	if (gpdata->scale_width == width && gpdata->scale_height == height)
 	{
 		/* Same size, just copy the pixels */
-		gdk_pixbuf_copy_area(gpdata->rgb_buffer, *x, *y, *w, *h, gpdata->scale_buffer, *x, *y);
+		cairo_rectangle(cr, *x, *y, *w, *h);
+		cairo_clip(cr);
+		cairo_set_source_surface(cr, gpdata->rgb_buffer, 0, 0);
+		cairo_paint(cr);
+		cairo_destroy(cr);
 		return;
 	}
 
@@ -308,9 +382,15 @@ static void remmina_plugin_vnc_scale_area(RemminaProtocolWidget *gp, gint *x, gi
 	sw = MIN(gpdata->scale_width - sx, (*w) * gpdata->scale_width / width + gpdata->scale_width / width + 4);
 	sh = MIN(gpdata->scale_height - sy, (*h) * gpdata->scale_height / height + gpdata->scale_height / height + 4);
 
-	gdk_pixbuf_scale(gpdata->rgb_buffer, gpdata->scale_buffer, sx, sy, sw, sh, 0, 0,
-			(double) gpdata->scale_width / (double) width, (double) gpdata->scale_height / (double) height,
-			remmina_plugin_service->pref_get_scale_quality());
+	cairo_rectangle(cr, sx, sy, sw, sh);
+	cairo_clip(cr);
+	cairo_scale(cr, (double) gpdata->scale_width / (double) width, (double) gpdata->scale_height / (double) height);
+	cairo_set_source_surface(cr, gpdata->rgb_buffer, 0, 0);
+	cairo_pattern_set_filter(cairo_get_source(cr), remmina_plugin_vnc_get_scale_filter());
+	/* Repeat the border pixels instead of blending the edges with black */
+	cairo_pattern_set_extend(cairo_get_source(cr), CAIRO_EXTEND_PAD);
+	cairo_paint(cr);
+	cairo_destroy(cr);
 
 	*x = sx;
 	*y = sy;
@@ -318,88 +398,153 @@ static void remmina_plugin_vnc_scale_area(RemminaProtocolWidget *gp, gint *x, gi
 	*h = sh;
 }
 
-static gboolean remmina_plugin_vnc_update_scale_buffer(RemminaProtocolWidget *gp, gboolean in_thread)
+static void remmina_plugin_vnc_copy_region(cairo_surface_t *dst, cairo_surface_t *src, cairo_region_t *region)
+{
+	TRACE_CALL("remmina_plugin_vnc_copy_region");
+	cairo_rectangle_int_t rect;
+	guchar *dst_data, *src_data;
+	gint stride;
+	gint i, n, row;
+
+	/* Plain memcpy, src may be painted by the GTK thread at the same time
+	 * so it must not be used as a cairo source here */
+	n = cairo_region_num_rectangles(region);
+	if (n == 0)
+		return;
+	cairo_surface_flush(dst);
+	dst_data = cairo_image_surface_get_data(dst);
+	src_data = cairo_image_surface_get_data(src);
+	stride = cairo_image_surface_get_stride(dst);
+	for (i = 0; i < n; i++)
+	{
+		cairo_region_get_rectangle(region, i, &rect);
+		for (row = rect.y; row < rect.y + rect.height; row++)
+		{
+			memcpy(dst_data + row * stride + rect.x * 4, src_data + row * stride + rect.x * 4, rect.width * 4);
+		}
+		cairo_surface_mark_dirty_rectangle(dst, rect.x, rect.y, rect.width, rect.height);
+	}
+}
+
+static void remmina_plugin_vnc_free_frames(RemminaPluginVncData *gpdata)
+{
+	TRACE_CALL("remmina_plugin_vnc_free_frames");
+	gint i;
+
+	if (gpdata->scaler)
+	{
+		remmina_plugin_vnc_scaler_free(gpdata->scaler);
+		gpdata->scaler = NULL;
+	}
+	for (i = 0; i < REMMINA_PLUGIN_VNC_FRAMES; i++)
+	{
+		if (gpdata->frames[i])
+		{
+			cairo_surface_destroy(gpdata->frames[i]);
+			gpdata->frames[i] = NULL;
+		}
+		if (gpdata->frame_stale[i])
+		{
+			cairo_region_destroy(gpdata->frame_stale[i]);
+			gpdata->frame_stale[i] = NULL;
+		}
+	}
+}
+
+static gboolean remmina_plugin_vnc_update_scale_buffer(RemminaProtocolWidget *gp)
 {
 	TRACE_CALL("remmina_plugin_vnc_update_scale_buffer");
+	/* Must be called from the main thread, as it frees the frames */
 	RemminaPluginVncData *gpdata = GET_PLUGIN_DATA(gp);
-	RemminaFile *remminafile;
 	gint width, height;
 	gint gpwidth, gpheight;
+	gint x, y, w, h, i;
 	gboolean scale;
-	gint x, y, w, h;
-	GdkPixbuf *pixbuf;
-	GtkAllocation a;
+	cairo_region_t *all;
+	cairo_rectangle_int_t rect;
 
-	remminafile = remmina_plugin_service->protocol_plugin_get_file(gp);
-
-	if (gpdata->running)
+	gpwidth = remmina_plugin_service->protocol_plugin_get_width(gp);
+	gpheight = remmina_plugin_service->protocol_plugin_get_height(gp);
+	scale = remmina_plugin_service->protocol_plugin_get_scale(gp);
+	if (scale)
 	{
-		gtk_widget_get_allocation(GTK_WIDGET(gp), &a);
-		width = a.width;
-		height = a.height;
-		scale = remmina_plugin_service->protocol_plugin_get_scale(gp);
-		if (scale)
-		{
-			if (width > 1 && height > 1)
-			{
-				LOCK_BUFFER (in_thread)
-
-				if (gpdata->scale_buffer)
-				{
-					g_object_unref(gpdata->scale_buffer);
-				}
-				gpwidth = remmina_plugin_service->protocol_plugin_get_width(gp);
-				gpheight = remmina_plugin_service->protocol_plugin_get_height(gp);
-				gpdata->scale_width = width;
-				gpdata->scale_height = height;
-
-				pixbuf = gdk_pixbuf_new(GDK_COLORSPACE_RGB, FALSE, 8, gpdata->scale_width,
-						gpdata->scale_height);
-				gpdata->scale_buffer = pixbuf;
-
-				x = 0;
-				y = 0;
-				w = gpwidth;
-				h = gpheight;
-				remmina_plugin_vnc_scale_area(gp, &x, &y, &w, &h);
-
-UNLOCK_BUFFER			(in_thread)
-		}
+		remmina_plugin_vnc_get_view_size(gp, &width, &height);
 	}
 	else
 	{
-		LOCK_BUFFER (in_thread)
+		width = gpwidth;
+		height = gpheight;
+	}
 
-		if (gpdata->scale_buffer)
-		{
-			g_object_unref (gpdata->scale_buffer);
-			gpdata->scale_buffer = NULL;
-		}
-		gpdata->scale_width = 0;
-		gpdata->scale_height = 0;
+	LOCK_BUFFER (FALSE)
 
-		UNLOCK_BUFFER (in_thread)
-	}
-		if (width > 1 && height > 1)
-		{
-			if (in_thread)
-			{
-				onMainThread_gtk_widget_queue_draw_area(GTK_WIDGET(gp), 0, 0, width, height);
-			}
-			else
-			{
-				gtk_widget_queue_draw_area(GTK_WIDGET(gp), 0, 0, width, height);
-			}
-		}
+	/* The old frames and scaler must go in any case, they may be bigger
+	 * than the desktop now */
+	remmina_plugin_vnc_free_frames(gpdata);
+	/* Unscaled sessions paint rgb_buffer itself, frames would only cost
+	 * memory and one more copy of every update */
+	if (!gpdata->running || !scale || width <= 1 || height <= 1)
+	{
+		gpdata->scale_width = width;
+		gpdata->scale_height = height;
+		UNLOCK_BUFFER (FALSE)
+		if (gpdata->running && !scale)
+			gtk_widget_queue_draw_area(GTK_WIDGET(gp), 0, 0, width, height);
+		return FALSE;
 	}
-	gpdata->scale_handler = 0;
+	gpdata->scale_width = width;
+	gpdata->scale_height = height;
+	for (i = 0; i < REMMINA_PLUGIN_VNC_FRAMES; i++)
+	{
+		gpdata->frames[i] = cairo_image_surface_create(CAIRO_FORMAT_RGB24, width, height);
+		gpdata->frame_stale[i] = cairo_region_create();
+	}
+	gpdata->frame_back = 0;
+	gpdata->frame_front = 1;
+	g_atomic_int_set(&gpdata->frame_ready, 2);
+	/* Shrinking uses the box filter, unless nearest neighbour was chosen. It only
+	 * handles sizes where neither axis grows, cairo stretches the others */
+	if (width <= gpwidth && height <= gpheight && (width < gpwidth || height < gpheight)
+			&& remmina_plugin_vnc_get_scale_filter() != CAIRO_FILTER_NEAREST)
+		gpdata->scaler = remmina_plugin_vnc_scaler_new(gpwidth, gpheight, width, height);
+	cairo_region_destroy(gpdata->frame_damage);
+	gpdata->frame_damage = cairo_region_create();
+
+	/* Render the whole desktop once, then start all frames from it */
+	x = 0;
+	y = 0;
+	w = gpwidth;
+	h = gpheight;
+	remmina_plugin_vnc_scale_area(gp, &x, &y, &w, &h);
+
+	rect.x = 0;
+	rect.y = 0;
+	rect.width = width;
+	rect.height = height;
+	all = cairo_region_create_rectangle(&rect);
+	for (i = 1; i < REMMINA_PLUGIN_VNC_FRAMES; i++)
+	{
+		remmina_plugin_vnc_copy_region(gpdata->frames[i], gpdata->frames[0], all);
+	}
+	cairo_region_destroy(all);
+
+	UNLOCK_BUFFER (FALSE)
+
+	gtk_widget_queue_draw_area(GTK_WIDGET(gp), 0, 0, width, height);
 	return FALSE;
 }
 
 static gboolean remmina_plugin_vnc_update_scale_buffer_main(RemminaProtocolWidget *gp)
 {
 	TRACE_CALL("remmina_plugin_vnc_update_scale_buffer_main");
-	return remmina_plugin_vnc_update_scale_buffer(gp, FALSE);
+	RemminaPluginVncData *gpdata = GET_PLUGIN_DATA(gp);
+
+	gpdata->scale_handler = 0;
+	/* A hidden session keeps its stretched frames, the next draw of the
+	 * widget schedules the rescale again */
+	if (!gtk_widget_is_drawable(GTK_WIDGET(gp)))
+		return FALSE;
+	return remmina_plugin_vnc_update_scale_buffer(gp);
 }
 
 static void remmina_plugin_vnc_update_scale(RemminaProtocolWidget *gp, gboolean scale)
@@ -447,7 +592,7 @@ gboolean remmina_plugin_vnc_setcursor(RemminaProtocolWidget *gp)
 	RemminaPluginVncData *gpdata = GET_PLUGIN_DATA(gp);
 	GdkCursor *cur;
 
-	LOCK_BUFFER (FALSE)
+	LOCK_QUEUE (FALSE)
 	gpdata->queuecursor_handler = 0;
 
 	if (gpdata->queuecursor_pixbuf)
@@ -463,7 +608,7 @@ gboolean remmina_plugin_vnc_setcursor(RemminaProtocolWidget *gp)
 	{
 		gdk_window_set_cursor(gtk_widget_get_window(gpdata->drawing_area), NULL);
 	}
-	UNLOCK_BUFFER (FALSE)
+	UNLOCK_QUEUE (FALSE)
 
 	return FALSE;
 }
@@ -498,62 +643,55 @@ typedef struct _RemminaKeyVal
 static const uint32_t remmina_plugin_vnc_no_encrypt_auth_types[] =
 {	rfbNoAuth, rfbVncAuth, rfbMSLogon, 0};
 
-static RemminaPluginVncEvent *remmina_plugin_vnc_event_queue_pop_head(RemminaPluginVncData *gpdata) {
-	RemminaPluginVncEvent *event;
-
-	CANCEL_DEFER;
-	pthread_mutex_lock(&gpdata->vnc_event_queue_mutex);
-
-	event = g_queue_pop_head(gpdata->vnc_event_queue);
-
-	pthread_mutex_unlock(&gpdata->vnc_event_queue_mutex);
-	CANCEL_ASYNC;
-
-	return event;
-}
+static void remmina_plugin_vnc_update_quality(rfbClient *cl, gint quality);
+static void remmina_plugin_vnc_adapt_reset(RemminaPluginVncData *gpdata, rfbClient *cl, gboolean enabled, gint quality_min);
 
 static void remmina_plugin_vnc_process_vnc_event(RemminaProtocolWidget *gp)
 {
 	TRACE_CALL("remmina_plugin_vnc_process_vnc_event");
-	RemminaPluginVncEvent *event;
+	RemminaPluginVncEvent event;
 	RemminaPluginVncData *gpdata = GET_PLUGIN_DATA(gp);
 	rfbClient *cl;
-	gchar buf[100];
+
+	remmina_plugin_vnc_event_queue_ack(&gpdata->vnc_events);
 
 	cl = (rfbClient*) gpdata->client;
-	while ((event = remmina_plugin_vnc_event_queue_pop_head(gpdata)) != NULL)
+	while (remmina_plugin_vnc_event_queue_pop(&gpdata->vnc_events, &event))
 	{
 		if (cl)
 		{
-			switch (event->event_type)
+			switch (event.event_type)
 			{
 				case REMMINA_PLUGIN_VNC_EVENT_KEY:
-					SendKeyEvent(cl, event->event_data.key.keyval, event->event_data.key.pressed);
+					SendKeyEvent(cl, event.event_data.key.keyval, event.event_data.key.pressed);
 					break;
 				case REMMINA_PLUGIN_VNC_EVENT_POINTER:
-					SendPointerEvent(cl, event->event_data.pointer.x, event->event_data.pointer.y,
-							event->event_data.pointer.button_mask);
+					SendPointerEvent(cl, event.event_data.pointer.x, event.event_data.pointer.y,
+							event.event_data.pointer.button_mask);
 					break;
 				case REMMINA_PLUGIN_VNC_EVENT_CUTTEXT:
-					SendClientCutText(cl, event->event_data.text.text, strlen(event->event_data.text.text));
+					SendClientCutText(cl, event.event_data.text.text, strlen(event.event_data.text.text));
 					break;
 				case REMMINA_PLUGIN_VNC_EVENT_CHAT_OPEN:
 					TextChatOpen(cl);
 					break;
 				case REMMINA_PLUGIN_VNC_EVENT_CHAT_SEND:
-					TextChatSend(cl, event->event_data.text.text);
+					TextChatSend(cl, event.event_data.text.text);
 					break;
 				case REMMINA_PLUGIN_VNC_EVENT_CHAT_CLOSE:
 					TextChatClose(cl);
 					TextChatFinish(cl);
 					break;
+				case REMMINA_PLUGIN_VNC_EVENT_QUALITY:
+					/* The encodings and the adaptive quality state belong to this thread */
+					remmina_plugin_vnc_update_quality(cl, event.event_data.quality.quality);
+					remmina_plugin_vnc_adapt_reset(gpdata, cl, event.event_data.quality.adaptive,
+							event.event_data.quality.quality_min);
+					SetFormatAndEncodings(cl);
+					break;
 			}
 		}
-		remmina_plugin_vnc_event_free(event);
-	}
-	if (read(gpdata->vnc_event_pipe[0], buf, sizeof(buf)))
-	{
-		/* Ignore */
+		remmina_plugin_vnc_event_free(&event);
 	}
 }
 
@@ -564,6 +702,32 @@ typedef struct _RemminaPluginVncCuttextParam
 	gint textlen;
 } RemminaPluginVncCuttextParam;
 
+/* Tight quality and compression levels of a quality preset */
+static void remmina_plugin_vnc_quality_levels(gint quality, gint *quality_level, gint *compress_level)
+{
+	TRACE_CALL("remmina_plugin_vnc_quality_levels");
+	switch (quality)
+	{
+		case 9:
+			*compress_level = 0;
+			*quality_level = 9;
+			break;
+		case 2:
+			*compress_level = 3;
+			*quality_level = 7;
+			break;
+		case 1:
+			*compress_level = 5;
+			*quality_level = 5;
+			break;
+		case 0:
+		default:
+			*compress_level = 9;
+			*quality_level = 0;
+			break;
+	}
+}
+
 static void remmina_plugin_vnc_update_quality(rfbClient *cl, gint quality)
 {
 	TRACE_CALL("remmina_plugin_vnc_update_quality");
@@ -572,29 +736,103 @@ static void remmina_plugin_vnc_update_quality(rfbClient *cl, gint quality)
 		case 9:
 			cl->appData.useBGR233 = 0;
 			cl->appData.encodingsString = "copyrect hextile raw";
-			cl->appData.compressLevel = 0;
-			cl->appData.qualityLevel = 9;
 			break;
 		case 2:
-			cl->appData.useBGR233 = 0;
-			cl->appData.encodingsString = "tight zrle ultra copyrect hextile zlib corre rre raw";
-			cl->appData.compressLevel = 3;
-			cl->appData.qualityLevel = 7;
-			break;
 		case 1:
 			cl->appData.useBGR233 = 0;
 			cl->appData.encodingsString = "tight zrle ultra copyrect hextile zlib corre rre raw";
-			cl->appData.compressLevel = 5;
-			cl->appData.qualityLevel = 5;
 			break;
 		case 0:
 		default:
 			cl->appData.useBGR233 = 1;
 			cl->appData.encodingsString = "tight zrle ultra copyrect hextile zlib corre rre raw";
-			cl->appData.compressLevel = 9;
-			cl->appData.qualityLevel = 0;
 			break;
 	}
+	remmina_plugin_vnc_quality_levels(quality, &cl->appData.qualityLevel, &cl->appData.compressLevel);
+}
+
+static void remmina_plugin_vnc_adapt_reset(RemminaPluginVncData *gpdata, rfbClient *cl, gboolean enabled, gint quality_min)
+{
+	TRACE_CALL("remmina_plugin_vnc_adapt_reset");
+	/* Only the tight encoding has quality and compression levels */
+	gpdata->adapt_enabled = enabled && strstr(cl->appData.encodingsString, "tight") != NULL;
+	gpdata->adapt_quality_max = cl->appData.qualityLevel;
+	gpdata->adapt_compress_min = cl->appData.compressLevel;
+	/* A lowest preset above the chosen one just keeps the chosen one */
+	remmina_plugin_vnc_quality_levels(quality_min, &gpdata->adapt_quality_min, &gpdata->adapt_compress_max);
+	gpdata->adapt_quality_min = MIN(gpdata->adapt_quality_min, gpdata->adapt_quality_max);
+	gpdata->adapt_compress_max = MAX(gpdata->adapt_compress_max, gpdata->adapt_compress_min);
+	gpdata->adapt_period_start = g_get_monotonic_time();
+	gpdata->adapt_last_update = 0;
+	gpdata->adapt_busy = 0;
+	gpdata->adapt_period_pixels = 0;
+	gpdata->adapt_rtt = -1;
+	gpdata->adapt_updates = 0;
+}
+
+/* One framebuffer update was received between start and end, receiving it
+ * took busy of that, the rest went into converting and scaling its pixels.
+ * The VNC thread waited for it from wait on */
+static void remmina_plugin_vnc_adapt_sample(RemminaPluginVncData *gpdata, rfbClient *cl, gint64 wait, gint64 start,
+		gint64 end, gint64 busy, gint64 pixels)
+{
+	TRACE_CALL("remmina_plugin_vnc_adapt_sample");
+	gint64 rate, rtt;
+	gint quality, compress;
+
+	/* The incremental update request is sent when the previous update has
+	 * been handled, so the shortest wait for the next one approximates
+	 * the round trip time (longer waits just mean an idle screen). An
+	 * update that was already waiting when this thread got back to the
+	 * socket, late because of local work, says nothing about the link */
+	if (gpdata->adapt_last_update > 0 && start - wait >= 1000)
+	{
+		rtt = start - gpdata->adapt_last_update;
+		if (gpdata->adapt_rtt < 0 || rtt < gpdata->adapt_rtt)
+			gpdata->adapt_rtt = rtt;
+	}
+	gpdata->adapt_last_update = end;
+	gpdata->adapt_busy += MAX(busy, 0);
+	gpdata->adapt_period_pixels += pixels;
+	gpdata->adapt_updates++;
+
+	if (end - gpdata->adapt_period_start < REMMINA_PLUGIN_VNC_ADAPT_PERIOD * 1000)
+		return;
+
+	if (gpdata->adapt_updates >= REMMINA_PLUGIN_VNC_ADAPT_MIN_UPDATES)
+	{
+		/* Pixels per ms of receiving, unknown (-1) for a mostly idle screen */
+		rate = -1;
+		if (gpdata->adapt_period_pixels >= REMMINA_PLUGIN_VNC_ADAPT_MIN_PIXELS)
+			rate = gpdata->adapt_period_pixels * 1000 / MAX(gpdata->adapt_busy, 1);
+		rtt = gpdata->adapt_rtt / 1000;
+		quality = cl->appData.qualityLevel;
+		compress = cl->appData.compressLevel;
+
+		if ((rate >= 0 && rate < REMMINA_PLUGIN_VNC_ADAPT_RATE_LOW) || rtt > REMMINA_PLUGIN_VNC_ADAPT_RTT_HIGH)
+		{
+			quality = MAX(quality - 1, gpdata->adapt_quality_min);
+			compress = MIN(compress + 1, gpdata->adapt_compress_max);
+		}
+		else if ((rate < 0 || rate > REMMINA_PLUGIN_VNC_ADAPT_RATE_HIGH) && rtt < REMMINA_PLUGIN_VNC_ADAPT_RTT_LOW)
+		{
+			quality = MIN(quality + 1, gpdata->adapt_quality_max);
+			compress = MAX(compress - 1, gpdata->adapt_compress_min);
+		}
+
+		if (quality != cl->appData.qualityLevel || compress != cl->appData.compressLevel)
+		{
+			cl->appData.qualityLevel = quality;
+			cl->appData.compressLevel = compress;
+			SetFormatAndEncodings(cl);
+		}
+	}
+
+	gpdata->adapt_period_start = end;
+	gpdata->adapt_busy = 0;
+	gpdata->adapt_period_pixels = 0;
+	gpdata->adapt_rtt = -1;
+	gpdata->adapt_updates = 0;
 }
 
 static void remmina_plugin_vnc_update_colordepth(rfbClient *cl, gint colordepth)
@@ -653,26 +891,28 @@ static rfbBool remmina_plugin_vnc_rfb_allocfb(rfbClient *cl)
 	RemminaPluginVncData *gpdata = GET_PLUGIN_DATA(gp);
 	gint width, height, depth, size;
 	gboolean scale;
-	GdkPixbuf *new_pixbuf, *old_pixbuf;
+	cairo_surface_t *new_surface, *old_surface;
 
 	width = cl->width;
 	height = cl->height;
 	depth = cl->format.bitsPerPixel;
 	size = width * height * (depth / 8);
 
-	/* Putting gdk_pixbuf_new inside a gdk_thread_enter/leave pair could cause dead-lock! */
-	new_pixbuf = gdk_pixbuf_new(GDK_COLORSPACE_RGB, FALSE, 8, width, height);
-	if (new_pixbuf == NULL)
+	/* Image surfaces are created cleared to black */
+	new_surface = cairo_image_surface_create(CAIRO_FORMAT_RGB24, width, height);
+	if (cairo_surface_status(new_surface) != CAIRO_STATUS_SUCCESS)
+	{
+		cairo_surface_destroy(new_surface);
 		return FALSE;
-	gdk_pixbuf_fill(new_pixbuf, 0);
-	old_pixbuf = gpdata->rgb_buffer;
+	}
+	old_surface = gpdata->rgb_buffer;
 
 	LOCK_BUFFER (TRUE)
 
 	remmina_plugin_service->protocol_plugin_set_width(gp, cl->width);
 	remmina_plugin_service->protocol_plugin_set_height(gp, cl->height);
 
-	gpdata->rgb_buffer = new_pixbuf;
+	gpdata->rgb_buffer = new_surface;
 
 	if (gpdata->vnc_buffer)
 		g_free(gpdata->vnc_buffer);
@@ -681,15 +921,15 @@ static rfbBool remmina_plugin_vnc_rfb_allocfb(rfbClient *cl)
 
 	UNLOCK_BUFFER (TRUE)
 
-	if (old_pixbuf)
-		g_object_unref(old_pixbuf);
+	if (old_surface)
+		cairo_surface_destroy(old_surface);
 
 	scale = remmina_plugin_service->protocol_plugin_get_scale(gp);
 
 	remmina_plugin_vnc_update_scale( gp, scale);
 
-	if (gpdata->scale_handler == 0)
-		remmina_plugin_vnc_update_scale_buffer(gp, TRUE);
+	/* The frames have the size of the old desktop, replace them now */
+	onMainThread_update_scale_buffer(gp);
 
 	/* Notify window of change so that scroll border can be hidden or shown if needed */
 	remmina_plugin_service->protocol_plugin_emit_signal(gp, "desktop-resize");
@@ -701,141 +941,109 @@ static rfbBool remmina_plugin_vnc_rfb_allocfb(rfbClient *cl)
 	return TRUE;
 }
 
-static gint remmina_plugin_vnc_bits(gint n)
-{
-	TRACE_CALL("remmina_plugin_vnc_bits");
-	gint b = 0;
-	while (n)
-	{
-		b++;
-		n >>= 1;
-	}
-	return b ? b : 1;
-}
-
 static gboolean remmina_plugin_vnc_queue_draw_area_real(RemminaProtocolWidget *gp)
 {
 	TRACE_CALL("remmina_plugin_vnc_queue_draw_area_real");
 	RemminaPluginVncData *gpdata = GET_PLUGIN_DATA(gp);
-	gint x, y, w, h;
+	cairo_region_t *region;
+	gint width, height;
 
 	if (GTK_IS_WIDGET(gp) && gpdata->connected)
 	{
-		LOCK_BUFFER (FALSE)
-		x = gpdata->queuedraw_x;
-		y = gpdata->queuedraw_y;
-		w = gpdata->queuedraw_w;
-		h = gpdata->queuedraw_h;
+		LOCK_QUEUE (FALSE)
+		region = gpdata->queuedraw_region;
+		gpdata->queuedraw_region = NULL;
 		gpdata->queuedraw_handler = 0;
-		UNLOCK_BUFFER (FALSE)
+		UNLOCK_QUEUE (FALSE)
 
-		gtk_widget_queue_draw_area(GTK_WIDGET(gp), x, y, w, h);
+		if (region)
+		{
+			/* Damage is in frame coordinates, which only match the widget
+			 * when the frames are not being stretched */
+			remmina_plugin_vnc_get_view_size(gp, &width, &height);
+			if (remmina_plugin_service->protocol_plugin_get_scale(gp)
+					&& (width != gpdata->scale_width || height != gpdata->scale_height))
+				gtk_widget_queue_draw(GTK_WIDGET(gp));
+			else
+				gtk_widget_queue_draw_region(GTK_WIDGET(gp), region);
+			cairo_region_destroy(region);
+		}
 	}
 	return FALSE;
 }
 
-static void remmina_plugin_vnc_queue_draw_area(RemminaProtocolWidget *gp, gint x, gint y, gint w, gint h)
+static void remmina_plugin_vnc_queue_draw_region(RemminaProtocolWidget *gp, const cairo_region_t *damage)
 {
-	TRACE_CALL("remmina_plugin_vnc_queue_draw_area");
+	TRACE_CALL("remmina_plugin_vnc_queue_draw_region");
 	RemminaPluginVncData *gpdata = GET_PLUGIN_DATA(gp);
-	gint nx2, ny2, ox2, oy2;
 
-	LOCK_BUFFER (TRUE)
-	if (gpdata->queuedraw_handler)
+	/* Called with buffer_mutex held, so cancellation is already deferred */
+	LOCK_QUEUE (FALSE)
+	if (!gpdata->queuedraw_region)
+		gpdata->queuedraw_region = cairo_region_create();
+	cairo_region_union(gpdata->queuedraw_region, damage);
+	remmina_plugin_vnc_damage_coalesce(gpdata->queuedraw_region);
+	if (!gpdata->queuedraw_handler)
 	{
-		nx2 = x + w;
-		ny2 = y + h;
-		ox2 = gpdata->queuedraw_x + gpdata->queuedraw_w;
-		oy2 = gpdata->queuedraw_y + gpdata->queuedraw_h;
-		gpdata->queuedraw_x = MIN(gpdata->queuedraw_x, x);
-		gpdata->queuedraw_y = MIN(gpdata->queuedraw_y, y);
-		gpdata->queuedraw_w = MAX(ox2, nx2) - gpdata->queuedraw_x;
-		gpdata->queuedraw_h = MAX(oy2, ny2) - gpdata->queuedraw_y;
-	}
-	else
-	{
-		gpdata->queuedraw_x = x;
-		gpdata->queuedraw_y = y;
-		gpdata->queuedraw_w = w;
-		gpdata->queuedraw_h = h;
 		gpdata->queuedraw_handler = IDLE_ADD((GSourceFunc) remmina_plugin_vnc_queue_draw_area_real, gp);
 	}
-UNLOCK_BUFFER (TRUE)
+	UNLOCK_QUEUE (FALSE)
 }
 
-static void remmina_plugin_vnc_rfb_fill_buffer(rfbClient* cl, guchar *dest, gint dest_rowstride, guchar *src,
-		gint src_rowstride, guchar *mask, gint w, gint h)
+static void remmina_plugin_vnc_publish_frame(RemminaProtocolWidget *gp)
 {
-	TRACE_CALL("remmina_plugin_vnc_rfb_fill_buffer");
-	guchar *destptr, *srcptr;
-	gint bytesPerPixel;
-	guint32 pixel;
-	gint ix, iy;
-	gint i;
-	guchar c;
-	gint rs, gs, bs, rm, gm, bm, rl, gl, bl, rr, gr, br;
-	gint r;
+	TRACE_CALL("remmina_plugin_vnc_publish_frame");
+	RemminaPluginVncData *gpdata = GET_PLUGIN_DATA(gp);
+	gint published, ready, i;
+
+	LOCK_BUFFER (TRUE)
 
-	bytesPerPixel = cl->format.bitsPerPixel / 8;
-	switch (cl->format.bitsPerPixel)
+	if (gpdata->frames[gpdata->frame_back] && !cairo_region_is_empty(gpdata->frame_damage))
 	{
-		case 32:
-			/* The following codes fill in the Alpha channel swap red/green value */
-			for (iy = 0; iy < h; iy++)
-			{
-				destptr = dest + iy * dest_rowstride;
-				srcptr = src + iy * src_rowstride;
-				for (ix = 0; ix < w; ix++)
-				{
-					*destptr++ = *(srcptr + 2);
-					*destptr++ = *(srcptr + 1);
-					*destptr++ = *srcptr;
-					if (mask)
-						*destptr++ = (*mask++) ? 0xff : 0x00;
-					srcptr += 4;
-				}
-			}
-			break;
-		default:
-			rm = cl->format.redMax;
-			gm = cl->format.greenMax;
-			bm = cl->format.blueMax;
-			rr = remmina_plugin_vnc_bits(rm);
-			gr = remmina_plugin_vnc_bits(gm);
-			br = remmina_plugin_vnc_bits(bm);
-			rl = 8 - rr;
-			gl = 8 - gr;
-			bl = 8 - br;
-			rs = cl->format.redShift;
-			gs = cl->format.greenShift;
-			bs = cl->format.blueShift;
-			for (iy = 0; iy < h; iy++)
-			{
-				destptr = dest + iy * dest_rowstride;
-				srcptr = src + iy * src_rowstride;
-				for (ix = 0; ix < w; ix++)
-				{
-					pixel = 0;
-					for (i = 0; i < bytesPerPixel; i++)
-						pixel += (*srcptr++) << (8 * i);
-					c = (guchar)((pixel >> rs) & rm) << rl;
-					for (r = rr; r < 8; r *= 2)
-						c |= c >> r;
-					*destptr++ = c;
-					c = (guchar)((pixel >> gs) & gm) << gl;
-					for (r = gr; r < 8; r *= 2)
-						c |= c >> r;
-					*destptr++ = c;
-					c = (guchar)((pixel >> bs) & bm) << bl;
-					for (r = br; r < 8; r *= 2)
-						c |= c >> r;
-					*destptr++ = c;
-					if (mask)
-						*destptr++ = (*mask++) ? 0xff : 0x00;
-				}
-			}
-			break;
+		published = gpdata->frame_back;
+		for (i = 0; i < REMMINA_PLUGIN_VNC_FRAMES; i++)
+		{
+			if (i != published)
+				cairo_region_union(gpdata->frame_stale[i], gpdata->frame_damage);
+		}
+
+		/* Hand the back frame to the GTK thread and take back whichever
+		 * frame it has not picked up (or has just released) */
+		do
+		{
+			ready = g_atomic_int_get(&gpdata->frame_ready);
+		} while (!g_atomic_int_compare_and_exchange(&gpdata->frame_ready, ready,
+				published | REMMINA_PLUGIN_VNC_FRAME_FRESH));
+		gpdata->frame_back = ready & REMMINA_PLUGIN_VNC_FRAME_INDEX;
+
+		/* Bring the new back frame up to date with the published one */
+		remmina_plugin_vnc_copy_region(gpdata->frames[gpdata->frame_back], gpdata->frames[published],
+				gpdata->frame_stale[gpdata->frame_back]);
+		cairo_region_subtract(gpdata->frame_stale[gpdata->frame_back], gpdata->frame_stale[gpdata->frame_back]);
+
+		remmina_plugin_vnc_queue_draw_region(gp, gpdata->frame_damage);
+		cairo_region_subtract(gpdata->frame_damage, gpdata->frame_damage);
 	}
+	else if (!gpdata->frames[gpdata->frame_back] && !cairo_region_is_empty(gpdata->frame_damage))
+	{
+		/* No frames when unscaled, rgb_buffer is painted as it is */
+		remmina_plugin_vnc_queue_draw_region(gp, gpdata->frame_damage);
+		cairo_region_subtract(gpdata->frame_damage, gpdata->frame_damage);
+	}
+
+	UNLOCK_BUFFER (TRUE)
+}
+
+static RemminaPluginVncConverter *remmina_plugin_vnc_get_converter(rfbClient *cl)
+{
+	TRACE_CALL("remmina_plugin_vnc_get_converter");
+	RemminaProtocolWidget *gp = rfbClientGetClientData(cl, NULL);
+	RemminaPluginVncData *gpdata = GET_PLUGIN_DATA(gp);
+
+	/* The lookup tables of the converter only depend on the pixel format */
+	if (!remmina_plugin_vnc_converter_matches(&gpdata->converter, &cl->format))
+		remmina_plugin_vnc_converter_init(&gpdata->converter, &cl->format);
+	return &gpdata->converter;
 }
 
 static void remmina_plugin_vnc_rfb_updatefb(rfbClient* cl, int x, int y, int w, int h)
@@ -846,27 +1054,37 @@ static void remmina_plugin_vnc_rfb_updatefb(rfbClient* cl, int x, int y, int w,
 	gint bytesPerPixel;
 	gint rowstride;
 	gint width;
+	cairo_rectangle_int_t rect;
+	gint64 start;
 
+	/* Local work, kept out of the time the adaptive quality charges to the link */
+	start = g_get_monotonic_time();
 	LOCK_BUFFER (TRUE)
 
 	if (w >= 1 || h >= 1)
 	{
 		width = remmina_plugin_service->protocol_plugin_get_width(gp);
 		bytesPerPixel = cl->format.bitsPerPixel / 8;
-		rowstride = gdk_pixbuf_get_rowstride(gpdata->rgb_buffer);
-		remmina_plugin_vnc_rfb_fill_buffer(cl, gdk_pixbuf_get_pixels(gpdata->rgb_buffer) + y * rowstride + x * 3,
-				rowstride, gpdata->vnc_buffer + ((y * width + x) * bytesPerPixel), width * bytesPerPixel, NULL,
-				w, h);
-	}
-
-	if (remmina_plugin_service->protocol_plugin_get_scale(gp))
-	{
+		rowstride = cairo_image_surface_get_stride(gpdata->rgb_buffer);
+		cairo_surface_flush(gpdata->rgb_buffer);
+		remmina_plugin_vnc_converter_fill(remmina_plugin_vnc_get_converter(cl),
+				cairo_image_surface_get_data(gpdata->rgb_buffer) + y * rowstride + x * 4, rowstride,
+				gpdata->vnc_buffer + ((y * width + x) * bytesPerPixel), width * bytesPerPixel, w, h);
+		cairo_surface_mark_dirty_rectangle(gpdata->rgb_buffer, x, y, w, h);
+		gpdata->adapt_pixels += w * h;
+
+		/* Render into the back frame, it is published once the whole
+		 * server message has been handled */
 		remmina_plugin_vnc_scale_area(gp, &x, &y, &w, &h);
+		rect.x = x;
+		rect.y = y;
+		rect.width = w;
+		rect.height = h;
+		cairo_region_union_rectangle(gpdata->frame_damage, &rect);
 	}
 
 	UNLOCK_BUFFER (TRUE)
-
-	remmina_plugin_vnc_queue_draw_area(gp, x, y, w, h);
+	gpdata->adapt_client += g_get_monotonic_time() - start;
 }
 
 static gboolean remmina_plugin_vnc_queue_cuttext(RemminaPluginVncCuttextParam *param)
@@ -1047,14 +1265,14 @@ static void remmina_plugin_vnc_rfb_cursor_shape(rfbClient *cl, int xhot, int yho
 	if (width && height)
 	{
 		pixbuf_data = g_malloc(width * height * 4);
-		remmina_plugin_vnc_rfb_fill_buffer(cl, pixbuf_data, width * 4, cl->rcSource,
-				width * cl->format.bitsPerPixel / 8, cl->rcMask, width, height);
+		remmina_plugin_vnc_converter_fill_rgba(remmina_plugin_vnc_get_converter(cl), pixbuf_data, width * 4,
+				cl->rcSource, width * cl->format.bitsPerPixel / 8, cl->rcMask, width, height);
 		pixbuf = gdk_pixbuf_new_from_data(pixbuf_data, GDK_COLORSPACE_RGB, TRUE, 8, width, height, width * 4,
 				(GdkPixbufDestroyNotify) g_free, NULL);
 
-		LOCK_BUFFER (TRUE)
+		LOCK_QUEUE (TRUE)
 		remmina_plugin_vnc_queuecursor(gp, pixbuf, xhot, yhot);
-UNLOCK_BUFFER	(TRUE)
+		UNLOCK_QUEUE (TRUE)
 }
 }
 
@@ -1240,6 +1458,7 @@ static gboolean remmina_plugin_vnc_main_loop(RemminaProtocolWidget *gp)
 	rfbClient *cl;
 	fd_set fds;
 	struct timeval timeout;
+	gint64 wait, start, end, pixels, client;
 
 	if (!gpdata->connected)
 	{
@@ -1253,21 +1472,35 @@ static gboolean remmina_plugin_vnc_main_loop(RemminaProtocolWidget *gp)
 	timeout.tv_usec = 0;
 	FD_ZERO(&fds);
 	FD_SET(cl->sock, &fds);
-	FD_SET(gpdata->vnc_event_pipe[0], &fds);
-	ret = select(MAX(cl->sock, gpdata->vnc_event_pipe[0]) + 1, &fds, NULL, NULL, &timeout);
+	FD_SET(remmina_plugin_vnc_event_queue_get_fd(&gpdata->vnc_events), &fds);
+	wait = g_get_monotonic_time();
+	ret = select(MAX(cl->sock, remmina_plugin_vnc_event_queue_get_fd(&gpdata->vnc_events)) + 1, &fds, NULL, NULL, &timeout);
 
 	/* Sometimes it returns <0 when opening a modal dialog in other window. Absolutely weird */
 	/* So we continue looping anyway */
 	if (ret <= 0)
 		return TRUE;
 
-	if (FD_ISSET(gpdata->vnc_event_pipe[0], &fds))
+	if (FD_ISSET(remmina_plugin_vnc_event_queue_get_fd(&gpdata->vnc_events), &fds))
 	{
 		remmina_plugin_vnc_process_vnc_event(gp);
 	}
 	if (FD_ISSET(cl->sock, &fds))
 	{
+		start = g_get_monotonic_time();
+		pixels = gpdata->adapt_pixels;
+		client = gpdata->adapt_client;
 		ret = HandleRFBServerMessage(cl);
+		end = g_get_monotonic_time();
+		if (ret && gpdata->adapt_pixels != pixels)
+		{
+			/* Only receiving the message counts against the link, the
+			 * pixel conversion and scaling in it and publishing do not */
+			if (gpdata->adapt_enabled)
+				remmina_plugin_vnc_adapt_sample(gpdata, cl, wait, start, end,
+						end - start - (gpdata->adapt_client - client), gpdata->adapt_pixels - pixels);
+			remmina_plugin_vnc_publish_frame(gp);
+		}
 		if (!ret)
 		{
 			gpdata->running = FALSE;
@@ -1368,6 +1601,9 @@ static gboolean remmina_plugin_vnc_main(RemminaProtocolWidget *gp)
 				remmina_plugin_service->file_get_int(remminafile, "showcursor", FALSE) ? FALSE : TRUE);
 
 		remmina_plugin_vnc_update_quality(cl, remmina_plugin_service->file_get_int(remminafile, "quality", 0));
+		remmina_plugin_vnc_adapt_reset(gpdata, cl,
+				remmina_plugin_service->file_get_int(remminafile, "adaptivequality", FALSE),
+				remmina_plugin_service->file_get_int(remminafile, "adaptivequality_min", 0));
 		remmina_plugin_vnc_update_colordepth(cl, remmina_plugin_service->file_get_int(remminafile, "colordepth", 8));
 		SetFormatAndEncodings(cl);
 
@@ -1432,6 +1668,8 @@ static gboolean remmina_plugin_vnc_main(RemminaProtocolWidget *gp)
 
 	remmina_plugin_service->protocol_plugin_emit_signal(gp, "connect");
 
+	remmina_plugin_service->log_printf("[VNC]Using %s pixel conversion\n", remmina_plugin_vnc_pixel_get_impl_name());
+
 	if (remmina_plugin_service->file_get_int(remminafile, "disableserverinput", FALSE))
 	{
 		PermitServerInput(cl, 1);
@@ -1471,6 +1709,7 @@ static gboolean remmina_plugin_vnc_on_motion(GtkWidget *widget, GdkEventMotion *
 	RemminaPluginVncData *gpdata = GET_PLUGIN_DATA(gp);
 	RemminaFile *remminafile;
 	gint x, y;
+	gint view_width, view_height;
 
 	if (!gpdata->connected || !gpdata->client)
 		return FALSE;
@@ -1480,8 +1719,9 @@ static gboolean remmina_plugin_vnc_on_motion(GtkWidget *widget, GdkEventMotion *
 
 	if (remmina_plugin_service->protocol_plugin_get_scale(gp))
 	{
-		x = event->x * remmina_plugin_service->protocol_plugin_get_width(gp) / gpdata->scale_width;
-		y = event->y * remmina_plugin_service->protocol_plugin_get_height(gp) / gpdata->scale_height;
+		remmina_plugin_vnc_get_view_size(gp, &view_width, &view_height);
+		x = event->x * remmina_plugin_service->protocol_plugin_get_width(gp) / view_width;
+		y = event->y * remmina_plugin_service->protocol_plugin_get_height(gp) / view_height;
 	}
 	else
 	{
@@ -1499,6 +1739,7 @@ static gboolean remmina_plugin_vnc_on_button(GtkWidget *widget, GdkEventButton *
 	RemminaPluginVncData *gpdata = GET_PLUGIN_DATA(gp);
 	RemminaFile *remminafile;
 	gint x, y;
+	gint view_width, view_height;
 	gint mask;
 
 	if (!gpdata->connected || !gpdata->client)
@@ -1519,8 +1760,9 @@ static gboolean remmina_plugin_vnc_on_button(GtkWidget *widget, GdkEventButton *
 	(gpdata->button_mask & (0xff - mask)))
 ;	if (remmina_plugin_service->protocol_plugin_get_scale(gp))
 	{
-		x = event->x * remmina_plugin_service->protocol_plugin_get_width(gp) / gpdata->scale_width;
-		y = event->y * remmina_plugin_service->protocol_plugin_get_height(gp) / gpdata->scale_height;
+		remmina_plugin_vnc_get_view_size(gp, &view_width, &view_height);
+		x = event->x * remmina_plugin_service->protocol_plugin_get_width(gp) / view_width;
+		y = event->y * remmina_plugin_service->protocol_plugin_get_height(gp) / view_height;
 	}
 	else
 	{
@@ -1538,6 +1780,7 @@ static gboolean remmina_plugin_vnc_on_scroll(GtkWidget *widget, GdkEventScroll *
 	RemminaPluginVncData *gpdata = GET_PLUGIN_DATA(gp);
 	RemminaFile *remminafile;
 	gint x, y;
+	gint view_width, view_height;
 	gint mask;
 
 	if (!gpdata->connected || !gpdata->client)
@@ -1580,8 +1823,9 @@ static gboolean remmina_plugin_vnc_on_scroll(GtkWidget *widget, GdkEventScroll *
 
 	if (remmina_plugin_service->protocol_plugin_get_scale(gp))
 	{
-		x = event->x * remmina_plugin_service->protocol_plugin_get_width(gp) / gpdata->scale_width;
-		y = event->y * remmina_plugin_service->protocol_plugin_get_height(gp) / gpdata->scale_height;
+		remmina_plugin_vnc_get_view_size(gp, &view_width, &view_height);
+		x = event->x * remmina_plugin_service->protocol_plugin_get_width(gp) / view_width;
+		y = event->y * remmina_plugin_service->protocol_plugin_get_height(gp) / view_height;
 	}
 	else
 	{
@@ -1782,6 +2026,7 @@ static gboolean remmina_plugin_vnc_close_connection_timeout(RemminaProtocolWidge
 {
 	TRACE_CALL("remmina_plugin_vnc_close_connection_timeout");
 	RemminaPluginVncData *gpdata = GET_PLUGIN_DATA(gp);
+	gchar *latency;
 
 	/* wait until the running attribute is set to false by the VNC thread */
 	if (gpdata->running)
@@ -1810,6 +2055,11 @@ static gboolean remmina_plugin_vnc_close_connection_timeout(RemminaProtocolWidge
 		g_source_remove(gpdata->queuedraw_handler);
 		gpdata->queuedraw_handler = 0;
 	}
+	if (gpdata->queuedraw_region)
+	{
+		cairo_region_destroy(gpdata->queuedraw_region);
+		gpdata->queuedraw_region = NULL;
+	}
 	if (gpdata->scale_handler)
 	{
 		g_source_remove(gpdata->scale_handler);
@@ -1826,7 +2076,7 @@ static gboolean remmina_plugin_vnc_close_connection_timeout(RemminaProtocolWidge
 	}
 	if (gpdata->rgb_buffer)
 	{
-		g_object_unref(gpdata->rgb_buffer);
+		cairo_surface_destroy(gpdata->rgb_buffer);
 		gpdata->rgb_buffer = NULL;
 	}
 	if (gpdata->vnc_buffer)
@@ -1834,20 +2084,24 @@ static gboolean remmina_plugin_vnc_close_connection_timeout(RemminaProtocolWidge
 		g_free(gpdata->vnc_buffer);
 		gpdata->vnc_buffer = NULL;
 	}
-	if (gpdata->scale_buffer)
+	remmina_plugin_vnc_free_frames(gpdata);
+	if (gpdata->frame_damage)
+	{
+		cairo_region_destroy(gpdata->frame_damage);
+		gpdata->frame_damage = NULL;
+	}
+	if (gpdata->draw_latency.count)
 	{
-		g_object_unref(gpdata->scale_buffer);
-		gpdata->scale_buffer = NULL;
+		latency = remmina_plugin_vnc_histogram_to_string(&gpdata->draw_latency);
+		remmina_plugin_service->log_printf("[VNC]Draw callback latency: %s\n", latency);
+		g_free(latency);
 	}
 	g_ptr_array_free(gpdata->pressed_keys, TRUE);
-	remmina_plugin_vnc_event_free_all(gp);
-	g_queue_free(gpdata->vnc_event_queue);
-	pthread_mutex_destroy(&gpdata->vnc_event_queue_mutex);
-	close(gpdata->vnc_event_pipe[0]);
-	close(gpdata->vnc_event_pipe[1]);
+	remmina_plugin_vnc_event_queue_clear(&gpdata->vnc_events);
 
 
 	pthread_mutex_destroy (&gpdata->buffer_mutex);
+	pthread_mutex_destroy (&gpdata->queue_mutex);
 
 
 	remmina_plugin_service->protocol_plugin_emit_signal(gp, "disconnect");
@@ -1903,9 +2157,10 @@ static void remmina_plugin_vnc_call_feature(RemminaProtocolWidget *gp, const Rem
 	switch (feature->id)
 	{
 		case REMMINA_PLUGIN_VNC_FEATURE_PREF_QUALITY:
-			remmina_plugin_vnc_update_quality((rfbClient*) (gpdata->client),
-					remmina_plugin_service->file_get_int(remminafile, "quality", 0));
-			SetFormatAndEncodings((rfbClient*) (gpdata->client));
+			remmina_plugin_vnc_event_push(gp, REMMINA_PLUGIN_VNC_EVENT_QUALITY,
+					GINT_TO_POINTER(remmina_plugin_service->file_get_int(remminafile, "quality", 0)),
+					GINT_TO_POINTER(remmina_plugin_service->file_get_int(remminafile, "adaptivequality", FALSE)),
+					GINT_TO_POINTER(remmina_plugin_service->file_get_int(remminafile, "adaptivequality_min", 0)));
 			break;
 		case REMMINA_PLUGIN_VNC_FEATURE_PREF_VIEWONLY:
 			break;
@@ -1918,6 +2173,7 @@ static void remmina_plugin_vnc_call_feature(RemminaProtocolWidget *gp, const Rem
 			break;
 		case REMMINA_PLUGIN_VNC_FEATURE_SCALE:
 			remmina_plugin_vnc_update_scale(gp, remmina_plugin_service->file_get_int(remminafile, "scale", FALSE));
+			remmina_plugin_vnc_update_scale_buffer(gp);
 			break;
 		case REMMINA_PLUGIN_VNC_FEATURE_TOOL_REFRESH:
 			SendFramebufferUpdateRequest((rfbClient*) (gpdata->client), 0, 0,
@@ -1945,29 +2201,84 @@ static void remmina_plugin_vnc_keystroke(RemminaProtocolWidget *gp, const guint
 	return;
 }
 
-static gboolean remmina_plugin_vnc_on_draw(GtkWidget *widget, cairo_t *context, RemminaProtocolWidget *gp)
+static gboolean remmina_plugin_vnc_paint(RemminaProtocolWidget *gp, cairo_t *context)
 {
-	TRACE_CALL("remmina_plugin_vnc_on_draw");
+	TRACE_CALL("remmina_plugin_vnc_paint");
 	RemminaPluginVncData *gpdata = GET_PLUGIN_DATA(gp);
-	GdkPixbuf *buffer;
-	gboolean scale;
-
-	LOCK_BUFFER (FALSE)
+	cairo_surface_t *buffer;
+	gint ready;
+	gint width, height;
 
-	scale = remmina_plugin_service->protocol_plugin_get_scale(gp);
-	/* widget == gpdata->drawing_area */
-	buffer = (scale ? gpdata->scale_buffer : gpdata->rgb_buffer);
-	if (!buffer)
+	if (!remmina_plugin_service->protocol_plugin_get_scale(gp))
 	{
+		/* Unscaled: rgb_buffer is the desktop itself, painted under the
+		 * lock the VNC thread holds while it writes to it */
+		LOCK_BUFFER (FALSE)
+		if (!gpdata->rgb_buffer)
+		{
+			UNLOCK_BUFFER (FALSE)
+			return FALSE;
+		}
+		cairo_set_operator(context, CAIRO_OPERATOR_SOURCE);
+		cairo_set_source_surface(context, gpdata->rgb_buffer, 0, 0);
+		cairo_paint(context);
 		UNLOCK_BUFFER (FALSE)
+		return TRUE;
+	}
+
+	/* Pick up the last published frame, leaving ours for the VNC thread.
+	 * No lock is taken: frames are only replaced in this thread */
+	ready = g_atomic_int_get(&gpdata->frame_ready);
+	if (ready & REMMINA_PLUGIN_VNC_FRAME_FRESH)
+	{
+		while (!g_atomic_int_compare_and_exchange(&gpdata->frame_ready, ready, gpdata->frame_front))
+		{
+			ready = g_atomic_int_get(&gpdata->frame_ready);
+		}
+		gpdata->frame_front = ready & REMMINA_PLUGIN_VNC_FRAME_INDEX;
+	}
+
+	buffer = gpdata->frames[gpdata->frame_front];
+	if (!buffer)
 		return FALSE;
+
+	/* GTK has already clipped the context to the damaged region, so only
+	 * that part of the persistent surface is composited */
+	cairo_set_operator(context, CAIRO_OPERATOR_SOURCE);
+	remmina_plugin_vnc_get_view_size(gp, &width, &height);
+	if (remmina_plugin_service->protocol_plugin_get_scale(gp)
+			&& (width != gpdata->scale_width || height != gpdata->scale_height))
+	{
+		/* The widget is being resized: stretch the current frame with a
+		 * cheap filter until the size settles and the frames are rescaled */
+		cairo_scale(context, (double) width / gpdata->scale_width, (double) height / gpdata->scale_height);
+		cairo_set_source_surface(context, buffer, 0, 0);
+		cairo_pattern_set_filter(cairo_get_source(context), CAIRO_FILTER_BILINEAR);
+		cairo_pattern_set_extend(cairo_get_source(context), CAIRO_EXTEND_PAD);
+		if (!gpdata->scale_handler)
+			gpdata->scale_handler = g_timeout_add(REMMINA_PLUGIN_VNC_SCALE_SETTLE,
+					(GSourceFunc) remmina_plugin_vnc_update_scale_buffer_main, gp);
+	}
+	else
+	{
+		cairo_set_source_surface(context, buffer, 0, 0);
 	}
-	cairo_rectangle(context, 0, 0, gtk_widget_get_allocated_width(widget), gtk_widget_get_allocated_height(widget));
+	cairo_paint(context);
 
-	gdk_cairo_set_source_pixbuf(context, buffer, 0, 0);
-	cairo_fill(context);
+	return TRUE;
+}
 
-	UNLOCK_BUFFER (FALSE)
+static gboolean remmina_plugin_vnc_on_draw(GtkWidget *widget, cairo_t *context, RemminaProtocolWidget *gp)
+{
+	TRACE_CALL("remmina_plugin_vnc_on_draw");
+	RemminaPluginVncData *gpdata = GET_PLUGIN_DATA(gp);
+	gint64 start;
+
+	/* widget == gpdata->drawing_area */
+	start = g_get_monotonic_time();
+	if (!remmina_plugin_vnc_paint(gp, context))
+		return FALSE;
+	remmina_plugin_vnc_histogram_add(&gpdata->draw_latency, g_get_monotonic_time() - start);
 	return TRUE;
 }
 
@@ -1976,10 +2287,14 @@ static gboolean remmina_plugin_vnc_on_configure(GtkWidget *widget, GdkEventConfi
 	TRACE_CALL("remmina_plugin_vnc_on_configure");
 	RemminaPluginVncData *gpdata = GET_PLUGIN_DATA(gp);
 
-	/* We do a delayed reallocating to improve performance */
+	/* Frames are only rescaled once the size settles, meanwhile on_draw
+	 * stretches them. Unscaled frames have the size of the desktop */
+	if (!remmina_plugin_service->protocol_plugin_get_scale(gp))
+		return FALSE;
 	if (gpdata->scale_handler)
 		g_source_remove(gpdata->scale_handler);
-	gpdata->scale_handler = g_timeout_add(300, (GSourceFunc) remmina_plugin_vnc_update_scale_buffer_main, gp);
+	gpdata->scale_handler = g_timeout_add(REMMINA_PLUGIN_VNC_SCALE_SETTLE,
+			(GSourceFunc) remmina_plugin_vnc_update_scale_buffer_main, gp);
 	return FALSE;
 }
 
@@ -1987,7 +2302,6 @@ static void remmina_plugin_vnc_init(RemminaProtocolWidget *gp)
 {
 	TRACE_CALL("remmina_plugin_vnc_init");
 	RemminaPluginVncData *gpdata;
-	gint flags;
 
 	gpdata = g_new0(RemminaPluginVncData, 1);
 	g_object_set_data_full(G_OBJECT(gp), "plugin-data", gpdata, g_free);
@@ -2010,18 +2324,14 @@ static void remmina_plugin_vnc_init(RemminaProtocolWidget *gp)
 	g_get_current_time(&gpdata->clipboard_timer);
 	gpdata->listen_sock = -1;
 	gpdata->pressed_keys = g_ptr_array_new();
-	gpdata->vnc_event_queue = g_queue_new();
-	pthread_mutex_init(&gpdata->vnc_event_queue_mutex, NULL);
-	if (pipe(gpdata->vnc_event_pipe))
+	if (!remmina_plugin_vnc_event_queue_init(&gpdata->vnc_events))
 	{
 		g_print("Error creating pipes.\n");
-		gpdata->vnc_event_pipe[0] = 0;
-		gpdata->vnc_event_pipe[1] = 0;
 	}
-	flags = fcntl(gpdata->vnc_event_pipe[0], F_GETFL, 0);
-	fcntl(gpdata->vnc_event_pipe[0], F_SETFL, flags | O_NONBLOCK);
 
 	pthread_mutex_init (&gpdata->buffer_mutex, NULL);
+	pthread_mutex_init (&gpdata->queue_mutex, NULL);
+	gpdata->frame_damage = cairo_region_create();
 
 }
 
@@ -2103,6 +2413,8 @@ static const RemminaProtocolSetting remmina_plugin_vnc_advanced_settings[] =
 	{ REMMINA_PROTOCOL_SETTING_TYPE_CHECK, "disableencryption", N_("Disable encryption"), FALSE, NULL, NULL },
 	{ REMMINA_PROTOCOL_SETTING_TYPE_CHECK, "disableserverinput", N_("Disable server input"), TRUE, NULL, NULL },
 	{ REMMINA_PROTOCOL_SETTING_TYPE_CHECK, "disablepasswordstoring", N_("Disable password storing"), FALSE, NULL, NULL },
+	{ REMMINA_PROTOCOL_SETTING_TYPE_CHECK, "adaptivequality", N_("Adapt quality to network"), TRUE, NULL, NULL },
+	{ REMMINA_PROTOCOL_SETTING_TYPE_SELECT, "adaptivequality_min", N_("Lowest adaptive quality"), FALSE, quality_list, NULL },
 	{ REMMINA_PROTOCOL_SETTING_TYPE_END, NULL, NULL, FALSE, NULL, NULL }
 };
 
@@ -2171,6 +2483,9 @@ remmina_plugin_entry(RemminaPluginService *service)
 	TRACE_CALL("remmina_plugin_entry");
 	remmina_plugin_service = service;
 
+	remmina_plugin_vnc_pixel_select_impl();
+	remmina_plugin_vnc_scale_select_impl();
+
 	bindtextdomain(GETTEXT_PACKAGE, REMMINA_LOCALEDIR);
 	bind_textdomain_codeset(GETTEXT_PACKAGE, "UTF-8");
 
@@ -0,0 +1,360 @@
+/*
+ * Remmina - The GTK+ Remote Desktop Client
+ * Copyright (C) 2014-2015 Antenore Gatta, Fabio Castelli, Giovanni Panozzo
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ *
+ *  In addition, as a special exception, the copyright holders give
+ *  permission to link the code of portions of this program with the
+ *  OpenSSL library under certain conditions as described in each
+ *  individual source file, and distribute linked combinations
+ *  including the two.
+ *  You must obey the GNU General Public License in all respects
+ *  for all of the code used other than OpenSSL. *  If you modify
+ *  file(s) with this exception, you may extend this exception to your
+ *  version of the file(s), but you are not obligated to do so. *  If you
+ *  do not wish to do so, delete this exception statement from your
+ *  version. *  If you delete this exception statement from all source
+ *  files in the program, then also delete it here.
+ *
+ */
+
+/* Downscaling of the render surface into the display frames of scaled
+ * sessions. A separable box filter with per-axis weight tables computed once
+ * per size, applied only to the destination pixels whose footprint touches
+ * the updated area. Runs inside the VNC thread. As for the pixel conversion,
+ * the SIMD kernels are selected at runtime and give exactly the same pixels
+ * as the scalar code. */
+
+#include <string.h>
+#include "remmina/remmina_trace_calls.h"
+#include "vnc_scale.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define REMMINA_VNC_SCALE_X86
+#include <immintrin.h>
+#endif
+
+/* Weights are 1.14 fixed point, the horizontal pass keeps 7 fractional
+ * bits so that its output still fits signed 16 bit lanes */
+#define REMMINA_VNC_SCALE_ONE       (1 << 14)
+#define REMMINA_VNC_SCALE_H_SHIFT   7
+#define REMMINA_VNC_SCALE_V_SHIFT   (14 + 7)
+
+/* Filters source pixels horizontally into dw destination columns from dx0 */
+typedef void (*RemminaPluginVncScaleHRowFunc)(const RemminaPluginVncScaleAxis *axis, gint16 *dest, const guchar *src,
+		gint dx0, gint dw);
+/* Filters taps rows of n 16 bit channels, row_stride apart, into n bytes */
+typedef void (*RemminaPluginVncScaleVRowFunc)(const gint16 *rows, gint row_stride, const gint16 *weights, gint taps,
+		guchar *dest, gint n);
+
+typedef struct _RemminaPluginVncScaleImpl
+{
+	const gchar *name;
+	RemminaPluginVncScaleHRowFunc hrow;
+	RemminaPluginVncScaleVRowFunc vrow;
+} RemminaPluginVncScaleImpl;
+
+static void remmina_plugin_vnc_scale_hrow_c(const RemminaPluginVncScaleAxis *axis, gint16 *dest, const guchar *src,
+		gint dx0, gint dw)
+{
+	const guchar *p;
+	const gint16 *wt;
+	gint d, k, c, acc;
+
+	for (d = dx0; d < dx0 + dw; d++)
+	{
+		p = src + axis->start[d] * 4;
+		wt = axis->weights + d * axis->taps;
+		for (c = 0; c < 4; c++)
+		{
+			acc = 0;
+			for (k = 0; k < axis->taps; k++)
+				acc += wt[k] * p[k * 4 + c];
+			*dest++ = (acc + (1 << (REMMINA_VNC_SCALE_H_SHIFT - 1))) >> REMMINA_VNC_SCALE_H_SHIFT;
+		}
+	}
+}
+
+static void remmina_plugin_vnc_scale_vrow_c(const gint16 *rows, gint row_stride, const gint16 *weights, gint taps,
+		guchar *dest, gint n)
+{
+	gint i, k, acc;
+
+	for (i = 0; i < n; i++)
+	{
+		acc = 0;
+		for (k = 0; k < taps; k++)
+			acc += weights[k] * rows[k * row_stride + i];
+		dest[i] = (acc + (1 << (REMMINA_VNC_SCALE_V_SHIFT - 1))) >> REMMINA_VNC_SCALE_V_SHIFT;
+	}
+}
+
+#ifdef REMMINA_VNC_SCALE_X86
+
+/* ------------------------------ SSE2 kernels ------------------------------ */
+
+/* Two weights in the 16 bit lanes of each 32 bit lane, for _mm_madd_epi16 */
+static inline __attribute__((target("sse2"), always_inline))
+__m128i remmina_plugin_vnc_scale_weights_sse2(gint16 w0, gint16 w1)
+{
+	return _mm_set1_epi32((gint32) (((guint32) (guint16) w1 << 16) | (guint16) w0));
+}
+
+static __attribute__((target("sse2")))
+void remmina_plugin_vnc_scale_hrow_sse2(const RemminaPluginVncScaleAxis *axis, gint16 *dest, const guchar *src,
+		gint dx0, gint dw)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i round = _mm_set1_epi32(1 << (REMMINA_VNC_SCALE_H_SHIFT - 1));
+	const guchar *p;
+	const gint16 *wt;
+	__m128i acc, v;
+	gint32 pixel;
+	gint d, k;
+
+	for (d = dx0; d < dx0 + dw; d++)
+	{
+		p = src + axis->start[d] * 4;
+		wt = axis->weights + d * axis->taps;
+		acc = zero;
+		/* Two source pixels per step, their channels interleaved so that
+		 * each 32 bit lane sums one channel */
+		for (k = 0; k + 2 <= axis->taps; k += 2)
+		{
+			v = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*) (p + k * 4)), zero);
+			v = _mm_unpacklo_epi16(v, _mm_srli_si128(v, 8));
+			acc = _mm_add_epi32(acc, _mm_madd_epi16(v, remmina_plugin_vnc_scale_weights_sse2(wt[k], wt[k + 1])));
+		}
+		if (k < axis->taps)
+		{
+			memcpy(&pixel, p + k * 4, 4);
+			v = _mm_unpacklo_epi8(_mm_cvtsi32_si128(pixel), zero);
+			v = _mm_unpacklo_epi16(v, zero);
+			acc = _mm_add_epi32(acc, _mm_madd_epi16(v, remmina_plugin_vnc_scale_weights_sse2(wt[k], 0)));
+		}
+		acc = _mm_srli_epi32(_mm_add_epi32(acc, round), REMMINA_VNC_SCALE_H_SHIFT);
+		_mm_storel_epi64((__m128i*) dest, _mm_packs_epi32(acc, acc));
+		dest += 4;
+	}
+}
+
+static __attribute__((target("sse2")))
+void remmina_plugin_vnc_scale_vrow_sse2(const gint16 *rows, gint row_stride, const gint16 *weights, gint taps,
+		guchar *dest, gint n)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i round = _mm_set1_epi32(1 << (REMMINA_VNC_SCALE_V_SHIFT - 1));
+	__m128i lo, hi, a, b, wv;
+	gint i, k;
+
+	/* Two destination pixels (8 channels) per step */
+	for (i = 0; i + 8 <= n; i += 8)
+	{
+		lo = zero;
+		hi = zero;
+		for (k = 0; k + 2 <= taps; k += 2)
+		{
+			a = _mm_loadu_si128((const __m128i*) (rows + k * row_stride + i));
+			b = _mm_loadu_si128((const __m128i*) (rows + (k + 1) * row_stride + i));
+			wv = remmina_plugin_vnc_scale_weights_sse2(weights[k], weights[k + 1]);
+			lo = _mm_add_epi32(lo, _mm_madd_epi16(_mm_unpacklo_epi16(a, b), wv));
+			hi = _mm_add_epi32(hi, _mm_madd_epi16(_mm_unpackhi_epi16(a, b), wv));
+		}
+		if (k < taps)
+		{
+			a = _mm_loadu_si128((const __m128i*) (rows + k * row_stride + i));
+			wv = remmina_plugin_vnc_scale_weights_sse2(weights[k], 0);
+			lo = _mm_add_epi32(lo, _mm_madd_epi16(_mm_unpacklo_epi16(a, zero), wv));
+			hi = _mm_add_epi32(hi, _mm_madd_epi16(_mm_unpackhi_epi16(a, zero), wv));
+		}
+		lo = _mm_srli_epi32(_mm_add_epi32(lo, round), REMMINA_VNC_SCALE_V_SHIFT);
+		hi = _mm_srli_epi32(_mm_add_epi32(hi, round), REMMINA_VNC_SCALE_V_SHIFT);
+		a = _mm_packs_epi32(lo, hi);
+		_mm_storel_epi64((__m128i*) (dest + i), _mm_packus_epi16(a, a));
+	}
+	remmina_plugin_vnc_scale_vrow_c(rows + i, row_stride, weights, taps, dest + i, n - i);
+}
+
+#endif /* REMMINA_VNC_SCALE_X86 */
+
+static const RemminaPluginVncScaleImpl remmina_plugin_vnc_scale_impl_c =
+{ "scalar", remmina_plugin_vnc_scale_hrow_c, remmina_plugin_vnc_scale_vrow_c };
+
+#ifdef REMMINA_VNC_SCALE_X86
+static const RemminaPluginVncScaleImpl remmina_plugin_vnc_scale_impl_sse2 =
+{ "sse2", remmina_plugin_vnc_scale_hrow_sse2, remmina_plugin_vnc_scale_vrow_sse2 };
+#endif
+
+static const RemminaPluginVncScaleImpl *remmina_plugin_vnc_scale_impl = &remmina_plugin_vnc_scale_impl_c;
+
+/* Picks the fastest kernels supported by the running CPU. Must be called once
+ * before any VNC thread is started. WITH_SSE2 builds assume SSE2 is there */
+void remmina_plugin_vnc_scale_select_impl(void)
+{
+	TRACE_CALL("remmina_plugin_vnc_scale_select_impl");
+	remmina_plugin_vnc_scale_impl = &remmina_plugin_vnc_scale_impl_c;
+#ifdef REMMINA_VNC_SCALE_X86
+#if defined(WITH_SSE2) || defined(__SSE2__)
+	remmina_plugin_vnc_scale_impl = &remmina_plugin_vnc_scale_impl_sse2;
+#else
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("sse2"))
+		remmina_plugin_vnc_scale_impl = &remmina_plugin_vnc_scale_impl_sse2;
+#endif
+#endif
+}
+
+/* Destination pixel d averages the source interval [d * s, (d + 1) * s),
+ * s = src_len / dst_len >= 1, each source pixel weighted by its overlap */
+static void remmina_plugin_vnc_scale_axis_init(RemminaPluginVncScaleAxis *axis, gint src_len, gint dst_len)
+{
+	gdouble scale, lo, hi, overlap;
+	gint d, i, k, first, last, sum, big;
+	gint16 *wt;
+
+	axis->src_len = src_len;
+	axis->dst_len = dst_len;
+	scale = (gdouble) src_len / dst_len;
+
+	axis->taps = 1;
+	for (d = 0; d < dst_len; d++)
+	{
+		lo = d * scale;
+		hi = MIN((d + 1) * scale, src_len);
+		first = (gint) lo;
+		last = (gint) hi;
+		if (last < hi)
+			last++;
+		axis->taps = MAX(axis->taps, last - first);
+	}
+	axis->taps = MIN(axis->taps, src_len);
+
+	axis->start = g_new(gint, dst_len);
+	axis->weights = g_new0(gint16, dst_len * axis->taps);
+	for (d = 0; d < dst_len; d++)
+	{
+		lo = d * scale;
+		hi = MIN((d + 1) * scale, src_len);
+		first = (gint) lo;
+		last = (gint) hi;
+		if (last < hi)
+			last++;
+		/* All rows have the same number of taps, so near the end the window
+		 * starts earlier and the extra taps get a zero weight */
+		axis->start[d] = MIN(first, src_len - axis->taps);
+		wt = axis->weights + d * axis->taps;
+		sum = 0;
+		big = first - axis->start[d];
+		for (i = first; i < last; i++)
+		{
+			k = i - axis->start[d];
+			overlap = MIN(i + 1, hi) - MAX(i, lo);
+			wt[k] = (gint16) (overlap / scale * REMMINA_VNC_SCALE_ONE + 0.5);
+			sum += wt[k];
+			if (wt[k] > wt[big])
+				big = k;
+		}
+		/* Keep the sum exactly 1, so flat areas stay flat */
+		wt[big] += REMMINA_VNC_SCALE_ONE - sum;
+	}
+}
+
+RemminaPluginVncScaler *remmina_plugin_vnc_scaler_new(gint src_width, gint src_height, gint dst_width, gint dst_height)
+{
+	TRACE_CALL("remmina_plugin_vnc_scaler_new");
+	RemminaPluginVncScaler *scaler;
+
+	/* Only for downscaling, a box filter does not interpolate */
+	if (dst_width < 1 || dst_height < 1 || dst_width > src_width || dst_height > src_height)
+		return NULL;
+
+	scaler = g_new0(RemminaPluginVncScaler, 1);
+	remmina_plugin_vnc_scale_axis_init(&scaler->x, src_width, dst_width);
+	remmina_plugin_vnc_scale_axis_init(&scaler->y, src_height, dst_height);
+	return scaler;
+}
+
+void remmina_plugin_vnc_scaler_free(RemminaPluginVncScaler *scaler)
+{
+	TRACE_CALL("remmina_plugin_vnc_scaler_free");
+	g_free(scaler->x.start);
+	g_free(scaler->x.weights);
+	g_free(scaler->y.start);
+	g_free(scaler->y.weights);
+	g_free(scaler->rows);
+	g_free(scaler);
+}
+
+/* Destination pixels whose footprint may touch [pos, pos + len) */
+static void remmina_plugin_vnc_scale_axis_range(const RemminaPluginVncScaleAxis *axis, gint pos, gint len, gint *d0, gint *d1)
+{
+	*d0 = MAX(0, (gint) ((gint64) pos * axis->dst_len / axis->src_len) - 1);
+	*d1 = MIN(axis->dst_len,
+			(gint) (((gint64) (pos + len) * axis->dst_len + axis->src_len - 1) / axis->src_len) + 1);
+}
+
+/* Scales the source area x, y, w, h (CAIRO_FORMAT_RGB24) into dest and
+ * returns in x, y, w, h the destination area that has been written */
+void remmina_plugin_vnc_scaler_scale(RemminaPluginVncScaler *scaler, guchar *dest, gint dest_rowstride,
+		const guchar *src, gint src_rowstride, gint *x, gint *y, gint *w, gint *h)
+{
+	TRACE_CALL("remmina_plugin_vnc_scaler_scale");
+	gint dx0, dx1, dy0, dy1, dw;
+	gint sy0, sy1, sy, dy;
+	gint row_stride;
+	gsize size;
+
+	remmina_plugin_vnc_scale_axis_range(&scaler->x, *x, *w, &dx0, &dx1);
+	remmina_plugin_vnc_scale_axis_range(&scaler->y, *y, *h, &dy0, &dy1);
+	if (dx0 >= dx1 || dy0 >= dy1)
+	{
+		*w = 0;
+		*h = 0;
+		return;
+	}
+	dw = dx1 - dx0;
+	row_stride = dw * 4;
+
+	/* Horizontal pass over every source row the destination rows need */
+	sy0 = scaler->y.start[dy0];
+	sy1 = scaler->y.start[dy1 - 1] + scaler->y.taps;
+	size = (gsize) (sy1 - sy0) * row_stride;
+	if (size > scaler->rows_size)
+	{
+		g_free(scaler->rows);
+		scaler->rows = g_new(gint16, size);
+		scaler->rows_size = size;
+	}
+	for (sy = sy0; sy < sy1; sy++)
+	{
+		remmina_plugin_vnc_scale_impl->hrow(&scaler->x, scaler->rows + (sy - sy0) * row_stride,
+				src + sy * src_rowstride, dx0, dw);
+	}
+
+	/* Vertical pass */
+	for (dy = dy0; dy < dy1; dy++)
+	{
+		remmina_plugin_vnc_scale_impl->vrow(scaler->rows + (scaler->y.start[dy] - sy0) * row_stride, row_stride,
+				scaler->y.weights + dy * scaler->y.taps, scaler->y.taps,
+				dest + dy * dest_rowstride + dx0 * 4, row_stride);
+	}
+
+	*x = dx0;
+	*y = dy0;
+	*w = dw;
+	*h = dy1 - dy0;
+}
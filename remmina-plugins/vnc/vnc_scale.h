@@ -0,0 +1,72 @@
+/*
+ * Remmina - The GTK+ Remote Desktop Client
+ * Copyright (C) 2014-2015 Antenore Gatta, Fabio Castelli, Giovanni Panozzo
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ *
+ *  In addition, as a special exception, the copyright holders give
+ *  permission to link the code of portions of this program with the
+ *  OpenSSL library under certain conditions as described in each
+ *  individual source file, and distribute linked combinations
+ *  including the two.
+ *  You must obey the GNU General Public License in all respects
+ *  for all of the code used other than OpenSSL. *  If you modify
+ *  file(s) with this exception, you may extend this exception to your
+ *  version of the file(s), but you are not obligated to do so. *  If you
+ *  do not wish to do so, delete this exception statement from your
+ *  version. *  If you delete this exception statement from all source
+ *  files in the program, then also delete it here.
+ *
+ */
+
+#ifndef __REMMINA_VNC_SCALE_H__
+#define __REMMINA_VNC_SCALE_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Box filter weights along one axis. Destination pixel d is the weighted sum
+ * of the taps source pixels starting at start[d], with 14 bit fixed point
+ * weights adding up to exactly 1 */
+typedef struct _RemminaPluginVncScaleAxis
+{
+	gint src_len;
+	gint dst_len;
+	gint taps;
+	gint *start;
+	gint16 *weights;
+} RemminaPluginVncScaleAxis;
+
+typedef struct _RemminaPluginVncScaler
+{
+	RemminaPluginVncScaleAxis x;
+	RemminaPluginVncScaleAxis y;
+	/* Horizontally filtered source rows, 4 x 16 bit channels per pixel */
+	gint16 *rows;
+	gsize rows_size;
+} RemminaPluginVncScaler;
+
+void remmina_plugin_vnc_scale_select_impl(void);
+
+RemminaPluginVncScaler *remmina_plugin_vnc_scaler_new(gint src_width, gint src_height, gint dst_width, gint dst_height);
+void remmina_plugin_vnc_scaler_free(RemminaPluginVncScaler *scaler);
+void remmina_plugin_vnc_scaler_scale(RemminaPluginVncScaler *scaler, guchar *dest, gint dest_rowstride,
+		const guchar *src, gint src_rowstride, gint *x, gint *y, gint *w, gint *h);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,203 @@
+/*
+ * Remmina - The GTK+ Remote Desktop Client
+ * Copyright (C) 2014-2015 Antenore Gatta, Fabio Castelli, Giovanni Panozzo
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ *
+ *  In addition, as a special exception, the copyright holders give
+ *  permission to link the code of portions of this program with the
+ *  OpenSSL library under certain conditions as described in each
+ *  individual source file, and distribute linked combinations
+ *  including the two.
+ *  You must obey the GNU General Public License in all respects
+ *  for all of the code used other than OpenSSL. *  If you modify
+ *  file(s) with this exception, you may extend this exception to your
+ *  version of the file(s), but you are not obligated to do so. *  If you
+ *  do not wish to do so, delete this exception statement from your
+ *  version. *  If you delete this exception statement from all source
+ *  files in the program, then also delete it here.
+ *
+ */
+
+/* Compares the box filter of the VNC frames with cairo scaling the same
+ * desktop, checks that scaling only an updated area gives the pixels of a full
+ * rescale, and times both for 1080p to 720p and 4K to 1080p. The box filter
+ * only shrinks, sizes where an axis grows are left to cairo. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cairo.h>
+#include "vnc_scale.h"
+
+#define REMMINA_VNC_TEST_ROUNDS 10
+/* Mean difference per channel allowed against cairo, on smooth content */
+#define REMMINA_VNC_TEST_MAX_MEAN_DIFF 2.0
+
+/* Gradients and a triangle wave, with no detail finer than both filters keep */
+static cairo_surface_t* remmina_plugin_vnc_test_desktop(gint width, gint height)
+{
+	cairo_surface_t *surface;
+	guint32 *row;
+	gint stride, x, y, t;
+
+	surface = cairo_image_surface_create(CAIRO_FORMAT_RGB24, width, height);
+	cairo_surface_flush(surface);
+	stride = cairo_image_surface_get_stride(surface);
+	for (y = 0; y < height; y++)
+	{
+		row = (guint32*) (cairo_image_surface_get_data(surface) + y * stride);
+		for (x = 0; x < width; x++)
+		{
+			t = (x + 2 * y) % 256;
+			t = t < 128 ? t * 2 : 511 - t * 2;
+			row[x] = ((guint32) (x * 255 / width) << 16) | ((guint32) (y * 255 / height) << 8) | (guint32) t;
+		}
+	}
+	cairo_surface_mark_dirty(surface);
+	return surface;
+}
+
+static void remmina_plugin_vnc_test_box(RemminaPluginVncScaler *scaler, cairo_surface_t *src, cairo_surface_t *dest,
+		gint x, gint y, gint w, gint h)
+{
+	cairo_surface_flush(dest);
+	remmina_plugin_vnc_scaler_scale(scaler, cairo_image_surface_get_data(dest), cairo_image_surface_get_stride(dest),
+			cairo_image_surface_get_data(src), cairo_image_surface_get_stride(src), &x, &y, &w, &h);
+	cairo_surface_mark_dirty(dest);
+}
+
+/* As remmina_plugin_vnc_scale_area() does without the box filter */
+static void remmina_plugin_vnc_test_cairo(cairo_surface_t *src, cairo_surface_t *dest, cairo_filter_t filter)
+{
+	cairo_t *cr;
+
+	cr = cairo_create(dest);
+	cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+	cairo_scale(cr, (double) cairo_image_surface_get_width(dest) / cairo_image_surface_get_width(src),
+			(double) cairo_image_surface_get_height(dest) / cairo_image_surface_get_height(src));
+	cairo_set_source_surface(cr, src, 0, 0);
+	cairo_pattern_set_filter(cairo_get_source(cr), filter);
+	cairo_pattern_set_extend(cairo_get_source(cr), CAIRO_EXTEND_PAD);
+	cairo_paint(cr);
+	cairo_destroy(cr);
+	cairo_surface_flush(dest);
+}
+
+static void remmina_plugin_vnc_test_diff(cairo_surface_t *a, cairo_surface_t *b, gdouble *mean, gint *max)
+{
+	const guchar *pa, *pb;
+	gint width, height, x, y, c, d;
+	gint64 sum = 0;
+
+	width = cairo_image_surface_get_width(a);
+	height = cairo_image_surface_get_height(a);
+	*max = 0;
+	for (y = 0; y < height; y++)
+	{
+		pa = cairo_image_surface_get_data(a) + y * cairo_image_surface_get_stride(a);
+		pb = cairo_image_surface_get_data(b) + y * cairo_image_surface_get_stride(b);
+		for (x = 0; x < width; x++)
+		{
+			/* The unused byte of RGB24 is left out */
+			for (c = 0; c < 3; c++)
+			{
+				d = abs(pa[x * 4 + c] - pb[x * 4 + c]);
+				sum += d;
+				*max = MAX(*max, d);
+			}
+		}
+	}
+	*mean = (gdouble) sum / ((gint64) width * height * 3);
+}
+
+static gint remmina_plugin_vnc_test_size(gint src_width, gint src_height, gint dst_width, gint dst_height)
+{
+	RemminaPluginVncScaler *scaler;
+	cairo_surface_t *src, *box, *partial, *reference;
+	gint64 start, box_time, good_time, bilinear_time;
+	gdouble mean, partial_mean;
+	gint max, partial_max, round, errors = 0;
+
+	scaler = remmina_plugin_vnc_scaler_new(src_width, src_height, dst_width, dst_height);
+	src = remmina_plugin_vnc_test_desktop(src_width, src_height);
+	box = cairo_image_surface_create(CAIRO_FORMAT_RGB24, dst_width, dst_height);
+	partial = cairo_image_surface_create(CAIRO_FORMAT_RGB24, dst_width, dst_height);
+	reference = cairo_image_surface_create(CAIRO_FORMAT_RGB24, dst_width, dst_height);
+
+	start = g_get_monotonic_time();
+	for (round = 0; round < REMMINA_VNC_TEST_ROUNDS; round++)
+		remmina_plugin_vnc_test_box(scaler, src, box, 0, 0, src_width, src_height);
+	box_time = g_get_monotonic_time() - start;
+
+	start = g_get_monotonic_time();
+	for (round = 0; round < REMMINA_VNC_TEST_ROUNDS; round++)
+		remmina_plugin_vnc_test_cairo(src, reference, CAIRO_FILTER_BILINEAR);
+	bilinear_time = g_get_monotonic_time() - start;
+
+	start = g_get_monotonic_time();
+	for (round = 0; round < REMMINA_VNC_TEST_ROUNDS; round++)
+		remmina_plugin_vnc_test_cairo(src, reference, CAIRO_FILTER_GOOD);
+	good_time = g_get_monotonic_time() - start;
+
+	/* Same picture as cairo, up to the filter differences */
+	remmina_plugin_vnc_test_diff(box, reference, &mean, &max);
+	if (mean > REMMINA_VNC_TEST_MAX_MEAN_DIFF)
+		errors++;
+
+	/* An update scaled in two pieces lands exactly on the full rescale */
+	remmina_plugin_vnc_test_box(scaler, src, partial, 0, 0, src_width, src_height / 3 + 1);
+	remmina_plugin_vnc_test_box(scaler, src, partial, 0, src_height / 3 + 1, src_width, src_height - src_height / 3 - 1);
+	remmina_plugin_vnc_test_diff(box, partial, &partial_mean, &partial_max);
+	if (partial_max != 0)
+		errors++;
+
+	printf("%dx%d to %dx%d: box %.2f ms, cairo bilinear %.2f ms, cairo good %.2f ms, "
+			"mean difference %.2f, max %d, pieces %s\n",
+			src_width, src_height, dst_width, dst_height,
+			box_time / 1000.0 / REMMINA_VNC_TEST_ROUNDS, bilinear_time / 1000.0 / REMMINA_VNC_TEST_ROUNDS,
+			good_time / 1000.0 / REMMINA_VNC_TEST_ROUNDS, mean, max, partial_max ? "DIFFER" : "match");
+
+	cairo_surface_destroy(reference);
+	cairo_surface_destroy(partial);
+	cairo_surface_destroy(box);
+	cairo_surface_destroy(src);
+	remmina_plugin_vnc_scaler_free(scaler);
+	return errors;
+}
+
+int main(int argc, char **argv)
+{
+	RemminaPluginVncScaler *scaler;
+	gint errors = 0;
+
+	remmina_plugin_vnc_scale_select_impl();
+
+	errors += remmina_plugin_vnc_test_size(1920, 1080, 1280, 720);
+	errors += remmina_plugin_vnc_test_size(3840, 2160, 1920, 1080);
+	errors += remmina_plugin_vnc_test_size(1920, 1080, 1000, 1080);
+
+	/* Shrinking one axis while the other grows is not a box filter job */
+	scaler = remmina_plugin_vnc_scaler_new(1920, 1080, 1280, 1200);
+	if (scaler)
+	{
+		printf("1920x1080 to 1280x1200: box filter created, WRONG\n");
+		remmina_plugin_vnc_scaler_free(scaler);
+		errors++;
+	}
+
+	return errors ? 1 : 0;
+}
@@ -98,7 +98,7 @@ static RemminaSettingGroup remmina_setting_get_group(const gchar *setting, gbool
 	return REMMINA_SETTING_GROUP_PROFILE;
 }
 
-static RemminaFile*
+RemminaFile*
 remmina_file_new_empty(void)
 {
 	TRACE_CALL("remmina_file_new_empty");
@@ -65,6 +65,8 @@ typedef enum
 
 /* Create a empty .remmina file */
 RemminaFile* remmina_file_new(void);
+/* Create a RemminaFile object without any setting, not even the defaults */
+RemminaFile* remmina_file_new_empty(void);
 RemminaFile* remmina_file_copy(const gchar *filename);
 void remmina_file_generate_filename(RemminaFile *remminafile);
 void remmina_file_set_filename(RemminaFile *remminafile, const gchar *filename);
@@ -34,6 +34,7 @@
  */
 
 #include <gtk/gtk.h>
+#include <glib/gstdio.h>
 #include <string.h>
 #include "remmina_public.h"
 #include "remmina_string_array.h"
@@ -50,14 +51,150 @@ void remmina_file_manager_init(void)
 	g_mkdir_with_parents(dirname, 0700);
 }
 
+/* The settings listed in the main window, the only ones kept in the index */
+static const gchar* remmina_file_manager_index_settings[] =
+{ "name", "group", "server", "protocol", "ssh_enabled", NULL };
+
+/* Index of ~/.remmina, one group per .remmina file with its mtime, size and listed settings */
+static GKeyFile* remmina_file_manager_index = NULL;
+static gboolean remmina_file_manager_index_dirty = FALSE;
+
+static gchar* remmina_file_manager_index_filename(void)
+{
+	TRACE_CALL("remmina_file_manager_index_filename");
+	return g_strdup_printf("%s/.remmina/remmina.index", g_get_home_dir());
+}
+
+static GKeyFile* remmina_file_manager_index_get(void)
+{
+	TRACE_CALL("remmina_file_manager_index_get");
+	gchar* filename;
+
+	if (!remmina_file_manager_index)
+	{
+		remmina_file_manager_index = g_key_file_new();
+		filename = remmina_file_manager_index_filename();
+		g_key_file_load_from_file(remmina_file_manager_index, filename, G_KEY_FILE_NONE, NULL);
+		g_free(filename);
+	}
+	return remmina_file_manager_index;
+}
+
+/* Drops the entries of the files which were not seen in the last scan, and writes back a changed index */
+static void remmina_file_manager_index_sync(GHashTable* seen)
+{
+	TRACE_CALL("remmina_file_manager_index_sync");
+	GKeyFile* index;
+	gchar** groups;
+	gchar* filename;
+	gchar* content;
+	gsize length;
+	gint i;
+
+	index = remmina_file_manager_index_get();
+
+	groups = g_key_file_get_groups(index, NULL);
+	for (i = 0; groups[i]; i++)
+	{
+		if (!g_hash_table_lookup(seen, groups[i]))
+		{
+			g_key_file_remove_group(index, groups[i], NULL);
+			remmina_file_manager_index_dirty = TRUE;
+		}
+	}
+	g_strfreev(groups);
+
+	if (!remmina_file_manager_index_dirty)
+		return;
+
+	content = g_key_file_to_data(index, &length, NULL);
+	filename = remmina_file_manager_index_filename();
+	g_file_set_contents(filename, content, length, NULL);
+	g_free(filename);
+	g_free(content);
+	remmina_file_manager_index_dirty = FALSE;
+}
+
+/* Returns a RemminaFile holding only the listed settings of a .remmina file.
+ * Up to date entries come from the index, the others are read from the file
+ * itself without decrypting anything, then recorded in the index */
+static RemminaFile* remmina_file_manager_load_listing(const gchar* dirname, const gchar* name)
+{
+	TRACE_CALL("remmina_file_manager_load_listing");
+	gchar filename[MAX_PATH_LEN];
+	GKeyFile* index;
+	GKeyFile* gkeyfile;
+	GStatBuf st;
+	RemminaFile* remminafile;
+	gchar* value;
+	gint i;
+
+	g_snprintf(filename, MAX_PATH_LEN, "%s/%s", dirname, name);
+	if (g_stat(filename, &st) < 0)
+		return NULL;
+
+	/* A file name which is not a valid key file group name is simply never indexed */
+	index = strpbrk(name, "[]\r\n") ? NULL : remmina_file_manager_index_get();
+
+	if (index &&
+		g_key_file_get_int64(index, name, "mtime", NULL) == (gint64) st.st_mtime &&
+		g_key_file_get_int64(index, name, "mtime_nsec", NULL) == (gint64) st.st_mtim.tv_nsec &&
+		g_key_file_get_int64(index, name, "size", NULL) == (gint64) st.st_size &&
+		g_key_file_has_key(index, name, "name", NULL))
+	{
+		remminafile = remmina_file_new_empty();
+		remmina_file_set_filename(remminafile, filename);
+		for (i = 0; remmina_file_manager_index_settings[i]; i++)
+		{
+			value = g_key_file_get_string(index, name, remmina_file_manager_index_settings[i], NULL);
+			if (value)
+				remmina_file_set_string_ref(remminafile, remmina_file_manager_index_settings[i], value);
+		}
+		return remminafile;
+	}
+
+	gkeyfile = g_key_file_new();
+	if (!g_key_file_load_from_file(gkeyfile, filename, G_KEY_FILE_NONE, NULL) ||
+		!g_key_file_has_key(gkeyfile, "remmina", "name", NULL))
+	{
+		g_key_file_free(gkeyfile);
+		return NULL;
+	}
+
+	remminafile = remmina_file_new_empty();
+	remmina_file_set_filename(remminafile, filename);
+
+	if (index)
+	{
+		g_key_file_remove_group(index, name, NULL);
+		g_key_file_set_int64(index, name, "mtime", (gint64) st.st_mtime);
+		g_key_file_set_int64(index, name, "mtime_nsec", (gint64) st.st_mtim.tv_nsec);
+		g_key_file_set_int64(index, name, "size", (gint64) st.st_size);
+		remmina_file_manager_index_dirty = TRUE;
+	}
+	for (i = 0; remmina_file_manager_index_settings[i]; i++)
+	{
+		value = g_key_file_get_string(gkeyfile, "remmina", remmina_file_manager_index_settings[i], NULL);
+		if (value)
+		{
+			if (index)
+				g_key_file_set_string(index, name, remmina_file_manager_index_settings[i], value);
+			remmina_file_set_string_ref(remminafile, remmina_file_manager_index_settings[i], value);
+		}
+	}
+
+	g_key_file_free(gkeyfile);
+	return remminafile;
+}
+
 gint remmina_file_manager_iterate(GFunc func, gpointer user_data)
 {
 	TRACE_CALL("remmina_file_manager_iterate");
 	gchar dirname[MAX_PATH_LEN];
-	gchar filename[MAX_PATH_LEN];
 	GDir* dir;
 	const gchar* name;
 	RemminaFile* remminafile;
+	GHashTable* seen;
 	gint items_count = 0;
 
 	g_snprintf(dirname, MAX_PATH_LEN, "%s/.remmina", g_get_home_dir());
@@ -65,12 +202,13 @@ gint remmina_file_manager_iterate(GFunc func, gpointer user_data)
 
 	if (dir)
 	{
+		seen = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
 		while ((name = g_dir_read_name(dir)) != NULL)
 		{
 			if (!g_str_has_suffix(name, ".remmina"))
 				continue;
-			g_snprintf(filename, MAX_PATH_LEN, "%s/%s", dirname, name);
-			remminafile = remmina_file_load(filename);
+			g_hash_table_insert(seen, g_strdup(name), GINT_TO_POINTER(TRUE));
+			remminafile = remmina_file_manager_load_listing(dirname, name);
 			if (remminafile)
 			{
 				(*func)(remminafile, user_data);
@@ -79,6 +217,8 @@ gint remmina_file_manager_iterate(GFunc func, gpointer user_data)
 			}
 		}
 		g_dir_close(dir);
+		remmina_file_manager_index_sync(seen);
+		g_hash_table_destroy(seen);
 	}
 	return items_count;
 }
@@ -87,7 +227,6 @@ gchar* remmina_file_manager_get_groups(void)
 {
 	TRACE_CALL("remmina_file_manager_get_groups");
 	gchar dirname[MAX_PATH_LEN];
-	gchar filename[MAX_PATH_LEN];
 	GDir* dir;
 	const gchar* name;
 	RemminaFile* remminafile;
@@ -105,8 +244,9 @@ gchar* remmina_file_manager_get_groups(void)
 	{
 		if (!g_str_has_suffix(name, ".remmina"))
 			continue;
-		g_snprintf(filename, MAX_PATH_LEN, "%s/%s", dirname, name);
-		remminafile = remmina_file_load(filename);
+		remminafile = remmina_file_manager_load_listing(dirname, name);
+		if (!remminafile)
+			continue;
 		group = remmina_file_get_string(remminafile, "group");
 		if (group && remmina_string_array_find(array, group) < 0)
 		{
@@ -189,7 +329,6 @@ GNode* remmina_file_manager_get_group_tree(void)
 {
 	TRACE_CALL("remmina_file_manager_get_group_tree");
 	gchar dirname[MAX_PATH_LEN];
-	gchar filename[MAX_PATH_LEN];
 	GDir* dir;
 	const gchar* name;
 	RemminaFile* remminafile;
@@ -206,8 +345,9 @@ GNode* remmina_file_manager_get_group_tree(void)
 	{
 		if (!g_str_has_suffix(name, ".remmina"))
 			continue;
-		g_snprintf(filename, MAX_PATH_LEN, "%s/%s", dirname, name);
-		remminafile = remmina_file_load(filename);
+		remminafile = remmina_file_manager_load_listing(dirname, name);
+		if (!remminafile)
+			continue;
 		group = remmina_file_get_string(remminafile, "group");
 		remmina_file_manager_add_group(root, group);
 		remmina_file_free(remminafile);
@@ -47,7 +47,8 @@ typedef struct _RemminaGroupData
 
 /* Initialize */
 void remmina_file_manager_init(void);
-/* Iterate all .remmina connections in the home directory */
+/* Iterate all .remmina connections in the home directory.
+ * The files only carry the settings listed in the main window: name, group, server, protocol and ssh_enabled */
 gint remmina_file_manager_iterate(GFunc func, gpointer user_data);
 /* Get a list of groups */
 gchar* remmina_file_manager_get_groups(void);
@@ -35,6 +35,7 @@
 
 #define _FILE_OFFSET_BITS 64
 
+#include <pthread.h>
 #include <gtk/gtk.h>
 #include <glib/gi18n.h>
 #include <glib/gstdio.h>
@@ -125,6 +126,9 @@ remmina_cell_renderer_pixbuf_new(void)
 /* --------------------- RemminaFTPClient ----------------------------*/
 G_DEFINE_TYPE( RemminaFTPClient, remmina_ftp_client, GTK_TYPE_GRID)
 
+/* Smallest number of rows worth rebuilding the sorted file list for */
+#define REMMINA_FTP_CLIENT_BULK_MIN 64
+
 #define BUSY_CURSOR \
     if (GDK_IS_WINDOW (gtk_widget_get_window (GTK_WIDGET (client)))) \
     { \
@@ -148,10 +152,25 @@ struct _RemminaFTPClientPriv
 	GtkTreeModel *file_list_sort;
 	GtkWidget *file_list_view;
 	gboolean file_list_show_hidden;
+	/* Kept here so the sort model can be rebuilt after a bulk load */
+	gint file_list_sort_column;
+	GtkSortType file_list_sort_order;
+	/* Nesting of remmina_ftp_client_freeze_file_list(), the views are detached while above 0 */
+	gint file_list_frozen;
 
 	GtkTreeModel *task_list_model;
 	GtkWidget *task_list_view;
 
+	/* The transfer queue, in the order tasks were added. The task list only shows it */
+	pthread_mutex_t task_mutex;
+	GQueue task_queue;
+	/* Files bigger than REMMINA_FTP_CLIENT_LARGE_FILE */
+	GQueue large_task_queue;
+	/* taskid -> link of a waiting task in one of the queues */
+	GHashTable *task_links;
+	/* taskid -> GtkTreeIter of its row, only used on the GTK thread */
+	GHashTable *task_rows;
+
 	gchar *current_directory;
 	gchar *working_directory;
 
@@ -170,9 +189,12 @@ enum
 static guint remmina_ftp_client_signals[LAST_SIGNAL] =
 { 0 };
 
+static void remmina_ftp_client_finalize(GObject *object);
+
 static void remmina_ftp_client_class_init(RemminaFTPClientClass *klass)
 {
 	TRACE_CALL("remmina_ftp_client_class_init");
+	G_OBJECT_CLASS(klass)->finalize = remmina_ftp_client_finalize;
 	remmina_ftp_client_signals[OPEN_DIR_SIGNAL] = g_signal_new("open-dir", G_TYPE_FROM_CLASS(klass),
 			G_SIGNAL_RUN_LAST | G_SIGNAL_ACTION, G_STRUCT_OFFSET(RemminaFTPClientClass, open_dir), NULL, NULL,
 			g_cclosure_marshal_VOID__STRING, G_TYPE_NONE, 1, G_TYPE_STRING);
@@ -187,13 +209,26 @@ static void remmina_ftp_client_class_init(RemminaFTPClientClass *klass)
 			remmina_marshal_BOOLEAN__INT_STRING, G_TYPE_BOOLEAN, 2, G_TYPE_INT, G_TYPE_STRING);
 }
 
-static void remmina_ftp_client_destroy(RemminaFTPClient *client, gpointer data)
+/* Not done on destroy: the destroy handler of a subclass runs after this class's one,
+ * and transfer threads may use the queue and the current directory until it stopped them */
+static void remmina_ftp_client_finalize(GObject *object)
 {
-	TRACE_CALL("remmina_ftp_client_destroy");
-	RemminaFTPClientPriv *priv = (RemminaFTPClientPriv*) client->priv;
+	TRACE_CALL("remmina_ftp_client_finalize");
+	RemminaFTPClientPriv *priv = (RemminaFTPClientPriv*) REMMINA_FTP_CLIENT(object)->priv;
+
+	g_queue_foreach(&priv->task_queue, (GFunc) remmina_ftp_task_free, NULL);
+	g_queue_clear(&priv->task_queue);
+	g_queue_foreach(&priv->large_task_queue, (GFunc) remmina_ftp_task_free, NULL);
+	g_queue_clear(&priv->large_task_queue);
+	g_hash_table_destroy(priv->task_links);
+	pthread_mutex_destroy(&priv->task_mutex);
+	/* Also frees the iters of the rows still listed */
+	g_hash_table_destroy(priv->task_rows);
 	g_free(priv->current_directory);
 	g_free(priv->working_directory);
 	g_free(priv);
+
+	G_OBJECT_CLASS(remmina_ftp_client_parent_class)->finalize(object);
 }
 
 static void remmina_ftp_client_cell_data_filetype_pixbuf(GtkTreeViewColumn *col, GtkCellRenderer *renderer, GtkTreeModel *model,
@@ -371,9 +406,8 @@ static void remmina_ftp_client_cell_data_progress(GtkTreeViewColumn *col, GtkCel
 static void remmina_ftp_client_open_dir(RemminaFTPClient *client, const gchar *dir)
 {
 	TRACE_CALL("remmina_ftp_client_open_dir");
-	BUSY_CURSOR
+	/* The directory is listed asynchronously, the handler shows the busy cursor meanwhile */
 	g_signal_emit(G_OBJECT(client), remmina_ftp_client_signals[OPEN_DIR_SIGNAL], 0, dir);
-	NORMAL_CURSOR
 }
 
 static void remmina_ftp_client_dir_on_activate(GtkWidget *widget, RemminaFTPClient *client)
@@ -442,12 +476,79 @@ remmina_ftp_client_get_download_dir(RemminaFTPClient *client)
 	return localdir;
 }
 
+static GQueue* remmina_ftp_client_task_queue(RemminaFTPClientPriv *priv, RemminaFTPTask *task)
+{
+	TRACE_CALL("remmina_ftp_client_task_queue");
+	if (task->type == REMMINA_FTP_FILE_TYPE_FILE && task->size > REMMINA_FTP_CLIENT_LARGE_FILE)
+		return &priv->large_task_queue;
+	return &priv->task_queue;
+}
+
+/* Queue a new task for the transfer threads and show it in the task list */
+static void remmina_ftp_client_add_task(RemminaFTPClient *client, gint type, const gchar *name, gfloat size,
+		gint tasktype, const gchar *localdir)
+{
+	TRACE_CALL("remmina_ftp_client_add_task");
+	RemminaFTPClientPriv *priv = (RemminaFTPClientPriv*) client->priv;
+	RemminaFTPTask *task;
+	GtkTreeIter iter;
+	GQueue *queue;
+
+	task = g_new0(RemminaFTPTask, 1);
+	task->type = type;
+	task->name = g_strdup(name);
+	task->taskid = remmina_ftp_client_taskid++;
+	task->tasktype = tasktype;
+	task->remotedir = g_strdup(priv->current_directory);
+	task->localdir = g_strdup(localdir);
+	task->size = size;
+	task->status = REMMINA_FTP_TASK_STATUS_WAIT;
+
+	gtk_list_store_insert_with_values(GTK_LIST_STORE(priv->task_list_model), &iter, -1,
+			REMMINA_FTP_TASK_COLUMN_TYPE, type, REMMINA_FTP_TASK_COLUMN_NAME, name,
+			REMMINA_FTP_TASK_COLUMN_SIZE, size, REMMINA_FTP_TASK_COLUMN_TASKID, task->taskid,
+			REMMINA_FTP_TASK_COLUMN_TASKTYPE, tasktype, REMMINA_FTP_TASK_COLUMN_REMOTEDIR,
+			priv->current_directory, REMMINA_FTP_TASK_COLUMN_LOCALDIR, localdir, REMMINA_FTP_TASK_COLUMN_STATUS,
+			REMMINA_FTP_TASK_STATUS_WAIT, REMMINA_FTP_TASK_COLUMN_DONESIZE, 0.0, REMMINA_FTP_TASK_COLUMN_TOOLTIP,
+			NULL, -1);
+	/* List store iters stay valid until their row is removed */
+	g_hash_table_insert(priv->task_rows, GINT_TO_POINTER(task->taskid), g_memdup(&iter, sizeof(GtkTreeIter)));
+
+	pthread_mutex_lock(&priv->task_mutex);
+	queue = remmina_ftp_client_task_queue(priv, task);
+	g_queue_push_tail(queue, task);
+	g_hash_table_insert(priv->task_links, GINT_TO_POINTER(task->taskid), g_queue_peek_tail_link(queue));
+	pthread_mutex_unlock(&priv->task_mutex);
+}
+
+/* Drop a task which is still waiting, FALSE when a transfer thread already took it */
+static gboolean remmina_ftp_client_unqueue_task(RemminaFTPClient *client, gint taskid)
+{
+	TRACE_CALL("remmina_ftp_client_unqueue_task");
+	RemminaFTPClientPriv *priv = (RemminaFTPClientPriv*) client->priv;
+	RemminaFTPTask *task = NULL;
+	GList *link;
+
+	pthread_mutex_lock(&priv->task_mutex);
+	link = (GList*) g_hash_table_lookup(priv->task_links, GINT_TO_POINTER(taskid));
+	if (link)
+	{
+		task = (RemminaFTPTask*) link->data;
+		g_hash_table_remove(priv->task_links, GINT_TO_POINTER(taskid));
+		g_queue_delete_link(remmina_ftp_client_task_queue(priv, task), link);
+	}
+	pthread_mutex_unlock(&priv->task_mutex);
+
+	if (!task)
+		return FALSE;
+	remmina_ftp_task_free(task);
+	return TRUE;
+}
+
 static void remmina_ftp_client_download(RemminaFTPClient *client, GtkTreeIter *piter, const gchar *localdir)
 {
 	TRACE_CALL("remmina_ftp_client_download");
 	RemminaFTPClientPriv *priv = (RemminaFTPClientPriv*) client->priv;
-	GtkListStore *store = GTK_LIST_STORE(priv->task_list_model);
-	GtkTreeIter iter;
 	gint type;
 	gchar *name;
 	gfloat size;
@@ -455,13 +556,7 @@ static void remmina_ftp_client_download(RemminaFTPClient *client, GtkTreeIter *p
 	gtk_tree_model_get(priv->file_list_sort, piter, REMMINA_FTP_FILE_COLUMN_TYPE, &type, REMMINA_FTP_FILE_COLUMN_NAME,
 			&name, REMMINA_FTP_FILE_COLUMN_SIZE, &size, -1);
 
-	gtk_list_store_append(store, &iter);
-	gtk_list_store_set(store, &iter, REMMINA_FTP_TASK_COLUMN_TYPE, type, REMMINA_FTP_TASK_COLUMN_NAME, name,
-			REMMINA_FTP_TASK_COLUMN_SIZE, size, REMMINA_FTP_TASK_COLUMN_TASKID, remmina_ftp_client_taskid++,
-			REMMINA_FTP_TASK_COLUMN_TASKTYPE, REMMINA_FTP_TASK_TYPE_DOWNLOAD, REMMINA_FTP_TASK_COLUMN_REMOTEDIR,
-			priv->current_directory, REMMINA_FTP_TASK_COLUMN_LOCALDIR, localdir, REMMINA_FTP_TASK_COLUMN_STATUS,
-			REMMINA_FTP_TASK_STATUS_WAIT, REMMINA_FTP_TASK_COLUMN_DONESIZE, 0.0, REMMINA_FTP_TASK_COLUMN_TOOLTIP,
-			NULL, -1);
+	remmina_ftp_client_add_task(client, type, name, size, REMMINA_FTP_TASK_TYPE_DOWNLOAD, localdir);
 
 	g_free(name);
 
@@ -618,8 +713,6 @@ static void remmina_ftp_client_action_upload(GObject *object, RemminaFTPClient *
 {
 	TRACE_CALL("remmina_ftp_client_action_upload");
 	RemminaFTPClientPriv *priv = (RemminaFTPClientPriv*) client->priv;
-	GtkListStore *store = GTK_LIST_STORE(priv->task_list_model);
-	GtkTreeIter iter;
 	GtkWidget *dialog;
 	GtkWidget *upload_folder_check;
 	gint type;
@@ -673,13 +766,7 @@ static void remmina_ftp_client_action_upload(GObject *object, RemminaFTPClient *
 			dir = NULL;
 		}
 
-		gtk_list_store_append(store, &iter);
-		gtk_list_store_set(store, &iter, REMMINA_FTP_TASK_COLUMN_TYPE, type, REMMINA_FTP_TASK_COLUMN_NAME, name,
-				REMMINA_FTP_TASK_COLUMN_SIZE, (gfloat) st.st_size, REMMINA_FTP_TASK_COLUMN_TASKID,
-				remmina_ftp_client_taskid++, REMMINA_FTP_TASK_COLUMN_TASKTYPE, REMMINA_FTP_TASK_TYPE_UPLOAD,
-				REMMINA_FTP_TASK_COLUMN_REMOTEDIR, priv->current_directory, REMMINA_FTP_TASK_COLUMN_LOCALDIR,
-				dir, REMMINA_FTP_TASK_COLUMN_STATUS, REMMINA_FTP_TASK_STATUS_WAIT,
-				REMMINA_FTP_TASK_COLUMN_DONESIZE, 0.0, REMMINA_FTP_TASK_COLUMN_TOOLTIP, NULL, -1);
+		remmina_ftp_client_add_task(client, type, name, (gfloat) st.st_size, REMMINA_FTP_TASK_TYPE_UPLOAD, dir);
 
 		g_free(path);
 	}
@@ -782,10 +869,14 @@ static void remmina_ftp_client_task_list_cell_on_activate(GtkCellRenderer *rende
 
 	gtk_tree_model_get(priv->task_list_model, &iter, REMMINA_FTP_TASK_COLUMN_TASKID, &taskid, -1);
 
-	g_signal_emit(G_OBJECT(client), remmina_ftp_client_signals[CANCEL_TASK_SIGNAL], 0, taskid, &ret);
+	/* A waiting task only has to leave the queue, no transfer thread knows it yet */
+	ret = remmina_ftp_client_unqueue_task(client, taskid);
+	if (!ret)
+		g_signal_emit(G_OBJECT(client), remmina_ftp_client_signals[CANCEL_TASK_SIGNAL], 0, taskid, &ret);
 
 	if (ret)
 	{
+		g_hash_table_remove(priv->task_rows, GINT_TO_POINTER(taskid));
 		gtk_list_store_remove(GTK_LIST_STORE(priv->task_list_model), &iter);
 	}
 }
@@ -860,7 +951,9 @@ void remmina_ftp_client_set_show_hidden(RemminaFTPClient *client, gboolean show_
 {
 	TRACE_CALL("remmina_ftp_client_set_show_hidden");
 	client->priv->file_list_show_hidden = show_hidden;
-	gtk_tree_model_filter_refilter(GTK_TREE_MODEL_FILTER(client->priv->file_list_filter));
+	/* A frozen list is filtered again when it is attached */
+	if (client->priv->file_list_filter)
+		gtk_tree_model_filter_refilter(GTK_TREE_MODEL_FILTER(client->priv->file_list_filter));
 }
 
 static gboolean remmina_ftp_client_filter_visible_func(GtkTreeModel *model, GtkTreeIter *iter, RemminaFTPClient *client)
@@ -881,6 +974,43 @@ static gboolean remmina_ftp_client_filter_visible_func(GtkTreeModel *model, GtkT
 	return result;
 }
 
+/* Builds the filter and sort models over the file store and shows them */
+static void remmina_ftp_client_attach_file_list(RemminaFTPClient *client)
+{
+	TRACE_CALL("remmina_ftp_client_attach_file_list");
+	RemminaFTPClientPriv *priv = client->priv;
+
+	priv->file_list_filter = gtk_tree_model_filter_new(priv->file_list_model, NULL);
+	gtk_tree_model_filter_set_visible_func(GTK_TREE_MODEL_FILTER(priv->file_list_filter),
+			(GtkTreeModelFilterVisibleFunc) remmina_ftp_client_filter_visible_func, client, NULL);
+
+	priv->file_list_sort = gtk_tree_model_sort_new_with_model(priv->file_list_filter);
+	gtk_tree_sortable_set_sort_column_id(GTK_TREE_SORTABLE(priv->file_list_sort), priv->file_list_sort_column,
+			priv->file_list_sort_order);
+	gtk_tree_view_set_model(GTK_TREE_VIEW(priv->file_list_view), priv->file_list_sort);
+}
+
+/* Drops the filter and sort models, so changes to the store are not propagated row by row */
+static void remmina_ftp_client_detach_file_list(RemminaFTPClient *client)
+{
+	TRACE_CALL("remmina_ftp_client_detach_file_list");
+	RemminaFTPClientPriv *priv = client->priv;
+	gint column;
+	GtkSortType order;
+
+	if (gtk_tree_sortable_get_sort_column_id(GTK_TREE_SORTABLE(priv->file_list_sort), &column, &order))
+	{
+		priv->file_list_sort_column = column;
+		priv->file_list_sort_order = order;
+	}
+
+	gtk_tree_view_set_model(GTK_TREE_VIEW(priv->file_list_view), NULL);
+	g_object_unref(priv->file_list_sort);
+	g_object_unref(priv->file_list_filter);
+	priv->file_list_sort = NULL;
+	priv->file_list_filter = NULL;
+}
+
 /* Set the overwrite_all status */
 void remmina_ftp_client_set_overwrite_status(RemminaFTPClient *client, gboolean status)
 {
@@ -909,6 +1039,12 @@ static void remmina_ftp_client_init(RemminaFTPClient *client)
 
 	priv = g_new0(RemminaFTPClientPriv, 1);
 	client->priv = priv;
+
+	pthread_mutex_init(&priv->task_mutex, NULL);
+	g_queue_init(&priv->task_queue);
+	g_queue_init(&priv->large_task_queue);
+	priv->task_links = g_hash_table_new(NULL, NULL);
+	priv->task_rows = g_hash_table_new_full(NULL, NULL, NULL, g_free);
 	
 	/* Initialize overwrite status to FALSE */
 	client->priv->overwrite_all = FALSE;
@@ -1003,14 +1139,9 @@ static void remmina_ftp_client_init(RemminaFTPClient *client)
 			gtk_list_store_new(REMMINA_FTP_FILE_N_COLUMNS, G_TYPE_INT, G_TYPE_STRING, G_TYPE_FLOAT, G_TYPE_STRING,
 					G_TYPE_STRING, G_TYPE_INT, G_TYPE_STRING));
 
-	priv->file_list_filter = gtk_tree_model_filter_new(priv->file_list_model, NULL);
-	gtk_tree_model_filter_set_visible_func(GTK_TREE_MODEL_FILTER(priv->file_list_filter),
-			(GtkTreeModelFilterVisibleFunc) remmina_ftp_client_filter_visible_func, client, NULL);
-
-	priv->file_list_sort = gtk_tree_model_sort_new_with_model(priv->file_list_filter);
-	gtk_tree_sortable_set_sort_column_id(GTK_TREE_SORTABLE(priv->file_list_sort), REMMINA_FTP_FILE_COLUMN_NAME_SORT,
-			GTK_SORT_ASCENDING);
-	gtk_tree_view_set_model(GTK_TREE_VIEW(priv->file_list_view), priv->file_list_sort);
+	priv->file_list_sort_column = REMMINA_FTP_FILE_COLUMN_NAME_SORT;
+	priv->file_list_sort_order = GTK_SORT_ASCENDING;
+	remmina_ftp_client_attach_file_list(client);
 
 	/* Task List */
 	scrolledwindow = gtk_scrolled_window_new(NULL, NULL);
@@ -1084,7 +1215,6 @@ static void remmina_ftp_client_init(RemminaFTPClient *client)
 	gtk_tree_view_set_model(GTK_TREE_VIEW(priv->task_list_view), priv->task_list_model);
 
 	/* Setup the internal signals */
-	g_signal_connect(G_OBJECT(client), "destroy", G_CALLBACK(remmina_ftp_client_destroy), NULL);
 	g_signal_connect(G_OBJECT(gtk_bin_get_child(GTK_BIN(priv->directory_combo))), "activate",
 			G_CALLBACK(remmina_ftp_client_dir_on_activate), client);
 	g_signal_connect(G_OBJECT(priv->directory_combo), "changed", G_CALLBACK(remmina_ftp_client_dir_on_changed), client);
@@ -1139,10 +1269,77 @@ void remmina_ftp_client_clear_file_list(RemminaFTPClient *client)
 	TRACE_CALL("remmina_ftp_client_clear_file_list");
 	RemminaFTPClientPriv *priv = (RemminaFTPClientPriv*) client->priv;
 
-	gtk_list_store_clear(GTK_LIST_STORE(priv->file_list_model));
+	/* Clearing a big list through the sort model costs a signal per row */
+	if (priv->file_list_frozen == 0 &&
+			gtk_tree_model_iter_n_children(priv->file_list_model, NULL) >= REMMINA_FTP_CLIENT_BULK_MIN)
+	{
+		remmina_ftp_client_detach_file_list(client);
+		gtk_list_store_clear(GTK_LIST_STORE(priv->file_list_model));
+		remmina_ftp_client_attach_file_list(client);
+	}
+	else
+	{
+		gtk_list_store_clear(GTK_LIST_STORE(priv->file_list_model));
+	}
 	remmina_ftp_client_set_file_action_sensitive(client, FALSE);
 }
 
+void remmina_ftp_client_add_files(RemminaFTPClient *client, const RemminaFTPFile *files, guint n_files)
+{
+	TRACE_CALL("remmina_ftp_client_add_files");
+	RemminaFTPClientPriv *priv = (RemminaFTPClientPriv*) client->priv;
+	GtkListStore *store = GTK_LIST_STORE (priv->file_list_model);
+	GString *sort_key;
+	gboolean detach;
+	guint i;
+
+	/* Filling an empty list behind the views is cheaper than inserting many rows through
+	 * the sort model. A list already on screen is appended to in place, so that the
+	 * scroll position and the selection are kept */
+	detach = (priv->file_list_frozen == 0 && n_files >= REMMINA_FTP_CLIENT_BULK_MIN &&
+			gtk_tree_model_iter_n_children(priv->file_list_model, NULL) == 0);
+	if (detach)
+		remmina_ftp_client_detach_file_list(client);
+
+	/* One buffer for all the sort keys, the store keeps its own copy */
+	sort_key = g_string_sized_new(256);
+	for (i = 0; i < n_files; i++)
+	{
+		g_string_printf(sort_key, "%i%s", files[i].type, files[i].name);
+		gtk_list_store_insert_with_values(store, NULL, -1,
+				REMMINA_FTP_FILE_COLUMN_TYPE, files[i].type,
+				REMMINA_FTP_FILE_COLUMN_NAME, files[i].name,
+				REMMINA_FTP_FILE_COLUMN_SIZE, files[i].size,
+				REMMINA_FTP_FILE_COLUMN_USER, files[i].user,
+				REMMINA_FTP_FILE_COLUMN_GROUP, files[i].group,
+				REMMINA_FTP_FILE_COLUMN_PERMISSION, files[i].permission,
+				REMMINA_FTP_FILE_COLUMN_NAME_SORT, sort_key->str,
+				-1);
+	}
+	g_string_free(sort_key, TRUE);
+
+	if (detach)
+		remmina_ftp_client_attach_file_list(client);
+}
+
+void remmina_ftp_client_freeze_file_list(RemminaFTPClient *client)
+{
+	TRACE_CALL("remmina_ftp_client_freeze_file_list");
+	RemminaFTPClientPriv *priv = (RemminaFTPClientPriv*) client->priv;
+
+	if (priv->file_list_frozen++ == 0)
+		remmina_ftp_client_detach_file_list(client);
+}
+
+void remmina_ftp_client_thaw_file_list(RemminaFTPClient *client)
+{
+	TRACE_CALL("remmina_ftp_client_thaw_file_list");
+	RemminaFTPClientPriv *priv = (RemminaFTPClientPriv*) client->priv;
+
+	if (priv->file_list_frozen > 0 && --priv->file_list_frozen == 0)
+		remmina_ftp_client_attach_file_list(client);
+}
+
 void remmina_ftp_client_add_file(RemminaFTPClient *client, ...)
 {
 	TRACE_CALL("remmina_ftp_client_add_file");
@@ -1212,50 +1409,29 @@ remmina_ftp_client_get_dir(RemminaFTPClient *client)
 }
 
 RemminaFTPTask*
-remmina_ftp_client_get_waiting_task(RemminaFTPClient *client)
+remmina_ftp_client_get_waiting_task(RemminaFTPClient *client, gboolean prefer_small, gint *running)
 {
 	TRACE_CALL("remmina_ftp_client_get_waiting_task");
 	RemminaFTPClientPriv *priv = (RemminaFTPClientPriv*) client->priv;
-	GtkTreePath *path;
-	GtkTreeIter iter;
-	RemminaFTPTask task;
-
-	if ( !remmina_masterthread_exec_is_main_thread() ) {
-		/* Allow the execution of this function from a non main thread */
-		RemminaMTExecData *d;
-		RemminaFTPTask* retval;
-		d = (RemminaMTExecData*)g_malloc( sizeof(RemminaMTExecData) );
-		d->func = FUNC_FTP_CLIENT_GET_WAITING_TASK;
-		d->p.ftp_client_get_waiting_task.client = client;
-		remmina_masterthread_exec_and_wait(d);
-		retval = d->p.ftp_client_get_waiting_task.retval;
-		g_free(d);
-		return retval;
-	}
-
-	if (!gtk_tree_model_get_iter_first(priv->task_list_model, &iter))
-		return NULL;
-
-	while (1)
+	RemminaFTPTask *small, *large, *task;
+
+	pthread_mutex_lock(&priv->task_mutex);
+	small = (RemminaFTPTask*) g_queue_peek_head(&priv->task_queue);
+	large = (RemminaFTPTask*) g_queue_peek_head(&priv->large_task_queue);
+	/* Task ids grow, so the lower head is the older task */
+	if (small && (prefer_small || !large || small->taskid < large->taskid))
+		task = (RemminaFTPTask*) g_queue_pop_head(&priv->task_queue);
+	else
+		task = (RemminaFTPTask*) g_queue_pop_head(&priv->large_task_queue);
+	if (task)
 	{
-		gtk_tree_model_get(priv->task_list_model, &iter, REMMINA_FTP_TASK_COLUMN_TYPE, &task.type,
-				REMMINA_FTP_TASK_COLUMN_NAME, &task.name, REMMINA_FTP_TASK_COLUMN_SIZE, &task.size,
-				REMMINA_FTP_TASK_COLUMN_TASKID, &task.taskid, REMMINA_FTP_TASK_COLUMN_TASKTYPE, &task.tasktype,
-				REMMINA_FTP_TASK_COLUMN_REMOTEDIR, &task.remotedir, REMMINA_FTP_TASK_COLUMN_LOCALDIR,
-				&task.localdir, REMMINA_FTP_TASK_COLUMN_STATUS, &task.status, REMMINA_FTP_TASK_COLUMN_DONESIZE,
-				&task.donesize, REMMINA_FTP_TASK_COLUMN_TOOLTIP, &task.tooltip, -1);
-		if (task.status == REMMINA_FTP_TASK_STATUS_WAIT)
-		{
-			path = gtk_tree_model_get_path(priv->task_list_model, &iter);
-			task.rowref = gtk_tree_row_reference_new(priv->task_list_model, path);
-			gtk_tree_path_free(path);
-			return (RemminaFTPTask*) g_memdup(&task, sizeof(RemminaFTPTask));
-		}
-		if (!gtk_tree_model_iter_next(priv->task_list_model, &iter))
-			break;
+		g_hash_table_remove(priv->task_links, GINT_TO_POINTER(task->taskid));
+		task->status = REMMINA_FTP_TASK_STATUS_RUN;
+		g_atomic_int_set(running, task->taskid);
 	}
+	pthread_mutex_unlock(&priv->task_mutex);
 
-	return NULL;
+	return task;
 }
 
 void remmina_ftp_client_update_task(RemminaFTPClient *client, RemminaFTPTask* task)
@@ -1263,8 +1439,7 @@ void remmina_ftp_client_update_task(RemminaFTPClient *client, RemminaFTPTask* ta
 	TRACE_CALL("remmina_ftp_client_update_task");
 	RemminaFTPClientPriv *priv = (RemminaFTPClientPriv*) client->priv;
 	GtkListStore *store = GTK_LIST_STORE(priv->task_list_model);
-	GtkTreePath *path;
-	GtkTreeIter iter;
+	GtkTreeIter *iter;
 
 	if ( !remmina_masterthread_exec_is_main_thread() ) {
 		/* Allow the execution of this function from a non main thread */
@@ -1280,12 +1455,11 @@ void remmina_ftp_client_update_task(RemminaFTPClient *client, RemminaFTPTask* ta
 
 
 
-	path = gtk_tree_row_reference_get_path(task->rowref);
-	if (path == NULL)
+	/* The row is gone once the task was cancelled */
+	iter = (GtkTreeIter*) g_hash_table_lookup(priv->task_rows, GINT_TO_POINTER(task->taskid));
+	if (iter == NULL)
 		return;
-	gtk_tree_model_get_iter(priv->task_list_model, &iter, path);
-	gtk_tree_path_free(path);
-	gtk_list_store_set(store, &iter, REMMINA_FTP_TASK_COLUMN_SIZE, task->size, REMMINA_FTP_TASK_COLUMN_STATUS, task->status,
+	gtk_list_store_set(store, iter, REMMINA_FTP_TASK_COLUMN_SIZE, task->size, REMMINA_FTP_TASK_COLUMN_STATUS, task->status,
 			REMMINA_FTP_TASK_COLUMN_DONESIZE, task->donesize, REMMINA_FTP_TASK_COLUMN_TOOLTIP, task->tooltip, -1);
 }
 
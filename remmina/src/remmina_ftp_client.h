@@ -113,6 +113,20 @@ enum
 	REMMINA_FTP_TASK_N_COLUMNS
 };
 
+/* Files bigger than this wait in their own queue, see remmina_ftp_client_get_waiting_task() */
+#define REMMINA_FTP_CLIENT_LARGE_FILE (8.0 * 1024 * 1024)
+
+/* One entry for remmina_ftp_client_add_files() */
+typedef struct _RemminaFTPFile
+{
+	gint type;
+	const gchar *name;
+	gfloat size;
+	const gchar *user;
+	const gchar *group;
+	gint permission;
+} RemminaFTPFile;
+
 typedef struct _RemminaFTPTask
 {
 	/* Read-only */
@@ -122,7 +136,6 @@ typedef struct _RemminaFTPTask
 	gint tasktype;
 	gchar *remotedir;
 	gchar *localdir;
-	GtkTreeRowReference *rowref;
 	/* Updatable */
 	gfloat size;
 	gint status;
@@ -139,13 +152,21 @@ void remmina_ftp_client_set_show_hidden(RemminaFTPClient *client, gboolean show_
 void remmina_ftp_client_clear_file_list(RemminaFTPClient *client);
 /* column, value, ..., -1 */
 void remmina_ftp_client_add_file(RemminaFTPClient *client, ...);
+/* Add many files at once, much faster than remmina_ftp_client_add_file() for long lists */
+void remmina_ftp_client_add_files(RemminaFTPClient *client, const RemminaFTPFile *files, guint n_files);
+/* Detach the file list from its views while many rows are added in several calls, the
+ * list is sorted once by the matching thaw. Calls nest */
+void remmina_ftp_client_freeze_file_list(RemminaFTPClient *client);
+void remmina_ftp_client_thaw_file_list(RemminaFTPClient *client);
 /* Set the current directory. Should be called by opendir signal handler */
 void remmina_ftp_client_set_dir(RemminaFTPClient *client, const gchar *dir);
 /* Get the current directory as newly allocated string */
 gchar* remmina_ftp_client_get_dir(RemminaFTPClient *client);
-/* Get the next waiting task */
-RemminaFTPTask* remmina_ftp_client_get_waiting_task(RemminaFTPClient *client);
-/* Update the task */
+/* Take the oldest waiting task off the queue and mark it as running, from any thread.
+ * Its taskid is stored in running before a cancel can miss it. With prefer_small, files
+ * up to REMMINA_FTP_CLIENT_LARGE_FILE go first and a bigger one only if nothing else waits */
+RemminaFTPTask* remmina_ftp_client_get_waiting_task(RemminaFTPClient *client, gboolean prefer_small, gint *running);
+/* Update the row of the task, found by its taskid */
 void remmina_ftp_client_update_task(RemminaFTPClient *client, RemminaFTPTask* task);
 /* Free the RemminaFTPTask object */
 void remmina_ftp_task_free(RemminaFTPTask *task);
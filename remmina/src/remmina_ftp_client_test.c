@@ -0,0 +1,207 @@
+/*
+ * Remmina - The GTK+ Remote Desktop Client
+ * Copyright (C) 2014-2015 Antenore Gatta, Fabio Castelli, Giovanni Panozzo
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ *
+ *  In addition, as a special exception, the copyright holders give
+ *  permission to link the code of portions of this program with the
+ *  OpenSSL library under certain conditions as described in each
+ *  individual source file, and distribute linked combinations
+ *  including the two.
+ *  You must obey the GNU General Public License in all respects
+ *  for all of the code used other than OpenSSL. *  If you modify
+ *  file(s) with this exception, you may extend this exception to your
+ *  version of the file(s), but you are not obligated to do so. *  If you
+ *  do not wish to do so, delete this exception statement from your
+ *  version. *  If you delete this exception statement from all source
+ *  files in the program, then also delete it here.
+ *
+ */
+
+/* Fills the file list of the FTP client the way a streamed SFTP listing does,
+ * once batch by batch and once frozen for the whole listing, checks that both
+ * end up complete and sorted and prints the entries per second of each. Needs
+ * a display, the test is skipped without one. */
+
+#include <stdio.h>
+#include <string.h>
+#include <gtk/gtk.h>
+#include "remmina_file.h"
+#include "remmina_masterthread_exec.h"
+#include "remmina_ftp_client.h"
+
+/* Same batches as remmina_sftp_client_list_thread() */
+#define REMMINA_FTP_TEST_BATCH 256
+#define REMMINA_FTP_TEST_BATCH_MAX 2048
+#define REMMINA_FTP_TEST_ENTRIES 50000
+/* Every one in so many entries is a hidden file */
+#define REMMINA_FTP_TEST_HIDDEN 10
+
+/* The FTP client only needs these when saving its state or running tasks */
+gint remmina_file_get_int(RemminaFile *remminafile, const gchar *setting, gint default_value)
+{
+	return default_value;
+}
+
+void remmina_file_set_int(RemminaFile *remminafile, const gchar *setting, gint value)
+{
+}
+
+gboolean remmina_masterthread_exec_is_main_thread(void)
+{
+	return TRUE;
+}
+
+void remmina_masterthread_exec_and_wait(RemminaMTExecData *d)
+{
+}
+
+static GtkTreeView* remmina_ftp_test_find_file_view(GtkWidget *widget)
+{
+	GtkTreeView *view = NULL;
+	GList *children, *child;
+
+	/* The task list has its own, longer set of columns */
+	if (GTK_IS_TREE_VIEW(widget) && gtk_tree_view_get_model(GTK_TREE_VIEW(widget)) &&
+			gtk_tree_model_get_n_columns(gtk_tree_view_get_model(GTK_TREE_VIEW(widget))) == REMMINA_FTP_FILE_N_COLUMNS)
+		return GTK_TREE_VIEW(widget);
+	if (!GTK_IS_CONTAINER(widget))
+		return NULL;
+
+	children = gtk_container_get_children(GTK_CONTAINER(widget));
+	for (child = children; child && !view; child = child->next)
+		view = remmina_ftp_test_find_file_view(GTK_WIDGET(child->data));
+	g_list_free(children);
+	return view;
+}
+
+static RemminaFTPFile* remmina_ftp_test_files(void)
+{
+	RemminaFTPFile *files;
+	gint i, n;
+
+	files = g_new(RemminaFTPFile, REMMINA_FTP_TEST_ENTRIES);
+	for (i = 0; i < REMMINA_FTP_TEST_ENTRIES; i++)
+	{
+		/* Listed backwards, so the sort model has work to do */
+		n = REMMINA_FTP_TEST_ENTRIES - i;
+		files[i].type = (n % 7 == 0) ? REMMINA_FTP_FILE_TYPE_DIR : REMMINA_FTP_FILE_TYPE_FILE;
+		files[i].name = g_strdup_printf(n % REMMINA_FTP_TEST_HIDDEN == 0 ? ".hidden%06d" : "file%06d", n);
+		files[i].size = (gfloat) n * 512;
+		files[i].user = "user";
+		files[i].group = "group";
+		files[i].permission = 0644;
+	}
+	return files;
+}
+
+static gint remmina_ftp_test_list(const gchar *label, const RemminaFTPFile *files, gboolean freeze)
+{
+	GtkWidget *window;
+	GtkWidget *client;
+	GtkTreeView *view;
+	GtkTreeModel *model;
+	GtkTreeIter iter;
+	gchar *prev = NULL, *key;
+	gint64 start, elapsed;
+	guint batch_size = REMMINA_FTP_TEST_BATCH;
+	guint done = 0, n;
+	gint rows = 0, expected, errors = 0;
+
+	window = gtk_offscreen_window_new();
+	client = remmina_ftp_client_new();
+	gtk_container_add(GTK_CONTAINER(window), client);
+	gtk_widget_show_all(window);
+	remmina_ftp_client_set_show_hidden(REMMINA_FTP_CLIENT(client), FALSE);
+
+	start = g_get_monotonic_time();
+	remmina_ftp_client_clear_file_list(REMMINA_FTP_CLIENT(client));
+	while (done < REMMINA_FTP_TEST_ENTRIES)
+	{
+		n = MIN(batch_size, REMMINA_FTP_TEST_ENTRIES - done);
+		/* As remmina_sftp_client_list_batch(), once the first batch is in */
+		if (freeze && done == 0)
+			remmina_ftp_client_freeze_file_list(REMMINA_FTP_CLIENT(client));
+		remmina_ftp_client_add_files(REMMINA_FTP_CLIENT(client), files + done, n);
+		done += n;
+		batch_size = MIN(batch_size * 2, REMMINA_FTP_TEST_BATCH_MAX);
+		/* Batches reach the GTK thread through the main loop */
+		while (gtk_events_pending())
+			gtk_main_iteration();
+	}
+	if (freeze)
+		remmina_ftp_client_thaw_file_list(REMMINA_FTP_CLIENT(client));
+	while (gtk_events_pending())
+		gtk_main_iteration();
+	elapsed = MAX(g_get_monotonic_time() - start, 1);
+
+	/* The view shows every visible entry once, directories first and by name */
+	view = remmina_ftp_test_find_file_view(client);
+	model = view ? gtk_tree_view_get_model(view) : NULL;
+	if (model && gtk_tree_model_get_iter_first(model, &iter))
+	{
+		do
+		{
+			gtk_tree_model_get(model, &iter, REMMINA_FTP_FILE_COLUMN_NAME_SORT, &key, -1);
+			if (prev && strcmp(prev, key) > 0)
+			{
+				if (errors++ == 0)
+					printf("%s: %s listed before %s\n", label, prev, key);
+			}
+			g_free(prev);
+			prev = key;
+			rows++;
+		} while (gtk_tree_model_iter_next(model, &iter));
+	}
+	g_free(prev);
+
+	expected = REMMINA_FTP_TEST_ENTRIES - REMMINA_FTP_TEST_ENTRIES / REMMINA_FTP_TEST_HIDDEN;
+	if (rows != expected)
+	{
+		printf("%s: %d rows shown, expected %d\n", label, rows, expected);
+		errors++;
+	}
+
+	printf("%s: %d entries in %.1f ms, %.0f entries/s\n", label, REMMINA_FTP_TEST_ENTRIES, elapsed / 1000.0,
+			REMMINA_FTP_TEST_ENTRIES * 1000000.0 / elapsed);
+
+	gtk_widget_destroy(window);
+	return errors;
+}
+
+int main(int argc, char **argv)
+{
+	RemminaFTPFile *files;
+	gint errors = 0;
+	gint i;
+
+	if (!gtk_init_check(&argc, &argv))
+	{
+		printf("No display, skipped\n");
+		return 77;
+	}
+
+	files = remmina_ftp_test_files();
+	errors += remmina_ftp_test_list("batched", files, FALSE);
+	errors += remmina_ftp_test_list("frozen", files, TRUE);
+
+	for (i = 0; i < REMMINA_FTP_TEST_ENTRIES; i++)
+		g_free((gchar*) files[i].name);
+	g_free(files);
+
+	return errors ? 1 : 0;
+}
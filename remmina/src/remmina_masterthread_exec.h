@@ -46,7 +46,7 @@ typedef struct remmina_masterthread_exec_data {
 		FUNC_INIT_SAVE_CRED, FUNC_CHAT_RECEIVE, FUNC_FILE_GET_SECRET,
 		FUNC_DIALOG_SERVERKEY_CONFIRM, FUNC_DIALOG_AUTHPWD, FUNC_DIALOG_AUTHUSERPWD,
 		FUNC_DIALOG_CERT, FUNC_DIALOG_CERTCHANGED, FUNC_DIALOG_AUTHX509,
-		FUNC_FTP_CLIENT_UPDATE_TASK, FUNC_FTP_CLIENT_GET_WAITING_TASK,
+		FUNC_FTP_CLIENT_UPDATE_TASK,
 		FUNC_SFTP_CLIENT_CONFIRM_RESUME,
 		FUNC_VTE_TERMINAL_SET_ENCODING_AND_PTY } func;
 
@@ -114,10 +114,6 @@ typedef struct remmina_masterthread_exec_data {
 			RemminaFTPClient *client;
 			RemminaFTPTask* task;
 		} ftp_client_update_task;
-		struct {
-			RemminaFTPClient *client;
-			RemminaFTPTask* retval;
-		} ftp_client_get_waiting_task;
 #if defined (HAVE_LIBSSH) && defined (HAVE_LIBVTE)
 		struct {
 			RemminaSFTPClient *client;
@@ -323,6 +323,21 @@ void remmina_pref_init(void)
 	else
 		remmina_pref.recent_maximum = 10;
 
+	if (g_key_file_has_key(gkeyfile, "remmina_pref", "sftp_read_window", NULL))
+		remmina_pref.sftp_read_window = g_key_file_get_integer(gkeyfile, "remmina_pref", "sftp_read_window", NULL);
+	else
+		remmina_pref.sftp_read_window = DEFAULT_SFTP_READ_WINDOW;
+
+	if (g_key_file_has_key(gkeyfile, "remmina_pref", "sftp_write_window", NULL))
+		remmina_pref.sftp_write_window = g_key_file_get_integer(gkeyfile, "remmina_pref", "sftp_write_window", NULL);
+	else
+		remmina_pref.sftp_write_window = DEFAULT_SFTP_WRITE_WINDOW;
+
+	if (g_key_file_has_key(gkeyfile, "remmina_pref", "sftp_transfers", NULL))
+		remmina_pref.sftp_transfers = g_key_file_get_integer(gkeyfile, "remmina_pref", "sftp_transfers", NULL);
+	else
+		remmina_pref.sftp_transfers = DEFAULT_SFTP_TRANSFERS;
+
 	if (g_key_file_has_key(gkeyfile, "remmina_pref", "default_mode", NULL))
 		remmina_pref.default_mode = g_key_file_get_integer(gkeyfile, "remmina_pref", "default_mode", NULL);
 	else
@@ -513,6 +528,9 @@ void remmina_pref_save(void)
 	g_key_file_set_boolean(gkeyfile, "remmina_pref", "applet_enable_avahi", remmina_pref.applet_enable_avahi);
 	g_key_file_set_boolean(gkeyfile, "remmina_pref", "disable_tray_icon", remmina_pref.disable_tray_icon);
 	g_key_file_set_integer(gkeyfile, "remmina_pref", "recent_maximum", remmina_pref.recent_maximum);
+	g_key_file_set_integer(gkeyfile, "remmina_pref", "sftp_read_window", remmina_pref.sftp_read_window);
+	g_key_file_set_integer(gkeyfile, "remmina_pref", "sftp_write_window", remmina_pref.sftp_write_window);
+	g_key_file_set_integer(gkeyfile, "remmina_pref", "sftp_transfers", remmina_pref.sftp_transfers);
 	g_key_file_set_integer(gkeyfile, "remmina_pref", "default_mode", remmina_pref.default_mode);
 	g_key_file_set_integer(gkeyfile, "remmina_pref", "tab_mode", remmina_pref.tab_mode);
 	g_key_file_set_integer(gkeyfile, "remmina_pref", "show_buttons_icons", remmina_pref.show_buttons_icons);
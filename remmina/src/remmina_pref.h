@@ -128,6 +128,10 @@ typedef struct _RemminaPref
 	gboolean hide_quick_connect;
 	gboolean small_toolbutton;
 	gint view_file_mode;
+	/* SFTP transfers */
+	gint sftp_read_window;
+	gint sftp_write_window;
+	gint sftp_transfers;
 	/* In tray icon */
 	gboolean applet_enable_avahi;
 	/* Auto */
@@ -145,6 +149,9 @@ typedef struct _RemminaPref
 
 #define DEFAULT_SSHTUNNEL_PORT 4732
 #define DEFAULT_SSH_PORT 22
+#define DEFAULT_SFTP_READ_WINDOW 16
+#define DEFAULT_SFTP_WRITE_WINDOW 16
+#define DEFAULT_SFTP_TRANSFERS 4
 
 extern const gchar *default_resolutions;
 extern gchar *remmina_pref_file;
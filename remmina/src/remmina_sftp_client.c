@@ -49,6 +49,7 @@
 #include "remmina_pref.h"
 #include "remmina_ssh.h"
 #include "remmina_sftp_client.h"
+#include "remmina_sftp_transfer.h"
 #include "remmina_masterthread_exec.h"
 #include "remmina/remmina_trace_calls.h"
 
@@ -60,10 +61,26 @@ G_DEFINE_TYPE (RemminaSFTPClient, remmina_sftp_client, REMMINA_TYPE_FTP_CLIENT)
 		gdk_window_set_cursor (gtk_widget_get_window (GTK_WIDGET (client)), cur); \
 	}
 
+static void remmina_sftp_client_finalize (GObject *object);
+
 static void
 remmina_sftp_client_class_init (RemminaSFTPClientClass *klass)
 {
 	TRACE_CALL("remmina_sftp_client_class_init");
+	G_OBJECT_CLASS (klass)->finalize = remmina_sftp_client_finalize;
+}
+
+/* Runs once the listing and transfer threads dropped their references, none of them can still take the mutex */
+static void
+remmina_sftp_client_finalize (GObject *object)
+{
+	TRACE_CALL("remmina_sftp_client_finalize");
+	RemminaSFTPClient *client = REMMINA_SFTP_CLIENT (object);
+
+	g_ptr_array_free (client->listing_dirs, TRUE);
+	pthread_mutex_destroy (&client->sftp_mutex);
+
+	G_OBJECT_CLASS (remmina_sftp_client_parent_class)->finalize (object);
 }
 
 #define GET_SFTPATTR_TYPE(a,type) \
@@ -82,19 +99,83 @@ static gboolean remmina_sftp_client_refresh (RemminaSFTPClient *client);
 static void onMainThread_remmina_ftp_client_update_task( RemminaFTPClient *client, RemminaFTPTask* task );
 
 #define THREAD_CHECK_EXIT \
-    (!client->taskid || client->thread_abort)
+    (!remmina_sftp_client_thread_task_active (client, task) || client->thread_abort)
+
+/* How often the GTK thread shows the progress published by the transfer threads, in ms */
+#define REMMINA_SFTP_CLIENT_PROGRESS_INTERVAL 100
 
+/* Asynchronous writes only exist since libssh 0.11, older versions send them one by one */
+#if LIBSSH_VERSION_INT >= SSH_VERSION_INT(0, 11, 0)
+#define REMMINA_SFTP_AIO_WRITE
+#endif
+
+/* One block of a local file read ahead for an upload */
+typedef struct _RemminaSFTPBlock
+{
+	gssize len;	/* 0 at the end of the file, -1 on a read error */
+	gchar data[REMMINA_SFTP_CHUNK_SIZE];
+} RemminaSFTPBlock;
 
+/* A reader thread keeps filling free blocks from the local file while the task thread sends them */
+typedef struct _RemminaSFTPReadAhead
+{
+	FILE *local_file;
+	GAsyncQueue *free_queue;
+	GAsyncQueue *filled_queue;
+	gint abort;
+	pthread_t thread;
+} RemminaSFTPReadAhead;
+
+/* Start parameters of a transfer thread */
+typedef struct _RemminaSFTPClientWorker
+{
+	RemminaSFTPClient *client;
+	gint slot;
+} RemminaSFTPClientWorker;
 
+/* A running task stays active until cancelled, which clears its worker slot */
+static gboolean
+remmina_sftp_client_thread_task_active (RemminaSFTPClient *client, RemminaFTPTask *task)
+{
+	TRACE_CALL("remmina_sftp_client_thread_task_active");
+	gint i;
+
+	for (i = 0; i < REMMINA_SFTP_CLIENT_MAX_TRANSFERS; i++)
+	{
+		if (g_atomic_int_get (&client->taskids[i]) == task->taskid) return TRUE;
+	}
+	return FALSE;
+}
+
+/* Only publishes the progress of the task, the GTK thread shows it on its next tick */
 static gboolean
 remmina_sftp_client_thread_update_task (RemminaSFTPClient *client, RemminaFTPTask *task)
 {
 	TRACE_CALL("remmina_sftp_client_thread_update_task");
-	if (THREAD_CHECK_EXIT) return FALSE;
+	gint i;
 
-	remmina_ftp_client_update_task (REMMINA_FTP_CLIENT (client), task);
+	if (client->thread_abort) return FALSE;
 
-	return TRUE;
+	for (i = 0; i < REMMINA_SFTP_CLIENT_MAX_TRANSFERS; i++)
+	{
+		if (g_atomic_int_get (&client->taskids[i]) == task->taskid)
+		{
+			remmina_sftp_progress_publish (&client->progress[i], task->taskid, task->size, task->donesize);
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+/* Hands a task over to the GTK thread once its thread is done with it,
+ * the row is updated and the task freed there, nobody waits for it */
+static void
+remmina_sftp_client_thread_post_task (RemminaSFTPClient *client, RemminaFTPTask *task, gint slot)
+{
+	TRACE_CALL("remmina_sftp_client_thread_post_task");
+	/* Cleared first, so the GTK thread never shows the task running again */
+	remmina_sftp_progress_publish (&client->progress[slot], 0, 0, 0);
+	g_async_queue_push (client->done_tasks, task);
 }
 
 static void
@@ -115,8 +196,6 @@ remmina_sftp_client_thread_set_error (RemminaSFTPClient *client, RemminaFTPTask
 	{
 		task->tooltip = NULL;
 	}
-
-	remmina_sftp_client_thread_update_task (client, task);
 }
 
 static void
@@ -126,30 +205,54 @@ remmina_sftp_client_thread_set_finish (RemminaSFTPClient *client, RemminaFTPTask
 	task->status = REMMINA_FTP_TASK_STATUS_FINISH;
 	g_free(task->tooltip);
 	task->tooltip = NULL;
-
-	remmina_sftp_client_thread_update_task (client, task);
 }
 
 static RemminaFTPTask*
-remmina_sftp_client_thread_get_task (RemminaSFTPClient *client)
+remmina_sftp_client_thread_get_task (RemminaSFTPClient *client, gint slot)
 {
 	TRACE_CALL("remmina_sftp_client_thread_get_task");
 	RemminaFTPTask *task;
+	gint max_transfers;
+	gboolean prefer_small;
 
 	if (client->thread_abort) return NULL;
 
-	task = remmina_ftp_client_get_waiting_task (REMMINA_FTP_CLIENT (client));
+	/* When all the other threads copy large files, this one keeps small files moving */
+	max_transfers = g_atomic_int_get (&client->max_transfers);
+	prefer_small = (max_transfers > 1 && g_atomic_int_get (&client->large_transfers) >= max_transfers - 1);
+
+	/* Taken straight from the queue, the slot is set before the task leaves it */
+	task = remmina_ftp_client_get_waiting_task (REMMINA_FTP_CLIENT (client), prefer_small, &client->taskids[slot]);
 	if (task)
 	{
-		client->taskid = task->taskid;
-
-		task->status = REMMINA_FTP_TASK_STATUS_RUN;
-		remmina_ftp_client_update_task (REMMINA_FTP_CLIENT (client), task);
+		/* Shows the row as running on the next progress tick */
+		remmina_sftp_client_thread_update_task (client, task);
 	}
 
 	return task;
 }
 
+/* Client and task of a download, for its progress function */
+typedef struct _RemminaSFTPClientDownload
+{
+	RemminaSFTPClient *client;
+	RemminaFTPTask *task;
+} RemminaSFTPClientDownload;
+
+static gboolean
+remmina_sftp_client_thread_download_progress (guint64 donesize, gpointer data)
+{
+	TRACE_CALL("remmina_sftp_client_thread_download_progress");
+	RemminaSFTPClientDownload *download = (RemminaSFTPClientDownload*) data;
+	RemminaSFTPClient *client = download->client;
+	RemminaFTPTask *task = download->task;
+
+	if (THREAD_CHECK_EXIT) return FALSE;
+
+	task->donesize = (gfloat) donesize;
+	return remmina_sftp_client_thread_update_task (client, task);
+}
+
 static gboolean
 remmina_sftp_client_thread_download_file (RemminaSFTPClient *client, RemminaSFTP *sftp, RemminaFTPTask *task,
 		const gchar *remote_path, const gchar *local_path, guint64 *donesize)
@@ -158,8 +261,9 @@ remmina_sftp_client_thread_download_file (RemminaSFTPClient *client, RemminaSFTP
 	sftp_file remote_file;
 	FILE *local_file;
 	gchar *tmp;
-	gchar buf[20480];
-	gint len;
+	gchar buf[REMMINA_SFTP_CHUNK_SIZE];
+	RemminaSFTPClientDownload download;
+	gboolean ret;
 	gint response;
 	uint64_t size;
 
@@ -233,34 +337,40 @@ remmina_sftp_client_thread_download_file (RemminaSFTPClient *client, RemminaSFTP
 		{
 			sftp_close (remote_file);
 			fclose (local_file);
-			remmina_sftp_client_thread_set_error (client, task, "Error seeking remote file %s. %s",
+			remmina_sftp_client_thread_set_error (client, task, _("Error seeking remote file %s. %s"),
 					remote_path, ssh_get_error (REMMINA_SSH (client->sftp)->session));
 			return FALSE;
 		}
 		*donesize = size;
 	}
 
-	while (!THREAD_CHECK_EXIT && (len = sftp_read (remote_file, buf, sizeof (buf))) > 0)
+	download.client = client;
+	download.task = task;
+	ret = TRUE;
+	switch (remmina_sftp_transfer_download (remote_file, local_file, remmina_pref.sftp_read_window, donesize,
+			remmina_sftp_client_thread_download_progress, &download))
 	{
-		if (THREAD_CHECK_EXIT) break;
-
-		if (fwrite (buf, 1, len, local_file) < len)
-		{
-			sftp_close (remote_file);
-			fclose (local_file);
-			remmina_sftp_client_thread_set_error (client, task, _("Error writing file %s."), local_path);
-			return FALSE;
-		}
+		case REMMINA_SFTP_TRANSFER_READ_ERROR:
+		remmina_sftp_client_thread_set_error (client, task, _("Error reading file %s on server. %s"),
+				remote_path, ssh_get_error (REMMINA_SSH (client->sftp)->session));
+		ret = FALSE;
+		break;
 
-		*donesize += (guint64) len;
-		task->donesize = (gfloat) (*donesize);
+		case REMMINA_SFTP_TRANSFER_WRITE_ERROR:
+		remmina_sftp_client_thread_set_error (client, task, _("Error writing file %s."), local_path);
+		ret = FALSE;
+		break;
 
-		if (!remmina_sftp_client_thread_update_task (client, task)) break;
+		case REMMINA_SFTP_TRANSFER_SEEK_ERROR:
+		remmina_sftp_client_thread_set_error (client, task, _("Error seeking remote file %s. %s"),
+				remote_path, ssh_get_error (REMMINA_SSH (client->sftp)->session));
+		ret = FALSE;
+		break;
 	}
 
 	sftp_close (remote_file);
 	fclose (local_file);
-	return TRUE;
+	return ret;
 }
 
 static gboolean
@@ -422,6 +532,79 @@ remmina_sftp_client_thread_mkdir (RemminaSFTPClient *client, RemminaSFTP *sftp,
 	return TRUE;
 }
 
+static gpointer
+remmina_sftp_client_readahead_main (gpointer data)
+{
+	TRACE_CALL("remmina_sftp_client_readahead_main");
+	RemminaSFTPReadAhead *ra = (RemminaSFTPReadAhead*) data;
+	RemminaSFTPBlock *block;
+
+	for (;;)
+	{
+		block = (RemminaSFTPBlock*) g_async_queue_pop (ra->free_queue);
+		if (g_atomic_int_get (&ra->abort))
+		{
+			g_async_queue_push (ra->free_queue, block);
+			break;
+		}
+
+		block->len = fread (block->data, 1, REMMINA_SFTP_CHUNK_SIZE, ra->local_file);
+		if (block->len == 0 && ferror (ra->local_file))
+			block->len = -1;
+
+		g_async_queue_push (ra->filled_queue, block);
+		if (block->len <= 0)
+			break;
+	}
+
+	return NULL;
+}
+
+static gboolean
+remmina_sftp_client_readahead_start (RemminaSFTPReadAhead *ra, FILE *local_file, gint nblocks)
+{
+	TRACE_CALL("remmina_sftp_client_readahead_start");
+	gint i;
+
+	ra->local_file = local_file;
+	ra->free_queue = g_async_queue_new ();
+	ra->filled_queue = g_async_queue_new ();
+	ra->abort = 0;
+
+	for (i = 0; i < nblocks; i++)
+		g_async_queue_push (ra->free_queue, g_new (RemminaSFTPBlock, 1));
+
+	if (pthread_create (&ra->thread, NULL, remmina_sftp_client_readahead_main, ra))
+	{
+		while ((g_async_queue_length (ra->free_queue)) > 0)
+			g_free(g_async_queue_pop (ra->free_queue));
+		g_async_queue_unref (ra->free_queue);
+		g_async_queue_unref (ra->filled_queue);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+static void
+remmina_sftp_client_readahead_stop (RemminaSFTPReadAhead *ra)
+{
+	TRACE_CALL("remmina_sftp_client_readahead_stop");
+	gpointer block;
+
+	/* The reader may hold every block of the window, even with none filled yet.
+	 * One spare block always wakes it up when it waits for a free one */
+	g_atomic_int_set (&ra->abort, 1);
+	g_async_queue_push (ra->free_queue, g_new (RemminaSFTPBlock, 1));
+	pthread_join (ra->thread, NULL);
+
+	while ((block = g_async_queue_try_pop (ra->filled_queue)) != NULL)
+		g_free(block);
+	while ((block = g_async_queue_try_pop (ra->free_queue)) != NULL)
+		g_free(block);
+	g_async_queue_unref (ra->free_queue);
+	g_async_queue_unref (ra->filled_queue);
+}
+
 static gboolean
 remmina_sftp_client_thread_upload_file (RemminaSFTPClient *client, RemminaSFTP *sftp, RemminaFTPTask *task,
 		const gchar *remote_path, const gchar *local_path, guint64 *donesize)
@@ -430,11 +613,19 @@ remmina_sftp_client_thread_upload_file (RemminaSFTPClient *client, RemminaSFTP *
 	sftp_file remote_file;
 	FILE *local_file;
 	gchar *tmp;
-	gchar buf[20480];
-	gint len;
+	RemminaSFTPReadAhead ra;
+	RemminaSFTPBlock *block;
+	gint window;
+	gssize len;
+	gboolean ret;
+	gboolean read_error;
 	sftp_attributes attr;
 	gint response;
 	uint64_t size;
+#ifdef REMMINA_SFTP_AIO_WRITE
+	sftp_aio aios[REMMINA_SFTP_MAX_WINDOW];
+	gint head, inflight;
+#endif
 
 	if (THREAD_CHECK_EXIT) return FALSE;
 
@@ -480,7 +671,7 @@ remmina_sftp_client_thread_upload_file (RemminaSFTPClient *client, RemminaSFTP *
 			if (sftp_seek64 (remote_file, size) < 0)
 			{
 				sftp_close (remote_file);
-				remmina_sftp_client_thread_set_error (client, task, "Error seeking remote file %s. %s",
+				remmina_sftp_client_thread_set_error (client, task, _("Error seeking remote file %s. %s"),
 						remote_path, ssh_get_error (REMMINA_SSH (client->sftp)->session));
 				return FALSE;
 			}
@@ -502,43 +693,136 @@ remmina_sftp_client_thread_upload_file (RemminaSFTPClient *client, RemminaSFTP *
 		{
 			sftp_close (remote_file);
 			fclose (local_file);
-			remmina_sftp_client_thread_set_error (client, task, "Error seeking local file %s.", local_path);
+			remmina_sftp_client_thread_set_error (client, task, _("Error seeking local file %s."), local_path);
 			return FALSE;
 		}
 		*donesize = size;
 	}
 
-	while (!THREAD_CHECK_EXIT && (len = fread (buf, 1, sizeof (buf), local_file)) > 0)
+	window = CLAMP (remmina_pref.sftp_write_window, 1, REMMINA_SFTP_MAX_WINDOW);
+	if (!remmina_sftp_client_readahead_start (&ra, local_file, window))
 	{
-		if (THREAD_CHECK_EXIT) break;
+		sftp_close (remote_file);
+		fclose (local_file);
+		remmina_sftp_client_thread_set_error (client, task, _("Error reading file %s."), local_path);
+		return FALSE;
+	}
 
-		if (sftp_write (remote_file, buf, len) < len)
+	ret = TRUE;
+	read_error = FALSE;
+#ifdef REMMINA_SFTP_AIO_WRITE
+	head = 0;
+	inflight = 0;
+#endif
+
+	while (!THREAD_CHECK_EXIT)
+	{
+		block = (RemminaSFTPBlock*) g_async_queue_pop (ra.filled_queue);
+		len = block->len;
+
+		if (len <= 0)
 		{
-			sftp_close (remote_file);
-			fclose (local_file);
-			remmina_sftp_client_thread_set_error (client, task, _("Error writing file %s on server. %s"),
-					remote_path, ssh_get_error (REMMINA_SSH (client->sftp)->session));
-			return FALSE;
+			g_async_queue_push (ra.free_queue, block);
+			if (len < 0)
+			{
+				ret = FALSE;
+				read_error = TRUE;
+			}
+			break;
 		}
 
+#ifdef REMMINA_SFTP_AIO_WRITE
+		/* The request is serialized right away, so the block can go back to the reader */
+		if (inflight == window)
+		{
+			if (sftp_aio_wait_write (&aios[head]) < 0)
+			{
+				g_async_queue_push (ra.free_queue, block);
+				inflight--;
+				head = (head + 1) % REMMINA_SFTP_MAX_WINDOW;
+				ret = FALSE;
+				break;
+			}
+			head = (head + 1) % REMMINA_SFTP_MAX_WINDOW;
+			inflight--;
+		}
+		if (sftp_aio_begin_write (remote_file, block->data, len, &aios[(head + inflight) % REMMINA_SFTP_MAX_WINDOW]) < len)
+		{
+			g_async_queue_push (ra.free_queue, block);
+			ret = FALSE;
+			break;
+		}
+		inflight++;
+#else
+		if (sftp_write (remote_file, block->data, len) < len)
+		{
+			g_async_queue_push (ra.free_queue, block);
+			ret = FALSE;
+			break;
+		}
+#endif
+		g_async_queue_push (ra.free_queue, block);
+
 		*donesize += (guint64) len;
 		task->donesize = (gfloat) (*donesize);
 
 		if (!remmina_sftp_client_thread_update_task (client, task)) break;
 	}
 
+#ifdef REMMINA_SFTP_AIO_WRITE
+	/* Collect the last acknowledgements, or just drop them after an error */
+	while (inflight > 0)
+	{
+		if (ret)
+		{
+			if (sftp_aio_wait_write (&aios[head]) < 0)
+				ret = FALSE;
+		}
+		else
+		{
+			sftp_aio_free (aios[head]);
+		}
+		head = (head + 1) % REMMINA_SFTP_MAX_WINDOW;
+		inflight--;
+	}
+#endif
+
+	remmina_sftp_client_readahead_stop (&ra);
 	sftp_close (remote_file);
 	fclose (local_file);
-	return TRUE;
+
+	if (read_error)
+	{
+		remmina_sftp_client_thread_set_error (client, task, _("Error reading file %s."), local_path);
+	}
+	else if (!ret)
+	{
+		remmina_sftp_client_thread_set_error (client, task, _("Error writing file %s on server. %s"),
+				remote_path, ssh_get_error (REMMINA_SSH (client->sftp)->session));
+	}
+	return ret;
+}
+
+/* Drops the reference of a finished transfer thread, so that the client is never finalized outside the GTK thread */
+static gboolean
+remmina_sftp_client_worker_unref (RemminaSFTPClient *client)
+{
+	TRACE_CALL("remmina_sftp_client_worker_unref");
+	g_object_unref (client);
+	return FALSE;
 }
 
 static gpointer
 remmina_sftp_client_thread_main (gpointer data)
 {
 	TRACE_CALL("remmina_sftp_client_thread_main");
-	RemminaSFTPClient *client = REMMINA_SFTP_CLIENT (data);
+	RemminaSFTPClientWorker *worker = (RemminaSFTPClientWorker*) data;
+	RemminaSFTPClient *client = worker->client;
+	gint slot = worker->slot;
 	RemminaSFTP *sftp = NULL;
 	RemminaFTPTask *task;
+	gboolean large;
+	gint seq;
 	gchar *remote, *local;
 	guint64 size;
 	GPtrArray *array;
@@ -548,21 +832,77 @@ remmina_sftp_client_thread_main (gpointer data)
 	gchar *refreshdir = NULL;
 	gchar *tmp;
 	gboolean refresh = FALSE;
+	gboolean quit = FALSE;
 
-	task = remmina_sftp_client_thread_get_task (client);
-	while (task)
+	g_free(worker);
+
+	while (TRUE)
 	{
+		seq = g_atomic_int_get (&client->task_seq);
+		task = quit ? NULL : remmina_sftp_client_thread_get_task (client, slot);
+		if (!task)
+		{
+			if (sftp)
+			{
+				remmina_sftp_free (sftp);
+				sftp = NULL;
+			}
+
+			if (!client->thread_abort && refresh)
+			{
+				tmp = remmina_ftp_client_get_dir (REMMINA_FTP_CLIENT (client));
+				if (g_strcmp0(tmp, refreshdir) == 0)
+				{
+					IDLE_ADD ((GSourceFunc) remmina_sftp_client_refresh, client);
+				}
+				g_free(tmp);
+			}
+			g_free(refreshdir);
+			refreshdir = NULL;
+			refresh = FALSE;
+
+			/* Give the slot back, then make sure no task was queued while the
+			 * new-task signal still saw this thread running. The client may be
+			 * destroyed once the slot is released, the reference of this thread
+			 * keeps its memory around until the loop is left. */
+			g_atomic_int_and (&client->worker_slots, ~(1u << slot));
+			if (quit || client->thread_abort || g_atomic_int_get (&client->task_seq) == seq)
+				break;
+			if (g_atomic_int_or (&client->worker_slots, 1u << slot) & (1u << slot))
+				break;
+			continue;
+		}
+
+		large = (task->type == REMMINA_FTP_FILE_TYPE_FILE && task->size > REMMINA_FTP_CLIENT_LARGE_FILE);
+		if (large) g_atomic_int_inc (&client->large_transfers);
+
 		size = 0;
 		if (!sftp)
 		{
-			sftp = remmina_sftp_new_from_ssh (REMMINA_SSH (client->sftp));
+			/* Copy the connection parameters while the GTK thread cannot free the session */
+			pthread_mutex_lock (&client->sftp_mutex);
+			if (client->sftp && !client->thread_abort)
+				sftp = remmina_sftp_new_from_ssh (REMMINA_SSH (client->sftp));
+			pthread_mutex_unlock (&client->sftp_mutex);
+			if (!sftp)
+			{
+				remmina_sftp_client_thread_set_error (client, task, NULL);
+				if (large) g_atomic_int_add (&client->large_transfers, -1);
+				g_atomic_int_set (&client->taskids[slot], 0);
+				remmina_sftp_client_thread_post_task (client, task, slot);
+				quit = TRUE;
+				continue;
+			}
 			if (!remmina_ssh_init_session (REMMINA_SSH (sftp)) ||
 					remmina_ssh_auth (REMMINA_SSH (sftp), NULL) <= 0 ||
 					!remmina_sftp_open (sftp))
 			{
 				remmina_sftp_client_thread_set_error (client, task, (REMMINA_SSH (sftp))->error);
-				remmina_ftp_task_free (task);
-				break;
+				if (large) g_atomic_int_add (&client->large_transfers, -1);
+				g_atomic_int_set (&client->taskids[slot], 0);
+				remmina_sftp_client_thread_post_task (client, task, slot);
+				quit = TRUE;
+				continue;
 			}
 		}
 
@@ -681,106 +1021,354 @@ remmina_sftp_client_thread_main (gpointer data)
 		g_free(remote);
 		g_free(local);
 
-		remmina_ftp_task_free (task);
-		client->taskid = 0;
-
-		if (client->thread_abort) break;
+		if (large) g_atomic_int_add (&client->large_transfers, -1);
+		g_atomic_int_set (&client->taskids[slot], 0);
+		remmina_sftp_client_thread_post_task (client, task, slot);
 
-		task = remmina_sftp_client_thread_get_task (client);
+		if (client->thread_abort) quit = TRUE;
 	}
 
-	if (sftp)
+	IDLE_ADD ((GSourceFunc) remmina_sftp_client_worker_unref, client);
+	return NULL;
+}
+
+/* ------------------------ The SFTP Client routines ----------------------------- */
+
+static void
+remmina_sftp_client_flush_done_tasks (RemminaSFTPClient *client, gboolean show)
+{
+	TRACE_CALL("remmina_sftp_client_flush_done_tasks");
+	RemminaFTPTask *task;
+
+	while ((task = (RemminaFTPTask*) g_async_queue_try_pop (client->done_tasks)) != NULL)
 	{
-		remmina_sftp_free (sftp);
+		if (show) remmina_ftp_client_update_task (REMMINA_FTP_CLIENT (client), task);
+		remmina_ftp_task_free (task);
 	}
+}
 
-	if (!client->thread_abort && refresh)
+/* Samples the progress of the running tasks, then shows the finished ones.
+ * It stops by itself once no transfer thread is left */
+static gboolean
+remmina_sftp_client_progress_tick (RemminaSFTPClient *client)
+{
+	TRACE_CALL("remmina_sftp_client_progress_tick");
+	RemminaFTPTask task;
+	gint i;
+
+	memset (&task, 0, sizeof (task));
+	task.status = REMMINA_FTP_TASK_STATUS_RUN;
+	for (i = 0; i < REMMINA_SFTP_CLIENT_MAX_TRANSFERS; i++)
 	{
-		tmp = remmina_ftp_client_get_dir (REMMINA_FTP_CLIENT (client));
-		if (g_strcmp0(tmp, refreshdir) == 0)
-		{
-			IDLE_ADD ((GSourceFunc) remmina_sftp_client_refresh, client);
-		}
-		g_free(tmp);
+		/* Skipped when written meanwhile, the next tick will catch it */
+		if (!remmina_sftp_progress_sample (&client->progress[i], &task.taskid, &task.size, &task.donesize) ||
+				!task.taskid) continue;
+		remmina_ftp_client_update_task (REMMINA_FTP_CLIENT (client), &task);
 	}
-	g_free(refreshdir);
-	client->thread = 0;
 
-	return NULL;
-}
+	/* After the slots, so a finished task is never shown running again */
+	remmina_sftp_client_flush_done_tasks (client, TRUE);
 
-/* ------------------------ The SFTP Client routines ----------------------------- */
+	/* Transfer threads are only started on this thread, and post their
+	 * last task before they give their slot back */
+	if (g_atomic_int_get (&client->worker_slots) == 0 && g_async_queue_length (client->done_tasks) == 0)
+	{
+		client->progress_handler = 0;
+		return FALSE;
+	}
+	return TRUE;
+}
 
 static void
 remmina_sftp_client_destroy (RemminaSFTPClient *client, gpointer data)
 {
 	TRACE_CALL("remmina_sftp_client_destroy");
+	/* Stop a directory listing, it holds its own reference to the client */
+	g_atomic_int_inc (&client->listing_seq);
+	g_free(client->listing_dir);
+	client->listing_dir = NULL;
+	/* Raised before the session goes, a worker holding the lock then sees either */
+	client->thread_abort = TRUE;
+
+	pthread_mutex_lock (&client->sftp_mutex);
 	if (client->sftp)
 	{
+		/* A listing thread finding no session knows its directory is already closed */
+		while (client->listing_dirs->len > 0)
+			sftp_closedir ((sftp_dir) g_ptr_array_remove_index_fast (client->listing_dirs, 0));
 		remmina_sftp_free (client->sftp);
 		client->sftp = NULL;
 	}
-	client->thread_abort = TRUE;
-	/* We will wait for the thread to quit itself, and hopefully the thread is handling things correctly */
-	while (client->thread)
+	pthread_mutex_unlock (&client->sftp_mutex);
+	/* We will wait for the threads to quit themselves, and hopefully they are handling things correctly */
+	while (g_atomic_int_get (&client->worker_slots))
 	{
 		/* gdk_threads_leave (); */
 		sleep (1);
 		/* gdk_threads_enter (); */
 	}
+
+	if (client->progress_handler)
+	{
+		g_source_remove (client->progress_handler);
+		client->progress_handler = 0;
+	}
+	if (client->done_tasks)
+	{
+		remmina_sftp_client_flush_done_tasks (client, FALSE);
+		g_async_queue_unref (client->done_tasks);
+		client->done_tasks = NULL;
+	}
 }
 
-static sftp_dir
-remmina_sftp_client_sftp_session_opendir (RemminaSFTPClient *client, const gchar *dir)
+/* Entries handed over to the GTK thread in the first batch of a directory listing.
+ * Each following batch is twice as big, up to REMMINA_SFTP_CLIENT_LIST_BATCH_MAX,
+ * so a huge directory never holds the main loop for long */
+#define REMMINA_SFTP_CLIENT_LIST_BATCH 256
+#define REMMINA_SFTP_CLIENT_LIST_BATCH_MAX 2048
+
+/* One directory entry read by the listing thread */
+typedef struct _RemminaSFTPClientEntry
 {
-	TRACE_CALL("remmina_sftp_client_sftp_session_opendir");
-	sftp_dir sftpdir;
+	gint type;
+	gchar *name;
+	gfloat size;
+	gchar *owner;
+	gchar *group;
+	gint permissions;
+} RemminaSFTPClientEntry;
+
+/* A directory listed in the background. It is freed on the GTK thread with the last batch */
+typedef struct _RemminaSFTPClientListing
+{
+	RemminaSFTPClient *client;
+	gint seq;
+	gchar *dir;
+	/* Set by the listing thread */
+	gchar *newdir;
+	gchar *error;
+	/* Only used on the GTK thread */
+	gboolean started;
+	gboolean frozen;
+} RemminaSFTPClientListing;
+
+typedef struct _RemminaSFTPClientBatch
+{
+	RemminaSFTPClientListing *listing;
+	GPtrArray *entries;
+	gboolean last;
+} RemminaSFTPClientBatch;
+
+static void
+remmina_sftp_client_entry_free (RemminaSFTPClientEntry *entry)
+{
+	TRACE_CALL("remmina_sftp_client_entry_free");
+	g_free(entry->name);
+	g_free(entry->owner);
+	g_free(entry->group);
+	g_free(entry);
+}
+
+static RemminaSFTPClientBatch*
+remmina_sftp_client_batch_new (RemminaSFTPClientListing *listing)
+{
+	TRACE_CALL("remmina_sftp_client_batch_new");
+	RemminaSFTPClientBatch *batch;
+
+	batch = g_new0 (RemminaSFTPClientBatch, 1);
+	batch->listing = listing;
+	batch->entries = g_ptr_array_new_with_free_func ((GDestroyNotify) remmina_sftp_client_entry_free);
+	return batch;
+}
+
+static gboolean
+remmina_sftp_client_list_batch (RemminaSFTPClientBatch *batch)
+{
+	TRACE_CALL("remmina_sftp_client_list_batch");
+	RemminaSFTPClientListing *listing = batch->listing;
+	RemminaSFTPClient *client = listing->client;
+	RemminaSFTPClientEntry *entry;
+	RemminaFTPFile *files;
 	GtkWidget *dialog;
+	gboolean current;
+	guint i;
 
-	sftpdir = sftp_opendir (client->sftp->sftp_sess, (gchar*) dir);
-	if (!sftpdir)
+	/* Batches of a listing the user navigated away from are dropped */
+	current = (listing->seq == g_atomic_int_get (&client->listing_seq) && !client->thread_abort);
+
+	if (current && !listing->started && listing->newdir && (batch->entries->len > 0 || (batch->last && !listing->error)))
 	{
-		dialog = gtk_message_dialog_new (GTK_WINDOW(gtk_widget_get_toplevel (GTK_WIDGET (client))),
-				GTK_DIALOG_MODAL, GTK_MESSAGE_ERROR, GTK_BUTTONS_OK,
-				_("Failed to open directory %s. %s"), dir,
-				ssh_get_error (REMMINA_SSH (client->sftp)->session));
-		gtk_dialog_run (GTK_DIALOG(dialog));
-		gtk_widget_destroy (dialog);
-		return NULL;
+		listing->started = TRUE;
+		remmina_ftp_client_clear_file_list (REMMINA_FTP_CLIENT (client));
+		g_free(client->listing_dir);
+		client->listing_dir = g_strdup (listing->newdir);
+		remmina_ftp_client_set_dir (REMMINA_FTP_CLIENT (client), listing->newdir);
+		/* More batches follow, the list is sorted once when the last one is in */
+		if (!batch->last)
+		{
+			remmina_ftp_client_freeze_file_list (REMMINA_FTP_CLIENT (client));
+			listing->frozen = TRUE;
+		}
+	}
+
+	if (current && listing->started && batch->entries->len > 0)
+	{
+		files = g_new (RemminaFTPFile, batch->entries->len);
+		for (i = 0; i < batch->entries->len; i++)
+		{
+			entry = (RemminaSFTPClientEntry*) g_ptr_array_index (batch->entries, i);
+			files[i].type = entry->type;
+			files[i].name = entry->name;
+			files[i].size = entry->size;
+			files[i].user = entry->owner;
+			files[i].group = entry->group;
+			files[i].permission = entry->permissions;
+		}
+		remmina_ftp_client_add_files (REMMINA_FTP_CLIENT (client), files, batch->entries->len);
+		g_free(files);
 	}
-	return sftpdir;
+
+	if (batch->last)
+	{
+		/* Also when the user went elsewhere, the next listing keeps the list frozen if it needs to */
+		if (listing->frozen && !client->thread_abort)
+			remmina_ftp_client_thaw_file_list (REMMINA_FTP_CLIENT (client));
+
+		if (current)
+		{
+			g_free(client->listing_dir);
+			client->listing_dir = NULL;
+			SET_CURSOR (NULL);
+
+			if (listing->error)
+			{
+				dialog = gtk_message_dialog_new (GTK_WINDOW(gtk_widget_get_toplevel (GTK_WIDGET (client))),
+						GTK_DIALOG_MODAL, GTK_MESSAGE_ERROR, GTK_BUTTONS_OK, "%s", listing->error);
+				gtk_widget_show(dialog);
+				g_signal_connect(G_OBJECT(dialog), "response", G_CALLBACK(gtk_widget_destroy), NULL);
+			}
+		}
+
+		g_object_unref (client);
+		g_free(listing->dir);
+		g_free(listing->newdir);
+		g_free(listing->error);
+		g_free(listing);
+	}
+
+	g_ptr_array_free (batch->entries, TRUE);
+	g_free(batch);
+
+	return FALSE;
 }
 
-static gboolean
-remmina_sftp_client_sftp_session_closedir (RemminaSFTPClient *client, sftp_dir sftpdir)
+static gpointer
+remmina_sftp_client_list_main (gpointer data)
 {
-	TRACE_CALL("remmina_sftp_client_sftp_session_closedir");
-	GtkWidget *dialog;
+	TRACE_CALL("remmina_sftp_client_list_main");
+	RemminaSFTPClientListing *listing = (RemminaSFTPClientListing*) data;
+	RemminaSFTPClient *client = listing->client;
+	RemminaSFTPClientBatch *batch;
+	RemminaSFTPClientEntry *entry;
+	sftp_dir sftpdir = NULL;
+	sftp_attributes sftpattr;
+	gchar *newdir_conv;
+	gchar *tmp;
+	gint type;
+	guint batch_size = REMMINA_SFTP_CLIENT_LIST_BATCH;
 
-	if (!sftp_dir_eof (sftpdir))
+	/* The session is shared with the GTK thread, which may also close it */
+	pthread_mutex_lock (&client->sftp_mutex);
+	if (client->sftp && listing->seq == g_atomic_int_get (&client->listing_seq))
 	{
-		dialog = gtk_message_dialog_new (GTK_WINDOW(gtk_widget_get_toplevel (GTK_WIDGET (client))),
-				GTK_DIALOG_MODAL, GTK_MESSAGE_ERROR, GTK_BUTTONS_OK,
-				_("Failed reading directory. %s"), ssh_get_error (REMMINA_SSH (client->sftp)->session));
-		gtk_dialog_run (GTK_DIALOG(dialog));
-		gtk_widget_destroy (dialog);
-		return FALSE;
+		tmp = remmina_ssh_unconvert (REMMINA_SSH (client->sftp), listing->dir);
+		newdir_conv = sftp_canonicalize_path (client->sftp->sftp_sess, tmp);
+		g_free(tmp);
+		listing->newdir = remmina_ssh_convert (REMMINA_SSH (client->sftp), newdir_conv);
+		if (listing->newdir)
+			sftpdir = sftp_opendir (client->sftp->sftp_sess, newdir_conv);
+		if (sftpdir)
+			g_ptr_array_add (client->listing_dirs, sftpdir);
+		else
+		{
+			listing->error = g_strdup_printf (_("Failed to open directory %s. %s"), listing->dir,
+					ssh_get_error (REMMINA_SSH (client->sftp)->session));
+		}
+		g_free(newdir_conv);
 	}
-	sftp_closedir (sftpdir);
-	return TRUE;
+	pthread_mutex_unlock (&client->sftp_mutex);
+
+	batch = remmina_sftp_client_batch_new (listing);
+	while (sftpdir)
+	{
+		pthread_mutex_lock (&client->sftp_mutex);
+		if (!client->sftp)
+		{
+			/* The directory handle was closed together with the session */
+			pthread_mutex_unlock (&client->sftp_mutex);
+			break;
+		}
+		if (listing->seq != g_atomic_int_get (&client->listing_seq))
+		{
+			g_ptr_array_remove_fast (client->listing_dirs, sftpdir);
+			sftp_closedir (sftpdir);
+			pthread_mutex_unlock (&client->sftp_mutex);
+			break;
+		}
+
+		sftpattr = sftp_readdir (client->sftp->sftp_sess, sftpdir);
+		if (!sftpattr)
+		{
+			if (!sftp_dir_eof (sftpdir))
+			{
+				listing->error = g_strdup_printf (_("Failed reading directory. %s"),
+						ssh_get_error (REMMINA_SSH (client->sftp)->session));
+			}
+			g_ptr_array_remove_fast (client->listing_dirs, sftpdir);
+			sftp_closedir (sftpdir);
+			pthread_mutex_unlock (&client->sftp_mutex);
+			break;
+		}
+
+		if (g_strcmp0(sftpattr->name, ".") != 0 &&
+				g_strcmp0(sftpattr->name, "..") != 0)
+		{
+			GET_SFTPATTR_TYPE (sftpattr, type);
+			entry = g_new (RemminaSFTPClientEntry, 1);
+			entry->type = type;
+			entry->name = remmina_ssh_convert (REMMINA_SSH (client->sftp), sftpattr->name);
+			entry->size = (gfloat) sftpattr->size;
+			entry->owner = g_strdup (sftpattr->owner);
+			entry->group = g_strdup (sftpattr->group);
+			entry->permissions = sftpattr->permissions;
+			g_ptr_array_add (batch->entries, entry);
+		}
+		pthread_mutex_unlock (&client->sftp_mutex);
+		sftp_attributes_free (sftpattr);
+
+		if (batch->entries->len >= batch_size)
+		{
+			IDLE_ADD ((GSourceFunc) remmina_sftp_client_list_batch, batch);
+			batch = remmina_sftp_client_batch_new (listing);
+			batch_size = MIN (batch_size * 2, REMMINA_SFTP_CLIENT_LIST_BATCH_MAX);
+		}
+	}
+
+	/* The last batch is always sent, it releases the listing and the client */
+	batch->last = TRUE;
+	IDLE_ADD ((GSourceFunc) remmina_sftp_client_list_batch, batch);
+
+	return NULL;
 }
 
 static void
 remmina_sftp_client_on_opendir (RemminaSFTPClient *client, gchar *dir, gpointer data)
 {
 	TRACE_CALL("remmina_sftp_client_on_opendir");
-	sftp_dir sftpdir;
-	sftp_attributes sftpattr;
-	GtkWidget *dialog;
+	RemminaSFTPClientListing *listing;
+	pthread_t thread;
 	gchar *newdir;
-	gchar *newdir_conv;
 	gchar *tmp;
-	gint type;
 
 	if (client->sftp == NULL) return;
 
@@ -806,68 +1394,72 @@ remmina_sftp_client_on_opendir (RemminaSFTPClient *client, gchar *dir, gpointer
 		}
 	}
 
-	tmp = remmina_ssh_unconvert (REMMINA_SSH (client->sftp), newdir);
-	newdir_conv = sftp_canonicalize_path (client->sftp->sftp_sess, tmp);
-	g_free(tmp);
-	g_free(newdir);
-	newdir = remmina_ssh_convert (REMMINA_SSH (client->sftp), newdir_conv);
-	if (!newdir)
-	{
-		dialog = gtk_message_dialog_new (NULL,
-				GTK_DIALOG_MODAL, GTK_MESSAGE_ERROR, GTK_BUTTONS_OK,
-				_("Failed to open directory %s. %s"), dir,
-				ssh_get_error (REMMINA_SSH (client->sftp)->session));
-		gtk_widget_show(dialog);
-		g_signal_connect(G_OBJECT(dialog), "response", G_CALLBACK(gtk_widget_destroy), NULL);
-		g_free(newdir_conv);
-		return;
-	}
-
-	sftpdir = remmina_sftp_client_sftp_session_opendir (client, newdir_conv);
-	g_free(newdir_conv);
-	if (!sftpdir)
+	/* Setting the directory of a listing in progress comes back here through the combo box */
+	if (client->listing_dir && g_strcmp0(newdir, client->listing_dir) == 0)
 	{
 		g_free(newdir);
 		return;
 	}
+	g_free(client->listing_dir);
+	client->listing_dir = NULL;
 
-	remmina_ftp_client_clear_file_list (REMMINA_FTP_CLIENT (client));
+	/* The listing runs in its own thread and streams the entries back in batches,
+	 * a newer listing makes the previous one stop */
+	listing = g_new0 (RemminaSFTPClientListing, 1);
+	listing->client = client;
+	listing->seq = g_atomic_int_add (&client->listing_seq, 1) + 1;
+	listing->dir = newdir;
 
-	while ((sftpattr = sftp_readdir (client->sftp->sftp_sess, sftpdir)))
+	g_object_ref (client);
+	SET_CURSOR (gdk_cursor_new (GDK_WATCH));
+	if (pthread_create (&thread, NULL, remmina_sftp_client_list_main, listing))
 	{
-		if (g_strcmp0(sftpattr->name, ".") != 0 &&
-				g_strcmp0(sftpattr->name, "..") != 0)
-		{
-			GET_SFTPATTR_TYPE (sftpattr, type);
-
-			tmp = remmina_ssh_convert (REMMINA_SSH (client->sftp), sftpattr->name);
-			remmina_ftp_client_add_file (REMMINA_FTP_CLIENT (client),
-					REMMINA_FTP_FILE_COLUMN_TYPE, type,
-					REMMINA_FTP_FILE_COLUMN_NAME, tmp,
-					REMMINA_FTP_FILE_COLUMN_SIZE, (gfloat) sftpattr->size,
-					REMMINA_FTP_FILE_COLUMN_USER, sftpattr->owner,
-					REMMINA_FTP_FILE_COLUMN_GROUP, sftpattr->group,
-					REMMINA_FTP_FILE_COLUMN_PERMISSION, sftpattr->permissions,
-					-1);
-			g_free(tmp);
-		}
-		sftp_attributes_free (sftpattr);
+		SET_CURSOR (NULL);
+		g_object_unref (client);
+		g_free(listing->dir);
+		g_free(listing);
+		return;
 	}
-	remmina_sftp_client_sftp_session_closedir (client, sftpdir);
-
-	remmina_ftp_client_set_dir (REMMINA_FTP_CLIENT (client), newdir);
-	g_free(newdir);
+	pthread_detach (thread);
 }
 
 static void
 remmina_sftp_client_on_newtask (RemminaSFTPClient *client, gpointer data)
 {
 	TRACE_CALL("remmina_sftp_client_on_newtask");
-	if (client->thread) return;
+	RemminaSFTPClientWorker *worker;
+	pthread_t thread;
+	guint bit;
+	gint max_transfers;
+	gint i;
 
-	if (pthread_create (&client->thread, NULL, remmina_sftp_client_thread_main, client))
+	g_atomic_int_inc (&client->task_seq);
+
+	max_transfers = CLAMP (remmina_pref.sftp_transfers, 1, REMMINA_SFTP_CLIENT_MAX_TRANSFERS);
+	g_atomic_int_set (&client->max_transfers, max_transfers);
+
+	if (!client->progress_handler)
+		client->progress_handler = g_timeout_add (REMMINA_SFTP_CLIENT_PROGRESS_INTERVAL,
+				(GSourceFunc) remmina_sftp_client_progress_tick, client);
+
+	/* Fill the free slots, threads finding nothing to do just leave */
+	for (i = 0; i < max_transfers; i++)
 	{
-		client->thread = 0;
+		bit = 1u << i;
+		if (g_atomic_int_or (&client->worker_slots, bit) & bit) continue;
+
+		worker = g_new (RemminaSFTPClientWorker, 1);
+		worker->client = client;
+		worker->slot = i;
+		g_object_ref (client);
+		if (pthread_create (&thread, NULL, remmina_sftp_client_thread_main, worker))
+		{
+			g_object_unref (client);
+			g_free(worker);
+			g_atomic_int_and (&client->worker_slots, ~bit);
+			break;
+		}
+		pthread_detach (thread);
 	}
 }
 
@@ -877,8 +1469,13 @@ remmina_sftp_client_on_canceltask (RemminaSFTPClient *client, gint taskid, gpoin
 	TRACE_CALL("remmina_sftp_client_on_canceltask");
 	GtkWidget *dialog;
 	gint ret;
+	gint i;
 
-	if (client->taskid != taskid) return TRUE;
+	for (i = 0; i < REMMINA_SFTP_CLIENT_MAX_TRANSFERS; i++)
+	{
+		if (g_atomic_int_get (&client->taskids[i]) == taskid) break;
+	}
+	if (i == REMMINA_SFTP_CLIENT_MAX_TRANSFERS) return TRUE;
 
 	dialog = gtk_message_dialog_new (GTK_WINDOW(gtk_widget_get_toplevel (GTK_WIDGET (client))),
 			GTK_DIALOG_MODAL, GTK_MESSAGE_QUESTION, GTK_BUTTONS_YES_NO,
@@ -887,8 +1484,8 @@ remmina_sftp_client_on_canceltask (RemminaSFTPClient *client, gint taskid, gpoin
 	gtk_widget_destroy (dialog);
 	if (ret == GTK_RESPONSE_YES)
 	{
-		/* Make sure we are still handling the same task before we clear the flag */
-		if (client->taskid == taskid) client->taskid = 0;
+		/* Make sure the thread is still handling the same task before we clear the slot */
+		g_atomic_int_compare_and_exchange (&client->taskids[i], taskid, 0);
 		return TRUE;
 	}
 	return FALSE;
@@ -901,7 +1498,9 @@ remmina_sftp_client_on_deletefile (RemminaSFTPClient *client, gint type, gchar *
 	GtkWidget *dialog;
 	gint ret = 0;
 	gchar *tmp;
+	gchar *error = NULL;
 
+	pthread_mutex_lock (&client->sftp_mutex);
 	tmp = remmina_ssh_unconvert (REMMINA_SSH (client->sftp), name);
 	switch (type)
 	{
@@ -914,13 +1513,17 @@ remmina_sftp_client_on_deletefile (RemminaSFTPClient *client, gint type, gchar *
 		break;
 	}
 	g_free(tmp);
+	if (ret != 0)
+		error = g_strdup (ssh_get_error (REMMINA_SSH (client->sftp)->session));
+	pthread_mutex_unlock (&client->sftp_mutex);
 
 	if (ret != 0)
 	{
 		dialog = gtk_message_dialog_new (GTK_WINDOW(gtk_widget_get_toplevel (GTK_WIDGET (client))),
 				GTK_DIALOG_MODAL, GTK_MESSAGE_ERROR, GTK_BUTTONS_OK,
 				_("Failed to delete '%s'. %s"),
-				name, ssh_get_error (REMMINA_SSH (client->sftp)->session));
+				name, error);
+		g_free(error);
 		gtk_dialog_run (GTK_DIALOG(dialog));
 		gtk_widget_destroy (dialog);
 		return FALSE;
@@ -933,9 +1536,19 @@ remmina_sftp_client_init (RemminaSFTPClient *client)
 {
 	TRACE_CALL("remmina_sftp_client_init");
 	client->sftp = NULL;
-	client->thread = 0;
-	client->taskid = 0;
+	client->worker_slots = 0;
+	memset (client->taskids, 0, sizeof (client->taskids));
+	client->max_transfers = 1;
+	client->large_transfers = 0;
+	client->task_seq = 0;
 	client->thread_abort = FALSE;
+	memset (client->progress, 0, sizeof (client->progress));
+	client->done_tasks = g_async_queue_new ();
+	client->progress_handler = 0;
+	pthread_mutex_init (&client->sftp_mutex, NULL);
+	client->listing_seq = 0;
+	client->listing_dir = NULL;
+	client->listing_dirs = g_ptr_array_new ();
 
 	/* Setup the internal signals */
 	g_signal_connect(G_OBJECT(client), "destroy",
@@ -954,13 +1567,9 @@ static gboolean
 remmina_sftp_client_refresh (RemminaSFTPClient *client)
 {
 	TRACE_CALL("remmina_sftp_client_refresh");
-	SET_CURSOR (gdk_cursor_new (GDK_WATCH));
-	gdk_flush ();
-
+	/* The listing sets the busy cursor until it is done */
 	remmina_sftp_client_on_opendir (client, ".", NULL);
 
-	SET_CURSOR (NULL);
-
 	return FALSE;
 }
 
@@ -43,6 +43,7 @@
 #include "remmina_file.h"
 #include "remmina_ftp_client.h"
 #include "remmina_ssh.h"
+#include "remmina_sftp_transfer.h"
 
 G_BEGIN_DECLS
 
@@ -53,15 +54,39 @@ G_BEGIN_DECLS
 #define REMMINA_IS_SFTP_CLIENT_CLASS(klass)    (G_TYPE_CHECK_CLASS_TYPE ((klass), REMMINA_TYPE_SFTP_CLIENT))
 #define REMMINA_SFTP_CLIENT_GET_CLASS(obj)     (G_TYPE_INSTANCE_GET_CLASS ((obj), REMMINA_TYPE_SFTP_CLIENT, RemminaSFTPClientClass))
 
+/* Most transfers running at once, each one on its own SFTP session */
+#define REMMINA_SFTP_CLIENT_MAX_TRANSFERS 8
+
 typedef struct _RemminaSFTPClient
 {
 	RemminaFTPClient client;
 
 	RemminaSFTP *sftp;
 
-	pthread_t thread;
-	gint taskid;
+	/* One bit per running transfer thread */
+	guint worker_slots;
+	/* Task handled by each transfer thread, 0 when idle or cancelled */
+	gint taskids[REMMINA_SFTP_CLIENT_MAX_TRANSFERS];
+	gint max_transfers;
+	gint large_transfers;
+	/* Bumped on every new-task signal */
+	gint task_seq;
 	gboolean thread_abort;
+
+	/* Published by the transfer threads, shown by a timer on the GTK thread */
+	RemminaSFTPClientProgress progress[REMMINA_SFTP_CLIENT_MAX_TRANSFERS];
+	/* Finished and failed tasks waiting for the timer, which frees them */
+	GAsyncQueue *done_tasks;
+	guint progress_handler;
+
+	/* Guards the session in sftp, shared with the directory listing thread */
+	pthread_mutex_t sftp_mutex;
+	/* Bumped when a directory is opened, an older listing stops when it sees it */
+	gint listing_seq;
+	/* Directory of the listing being shown, only used on the GTK thread */
+	gchar *listing_dir;
+	/* Directories read by listing threads, guarded by sftp_mutex. They are closed before the session */
+	GPtrArray *listing_dirs;
 }RemminaSFTPClient;
 
 typedef struct _RemminaSFTPClientClass
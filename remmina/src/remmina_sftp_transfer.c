@@ -0,0 +1,164 @@
+/*
+ * Remmina - The GTK+ Remote Desktop Client
+ * Copyright (C) 2009 - Vic Lee 
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, 
+ * Boston, MA  02110-1301, USA.
+ *
+ *  In addition, as a special exception, the copyright holders give
+ *  permission to link the code of portions of this program with the
+ *  OpenSSL library under certain conditions as described in each
+ *  individual source file, and distribute linked combinations
+ *  including the two.
+ *  You must obey the GNU General Public License in all respects
+ *  for all of the code used other than OpenSSL. *  If you modify
+ *  file(s) with this exception, you may extend this exception to your
+ *  version of the file(s), but you are not obligated to do so. *  If you
+ *  do not wish to do so, delete this exception statement from your
+ *  version. *  If you delete this exception statement from all source
+ *  files in the program, then also delete it here.
+ *
+ */
+
+#define _FILE_OFFSET_BITS 64
+#include "config.h"
+
+#ifdef HAVE_LIBSSH
+
+#include <glib.h>
+#include "remmina_sftp_transfer.h"
+#include "remmina/remmina_trace_calls.h"
+
+/* Collects the answers of read requests still in flight, so they do not pile up in the session */
+static void
+remmina_sftp_transfer_drain_reads (sftp_file remote_file, gchar *buf, const gint *ids, gint head, gint inflight)
+{
+	TRACE_CALL("remmina_sftp_transfer_drain_reads");
+
+	while (inflight-- > 0)
+	{
+		sftp_async_read (remote_file, buf, REMMINA_SFTP_CHUNK_SIZE, ids[head]);
+		head = (head + 1) % REMMINA_SFTP_MAX_WINDOW;
+	}
+}
+
+gint
+remmina_sftp_transfer_download (sftp_file remote_file, FILE *local_file, gint window,
+		guint64 *donesize, RemminaSFTPTransferFunc func, gpointer data)
+{
+	TRACE_CALL("remmina_sftp_transfer_download");
+	gchar buf[REMMINA_SFTP_CHUNK_SIZE];
+	gint ids[REMMINA_SFTP_MAX_WINDOW];
+	gint head, inflight, id;
+	gint chunk;
+	gboolean eof;
+	gint len;
+
+	window = CLAMP (window, 1, REMMINA_SFTP_MAX_WINDOW);
+	chunk = REMMINA_SFTP_CHUNK_SIZE;
+	head = 0;
+	inflight = 0;
+	eof = FALSE;
+
+	while (func (*donesize, data))
+	{
+		/* Keep up to window read requests in flight, each one moves the remote offset forward */
+		while (!eof && inflight < window)
+		{
+			id = sftp_async_read_begin (remote_file, chunk);
+			if (id < 0)
+			{
+				remmina_sftp_transfer_drain_reads (remote_file, buf, ids, head, inflight);
+				return REMMINA_SFTP_TRANSFER_READ_ERROR;
+			}
+			ids[(head + inflight) % REMMINA_SFTP_MAX_WINDOW] = id;
+			inflight++;
+		}
+
+		if (inflight == 0) return REMMINA_SFTP_TRANSFER_DONE;
+
+		len = sftp_async_read (remote_file, buf, REMMINA_SFTP_CHUNK_SIZE, ids[head]);
+		head = (head + 1) % REMMINA_SFTP_MAX_WINDOW;
+		inflight--;
+
+		if (len < 0)
+		{
+			remmina_sftp_transfer_drain_reads (remote_file, buf, ids, head, inflight);
+			return REMMINA_SFTP_TRANSFER_READ_ERROR;
+		}
+
+		if (len == 0)
+		{
+			eof = TRUE;
+			continue;
+		}
+
+		if (fwrite (buf, 1, len, local_file) < len)
+		{
+			remmina_sftp_transfer_drain_reads (remote_file, buf, ids, head, inflight);
+			return REMMINA_SFTP_TRANSFER_WRITE_ERROR;
+		}
+
+		*donesize += (guint64) len;
+
+		/* A short read is either the end of the file or a server capping the request size.
+		 * The requests behind it were issued at the wrong offsets, so throw them away and
+		 * restart from where the data actually ends: at EOF the next read returns 0.
+		 * Further requests ask for the capped size, so they stay in flight together */
+		if (len < chunk)
+		{
+			remmina_sftp_transfer_drain_reads (remote_file, buf, ids, head, inflight);
+			inflight = 0;
+			if (sftp_seek64 (remote_file, *donesize) < 0)
+			{
+				return REMMINA_SFTP_TRANSFER_SEEK_ERROR;
+			}
+			if (len >= REMMINA_SFTP_MIN_CHUNK_SIZE)
+			{
+				chunk = len;
+			}
+		}
+	}
+
+	remmina_sftp_transfer_drain_reads (remote_file, buf, ids, head, inflight);
+	return REMMINA_SFTP_TRANSFER_STOPPED;
+}
+
+void
+remmina_sftp_progress_publish (RemminaSFTPClientProgress *progress, gint taskid, gfloat size, gfloat donesize)
+{
+	TRACE_CALL("remmina_sftp_progress_publish");
+	g_atomic_int_inc (&progress->seq);
+	progress->taskid = taskid;
+	progress->size = size;
+	progress->donesize = donesize;
+	g_atomic_int_inc (&progress->seq);
+}
+
+gboolean
+remmina_sftp_progress_sample (RemminaSFTPClientProgress *progress, gint *taskid, gfloat *size, gfloat *donesize)
+{
+	TRACE_CALL("remmina_sftp_progress_sample");
+	gint seq;
+
+	seq = g_atomic_int_get (&progress->seq);
+	if (seq & 1) return FALSE;
+	*taskid = progress->taskid;
+	*size = progress->size;
+	*donesize = progress->donesize;
+	return g_atomic_int_get (&progress->seq) == seq;
+}
+
+#endif  /* HAVE_LIBSSH */
@@ -0,0 +1,90 @@
+/*
+ * Remmina - The GTK+ Remote Desktop Client
+ * Copyright (C) 2009 - Vic Lee 
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, 
+ * Boston, MA  02110-1301, USA.
+ *
+ *  In addition, as a special exception, the copyright holders give
+ *  permission to link the code of portions of this program with the
+ *  OpenSSL library under certain conditions as described in each
+ *  individual source file, and distribute linked combinations
+ *  including the two.
+ *  You must obey the GNU General Public License in all respects
+ *  for all of the code used other than OpenSSL. *  If you modify
+ *  file(s) with this exception, you may extend this exception to your
+ *  version of the file(s), but you are not obligated to do so. *  If you
+ *  do not wish to do so, delete this exception statement from your
+ *  version. *  If you delete this exception statement from all source
+ *  files in the program, then also delete it here.
+ *
+ */
+
+#ifndef __REMMINASFTPTRANSFER_H__
+#define __REMMINASFTPTRANSFER_H__
+
+#include "config.h"
+
+#ifdef HAVE_LIBSSH
+
+#include <stdio.h>
+#include <libssh/sftp.h>
+
+G_BEGIN_DECLS
+
+/* Size of one SFTP read or write request, and the most requests kept in flight on one file */
+#define REMMINA_SFTP_CHUNK_SIZE 32768
+#define REMMINA_SFTP_MAX_WINDOW 64
+/* A server capping reads below this size is only sent one read at a time */
+#define REMMINA_SFTP_MIN_CHUNK_SIZE 4096
+
+/* Progress of the task run by one transfer thread. The thread makes seq odd
+ * while it writes the other fields, readers retry when it changed under them */
+typedef struct _RemminaSFTPClientProgress
+{
+	gint seq;
+	gint taskid;
+	gfloat size;
+	gfloat donesize;
+} RemminaSFTPClientProgress;
+
+enum
+{
+	REMMINA_SFTP_TRANSFER_DONE,
+	REMMINA_SFTP_TRANSFER_STOPPED,
+	REMMINA_SFTP_TRANSFER_READ_ERROR,
+	REMMINA_SFTP_TRANSFER_WRITE_ERROR,
+	REMMINA_SFTP_TRANSFER_SEEK_ERROR
+};
+
+/* Called before every read with the bytes done so far, returns FALSE to stop the transfer */
+typedef gboolean (*RemminaSFTPTransferFunc) (guint64 donesize, gpointer data);
+
+/* Copies remote_file from its current offset to the end of local_file, keeping up to
+ * window read requests in flight. donesize is the offset of the remote file on entry
+ * and is kept up to date with the data written */
+gint remmina_sftp_transfer_download (sftp_file remote_file, FILE *local_file, gint window,
+		guint64 *donesize, RemminaSFTPTransferFunc func, gpointer data);
+
+/* Written by the transfer thread without ever waiting, read by the GTK thread at its own pace.
+ * Sampling returns FALSE when the progress is being written, the next sample gets it */
+void remmina_sftp_progress_publish (RemminaSFTPClientProgress *progress, gint taskid, gfloat size, gfloat donesize);
+gboolean remmina_sftp_progress_sample (RemminaSFTPClientProgress *progress, gint *taskid, gfloat *size, gfloat *donesize);
+
+G_END_DECLS
+
+#endif  /* HAVE_LIBSSH */
+
+#endif  /* __REMMINASFTPTRANSFER_H__  */
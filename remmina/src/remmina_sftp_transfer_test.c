@@ -0,0 +1,404 @@
+/*
+ * Remmina - The GTK+ Remote Desktop Client
+ * Copyright (C) 2009 - Vic Lee 
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, 
+ * Boston, MA  02110-1301, USA.
+ *
+ *  In addition, as a special exception, the copyright holders give
+ *  permission to link the code of portions of this program with the
+ *  OpenSSL library under certain conditions as described in each
+ *  individual source file, and distribute linked combinations
+ *  including the two.
+ *  You must obey the GNU General Public License in all respects
+ *  for all of the code used other than OpenSSL. *  If you modify
+ *  file(s) with this exception, you may extend this exception to your
+ *  version of the file(s), but you are not obligated to do so. *  If you
+ *  do not wish to do so, delete this exception statement from your
+ *  version. *  If you delete this exception statement from all source
+ *  files in the program, then also delete it here.
+ *
+ */
+
+/* Runs remmina_sftp_transfer_download() against a stand-in for libssh which
+ * answers every read request one round trip after it was sent, the way a
+ * server behind a slow link does, and checks the downloaded data. Covers
+ * servers answering less than asked, which makes the download re-seek, and
+ * prints the throughput of one request at a time against a full window. The
+ * progress is published the way the transfer threads do and sampled by a
+ * thread standing in for the GTK one, which must not slow the download down
+ * even when it is stuck for longer than the whole transfer. */
+
+#include <stdio.h>
+#include <string.h>
+#include <glib.h>
+#include "remmina_sftp_transfer.h"
+
+/* Round trip of the stand-in server, in microseconds */
+#define REMMINA_SFTP_TEST_LATENCY 2000
+#define REMMINA_SFTP_TEST_SIZE (4 * 1024 * 1024 + 12345)
+/* Largest read a capping server answers, below and above REMMINA_SFTP_MIN_CHUNK_SIZE */
+#define REMMINA_SFTP_TEST_CAP 20000
+#define REMMINA_SFTP_TEST_SMALL_CAP 1000
+/* Same as DEFAULT_SFTP_READ_WINDOW */
+#define REMMINA_SFTP_TEST_WINDOW 16
+/* A full window must be at least this many times faster than one request at a time */
+#define REMMINA_SFTP_TEST_SPEEDUP 4
+#define REMMINA_SFTP_TEST_MAX_REQUESTS 1024
+/* How often the sampler looks at the progress, and how long it is stuck, in microseconds */
+#define REMMINA_SFTP_TEST_SAMPLE_INTERVAL 1000
+#define REMMINA_SFTP_TEST_STALL 500000
+/* Least throughput with the sampler stuck, in percent of the one with it running */
+#define REMMINA_SFTP_TEST_STALLED_RATE 80
+
+typedef struct _RemminaSFTPTestRequest
+{
+	gint64 due;
+	guint64 offset;
+	guint32 len;
+} RemminaSFTPTestRequest;
+
+/* The remote file and the requests in flight on it */
+typedef struct _RemminaSFTPTestServer
+{
+	guint64 size;
+	guint32 cap;
+	/* Reads at or past this offset fail, 0 for none */
+	guint64 fail_offset;
+	guint64 offset;
+	RemminaSFTPTestRequest requests[REMMINA_SFTP_TEST_MAX_REQUESTS];
+	gint next_id;
+	gint outstanding;
+	gint reads;
+	gint seeks;
+	/* Progress calls left before the transfer is stopped, -1 for never */
+	gint stop_after;
+	guint64 last_donesize;
+	RemminaSFTPClientProgress progress;
+	gint errors;
+} RemminaSFTPTestServer;
+
+/* Stand-in for the GTK thread showing the progress of the download */
+typedef struct _RemminaSFTPTestSampler
+{
+	RemminaSFTPClientProgress *progress;
+	gfloat size;
+	/* Time the sampler is stuck before its first sample */
+	gint64 stall;
+	gint done;
+	gint samples;
+	gfloat donesize;
+	gint errors;
+} RemminaSFTPTestSampler;
+
+static guchar
+remmina_sftp_test_byte (guint64 offset)
+{
+	return (guchar) ((offset * 7) % 253);
+}
+
+int
+sftp_async_read_begin (sftp_file file, uint32_t len)
+{
+	RemminaSFTPTestServer *server = (RemminaSFTPTestServer*) file;
+	RemminaSFTPTestRequest *request;
+	gint id;
+
+	if (server->outstanding >= REMMINA_SFTP_TEST_MAX_REQUESTS) return -1;
+	id = server->next_id++;
+	request = &server->requests[id % REMMINA_SFTP_TEST_MAX_REQUESTS];
+	request->due = g_get_monotonic_time () + REMMINA_SFTP_TEST_LATENCY;
+	request->offset = server->offset;
+	request->len = len;
+	server->offset += len;
+	server->outstanding++;
+	return id;
+}
+
+int
+sftp_async_read (sftp_file file, void *data, uint32_t len, uint32_t id)
+{
+	RemminaSFTPTestServer *server = (RemminaSFTPTestServer*) file;
+	RemminaSFTPTestRequest *request = &server->requests[id % REMMINA_SFTP_TEST_MAX_REQUESTS];
+	gint64 wait;
+	guint32 n, i;
+
+	wait = request->due - g_get_monotonic_time ();
+	if (wait > 0) g_usleep (wait);
+	server->outstanding--;
+	server->reads++;
+
+	if (server->fail_offset && request->offset >= server->fail_offset) return -1;
+	if (request->offset >= server->size) return 0;
+	n = MIN (request->len, len);
+	if (server->cap) n = MIN (n, server->cap);
+	n = MIN (n, server->size - request->offset);
+	for (i = 0; i < n; i++)
+		((guchar*) data)[i] = remmina_sftp_test_byte (request->offset + i);
+	return n;
+}
+
+int
+sftp_seek64 (sftp_file file, uint64_t new_offset)
+{
+	RemminaSFTPTestServer *server = (RemminaSFTPTestServer*) file;
+
+	server->offset = new_offset;
+	server->seeks++;
+	return 0;
+}
+
+static gboolean
+remmina_sftp_test_progress (guint64 donesize, gpointer data)
+{
+	RemminaSFTPTestServer *server = (RemminaSFTPTestServer*) data;
+
+	if (donesize < server->last_donesize)
+	{
+		printf ("progress: went back from %" G_GUINT64_FORMAT " to %" G_GUINT64_FORMAT ", WRONG\n",
+				server->last_donesize, donesize);
+		server->errors++;
+	}
+	server->last_donesize = donesize;
+	remmina_sftp_progress_publish (&server->progress, 1, server->size, donesize);
+	if (server->stop_after == 0) return FALSE;
+	if (server->stop_after > 0) server->stop_after--;
+	return TRUE;
+}
+
+static gboolean
+remmina_sftp_test_sample (RemminaSFTPTestSampler *sampler)
+{
+	gint taskid;
+	gfloat size, donesize;
+
+	if (!remmina_sftp_progress_sample (sampler->progress, &taskid, &size, &donesize)) return FALSE;
+	if (!taskid) return FALSE;
+	if (taskid != 1 || size != sampler->size || donesize > size || donesize < sampler->donesize)
+	{
+		printf ("sampler: task %d at %.0f of %.0f after %.0f, WRONG\n", taskid, donesize, size, sampler->donesize);
+		sampler->errors++;
+	}
+	sampler->donesize = donesize;
+	sampler->samples++;
+	return TRUE;
+}
+
+static gpointer
+remmina_sftp_test_sampler (gpointer data)
+{
+	RemminaSFTPTestSampler *sampler = (RemminaSFTPTestSampler*) data;
+
+	if (sampler->stall) g_usleep (sampler->stall);
+	while (!g_atomic_int_get (&sampler->done))
+	{
+		remmina_sftp_test_sample (sampler);
+		g_usleep (REMMINA_SFTP_TEST_SAMPLE_INTERVAL);
+	}
+	/* Nothing writes any more, the last sample is the end of the download */
+	if (!remmina_sftp_test_sample (sampler) || sampler->donesize != sampler->size)
+	{
+		printf ("sampler: last sample at %.0f of %.0f, WRONG\n", sampler->donesize, sampler->size);
+		sampler->errors++;
+	}
+	return NULL;
+}
+
+/* Checks that local holds the remote file from offset start on */
+static gint
+remmina_sftp_test_check_file (const gchar *name, FILE *local, guint64 start, guint64 size)
+{
+	guchar buf[REMMINA_SFTP_CHUNK_SIZE];
+	guint64 offset = start;
+	size_t n, i;
+
+	rewind (local);
+	while ((n = fread (buf, 1, sizeof (buf), local)) > 0)
+	{
+		for (i = 0; i < n; i++)
+		{
+			if (buf[i] != remmina_sftp_test_byte (offset + i))
+			{
+				printf ("%s: wrong byte at %" G_GUINT64_FORMAT ", WRONG\n", name, (guint64) (offset + i));
+				return 1;
+			}
+		}
+		offset += n;
+	}
+	if (offset != size)
+	{
+		printf ("%s: got %" G_GUINT64_FORMAT " bytes of %" G_GUINT64_FORMAT ", WRONG\n", name, offset - start,
+				size - start);
+		return 1;
+	}
+	return 0;
+}
+
+/* Downloads the file from start on while sampler, when given, samples the progress.
+ * Returns the number of errors and the throughput in rate */
+static gint
+remmina_sftp_test_download (const gchar *name, gint window, guint64 size, guint32 cap, guint64 start,
+		RemminaSFTPTestSampler *sampler, gdouble *rate)
+{
+	RemminaSFTPTestServer *server;
+	GThread *thread = NULL;
+	FILE *local;
+	guint64 donesize;
+	gint64 begin, elapsed;
+	gint ret;
+	gint errors;
+
+	server = g_new0 (RemminaSFTPTestServer, 1);
+	server->size = size;
+	server->cap = cap;
+	server->offset = start;
+	server->stop_after = -1;
+	server->last_donesize = start;
+	donesize = start;
+	local = tmpfile ();
+	if (sampler)
+	{
+		sampler->progress = &server->progress;
+		sampler->size = size;
+		thread = g_thread_new ("sampler", remmina_sftp_test_sampler, sampler);
+	}
+
+	begin = g_get_monotonic_time ();
+	ret = remmina_sftp_transfer_download ((sftp_file) server, local, window, &donesize,
+			remmina_sftp_test_progress, server);
+	elapsed = MAX (g_get_monotonic_time () - begin, 1);
+
+	errors = server->errors;
+	if (sampler)
+	{
+		g_atomic_int_set (&sampler->done, 1);
+		g_thread_join (thread);
+		errors += sampler->errors;
+		printf ("%s: %d progress samples\n", name, sampler->samples);
+	}
+	if (ret != REMMINA_SFTP_TRANSFER_DONE)
+	{
+		printf ("%s: transfer ended with %d, WRONG\n", name, ret);
+		errors++;
+	}
+	if (donesize != size)
+	{
+		printf ("%s: donesize %" G_GUINT64_FORMAT " instead of %" G_GUINT64_FORMAT ", WRONG\n", name, donesize, size);
+		errors++;
+	}
+	if (server->outstanding)
+	{
+		printf ("%s: %d requests left unanswered, WRONG\n", name, server->outstanding);
+		errors++;
+	}
+	errors += remmina_sftp_test_check_file (name, local, start, size);
+
+	*rate = (size - start) / (gdouble) elapsed;
+	printf ("%s: %.2f MB/s, %d reads, %d seeks\n", name, *rate, server->reads, server->seeks);
+
+	fclose (local);
+	g_free (server);
+	return errors;
+}
+
+/* The transfer must answer every request it sent when it stops or fails half way */
+static gint
+remmina_sftp_test_interrupt (const gchar *name, gint stop_after, guint64 fail_offset, gint expected)
+{
+	RemminaSFTPTestServer *server;
+	FILE *local;
+	guint64 donesize = 0;
+	gint ret;
+	gint errors;
+
+	server = g_new0 (RemminaSFTPTestServer, 1);
+	server->size = REMMINA_SFTP_TEST_SIZE;
+	server->fail_offset = fail_offset;
+	server->stop_after = stop_after;
+	local = tmpfile ();
+
+	ret = remmina_sftp_transfer_download ((sftp_file) server, local, REMMINA_SFTP_TEST_WINDOW, &donesize,
+			remmina_sftp_test_progress, server);
+
+	errors = server->errors;
+	if (ret != expected)
+	{
+		printf ("%s: transfer ended with %d instead of %d, WRONG\n", name, ret, expected);
+		errors++;
+	}
+	if (server->outstanding)
+	{
+		printf ("%s: %d requests left unanswered, WRONG\n", name, server->outstanding);
+		errors++;
+	}
+	fflush (local);
+	errors += remmina_sftp_test_check_file (name, local, 0, donesize);
+
+	fclose (local);
+	g_free (server);
+	return errors;
+}
+
+int main (int argc, char *argv[])
+{
+	RemminaSFTPTestSampler sampled, stalled;
+	gdouble single, window, capped, sampled_rate, stalled_rate, rate;
+	gint errors = 0;
+
+	memset (&sampled, 0, sizeof (sampled));
+	memset (&stalled, 0, sizeof (stalled));
+	stalled.stall = REMMINA_SFTP_TEST_STALL;
+
+	errors += remmina_sftp_test_download ("single", 1, REMMINA_SFTP_TEST_SIZE, 0, 0, NULL, &single);
+	errors += remmina_sftp_test_download ("window", REMMINA_SFTP_TEST_WINDOW, REMMINA_SFTP_TEST_SIZE, 0, 0,
+			NULL, &window);
+	errors += remmina_sftp_test_download ("capped", REMMINA_SFTP_TEST_WINDOW, REMMINA_SFTP_TEST_SIZE,
+			REMMINA_SFTP_TEST_CAP, 0, NULL, &capped);
+	errors += remmina_sftp_test_download ("capped-single", 1, REMMINA_SFTP_TEST_SIZE / 8,
+			REMMINA_SFTP_TEST_CAP, 0, NULL, &rate);
+	errors += remmina_sftp_test_download ("small-cap", REMMINA_SFTP_TEST_WINDOW, REMMINA_SFTP_TEST_SIZE / 32,
+			REMMINA_SFTP_TEST_SMALL_CAP, 0, NULL, &rate);
+	errors += remmina_sftp_test_download ("resume", REMMINA_SFTP_TEST_WINDOW, REMMINA_SFTP_TEST_SIZE, 0,
+			REMMINA_SFTP_TEST_SIZE / 3, NULL, &rate);
+	errors += remmina_sftp_test_download ("aligned", REMMINA_SFTP_TEST_WINDOW, 64 * REMMINA_SFTP_CHUNK_SIZE, 0, 0,
+			NULL, &rate);
+	errors += remmina_sftp_test_download ("empty", REMMINA_SFTP_TEST_WINDOW, 0, 0, 0, NULL, &rate);
+	errors += remmina_sftp_test_download ("sampled", REMMINA_SFTP_TEST_WINDOW, REMMINA_SFTP_TEST_SIZE, 0, 0,
+			&sampled, &sampled_rate);
+	errors += remmina_sftp_test_download ("stalled", REMMINA_SFTP_TEST_WINDOW, REMMINA_SFTP_TEST_SIZE, 0, 0,
+			&stalled, &stalled_rate);
+	errors += remmina_sftp_test_interrupt ("stopped", 20, 0, REMMINA_SFTP_TRANSFER_STOPPED);
+	errors += remmina_sftp_test_interrupt ("failed", -1, REMMINA_SFTP_TEST_SIZE / 2, REMMINA_SFTP_TRANSFER_READ_ERROR);
+
+	if (window < REMMINA_SFTP_TEST_SPEEDUP * single)
+	{
+		printf ("window: only %.1f times faster than single, WRONG\n", window / single);
+		errors++;
+	}
+	if (capped < REMMINA_SFTP_TEST_SPEEDUP * single)
+	{
+		printf ("capped: only %.1f times faster than single, WRONG\n", capped / single);
+		errors++;
+	}
+
+	if (stalled_rate * 100 < REMMINA_SFTP_TEST_STALLED_RATE * sampled_rate)
+	{
+		printf ("stalled: %.0f%% of the throughput with the sampler running, WRONG\n",
+				stalled_rate * 100 / sampled_rate);
+		errors++;
+	}
+
+	return errors ? 1 : 0;
+}
@@ -69,6 +69,7 @@
 #ifdef HAVE_TERMIOS_H
 #include <termios.h>
 #endif
+#include <poll.h>
 #include "remmina_public.h"
 #include "remmina_log.h"
 #include "remmina_ssh.h"
@@ -536,36 +537,9 @@ remmina_ssh_free (RemminaSSH *ssh)
 }
 
 /*************************** SSH Tunnel *********************************/
-struct _RemminaSSHTunnelBuffer
-{
-	gchar *data;
-	gchar *ptr;
-	ssize_t len;
-};
-
-static RemminaSSHTunnelBuffer*
-remmina_ssh_tunnel_buffer_new (ssize_t len)
-{
-	TRACE_CALL("remmina_ssh_tunnel_buffer_new");
-	RemminaSSHTunnelBuffer *buffer;
-
-	buffer = g_new (RemminaSSHTunnelBuffer, 1);
-	buffer->data = (gchar*) g_malloc (len);
-	buffer->ptr = buffer->data;
-	buffer->len = len;
-	return buffer;
-}
 
-static void
-remmina_ssh_tunnel_buffer_free (RemminaSSHTunnelBuffer *buffer)
-{
-	TRACE_CALL("remmina_ssh_tunnel_buffer_free");
-	if (buffer)
-	{
-		g_free(buffer->data);
-		g_free(buffer);
-	}
-}
+/* Longest sleep of an idle tunnel, in milliseconds, before checking whether it is still running */
+#define REMMINA_SSH_TUNNEL_POLL_TIMEOUT 1000
 
 RemminaSSHTunnel*
 remmina_ssh_tunnel_new_from_file (RemminaFile *remminafile)
@@ -580,9 +554,14 @@ remmina_ssh_tunnel_new_from_file (RemminaFile *remminafile)
 	tunnel->tunnel_type = -1;
 	tunnel->channels = NULL;
 	tunnel->sockets = NULL;
-	tunnel->socketbuffers = NULL;
+	tunnel->socketqueues = NULL;
+	tunnel->socketwatch = NULL;
+	tunnel->socketevents = NULL;
 	tunnel->num_channels = 0;
 	tunnel->max_channels = 0;
+	tunnel->event = NULL;
+	tunnel->event_server_sock = -1;
+	tunnel->accept_ready = FALSE;
 	tunnel->x11_channel = NULL;
 	tunnel->thread = 0;
 	tunnel->running = FALSE;
@@ -591,7 +570,7 @@ remmina_ssh_tunnel_new_from_file (RemminaFile *remminafile)
 	tunnel->port = 0;
 	tunnel->buffer = NULL;
 	tunnel->buffer_len = 0;
-	tunnel->channels_out = NULL;
+	tunnel->buffer_pool = g_queue_new ();
 	tunnel->remotedisplay = 0;
 	tunnel->localdisplay = NULL;
 	tunnel->init_func = NULL;
@@ -610,8 +589,10 @@ remmina_ssh_tunnel_close_all_channels (RemminaSSHTunnel *tunnel)
 
 	for (i = 0; i < tunnel->num_channels; i++)
 	{
+		if (tunnel->event && tunnel->socketwatch[i])
+			ssh_event_remove_fd (tunnel->event, tunnel->sockets[i]);
 		close (tunnel->sockets[i]);
-		remmina_ssh_tunnel_buffer_free (tunnel->socketbuffers[i]);
+		remmina_ssh_tunnel_queue_clear (&tunnel->socketqueues[i], tunnel->buffer_pool);
 		channel_close (tunnel->channels[i]);
 		channel_free (tunnel->channels[i]);
 	}
@@ -620,8 +601,12 @@ remmina_ssh_tunnel_close_all_channels (RemminaSSHTunnel *tunnel)
 	tunnel->channels = NULL;
 	g_free(tunnel->sockets);
 	tunnel->sockets = NULL;
-	g_free(tunnel->socketbuffers);
-	tunnel->socketbuffers = NULL;
+	g_free(tunnel->socketqueues);
+	tunnel->socketqueues = NULL;
+	g_free(tunnel->socketwatch);
+	tunnel->socketwatch = NULL;
+	g_free(tunnel->socketevents);
+	tunnel->socketevents = NULL;
 
 	tunnel->num_channels = 0;
 	tunnel->max_channels = 0;
@@ -640,13 +625,62 @@ remmina_ssh_tunnel_remove_channel (RemminaSSHTunnel *tunnel, gint n)
 	TRACE_CALL("remmina_ssh_tunnel_remove_channel");
 	channel_close (tunnel->channels[n]);
 	channel_free (tunnel->channels[n]);
+	if (tunnel->event && tunnel->socketwatch[n])
+		ssh_event_remove_fd (tunnel->event, tunnel->sockets[n]);
 	close (tunnel->sockets[n]);
-	remmina_ssh_tunnel_buffer_free (tunnel->socketbuffers[n]);
+	remmina_ssh_tunnel_queue_clear (&tunnel->socketqueues[n], tunnel->buffer_pool);
 	tunnel->num_channels--;
 	tunnel->channels[n] = tunnel->channels[tunnel->num_channels];
 	tunnel->channels[tunnel->num_channels] = NULL;
 	tunnel->sockets[n] = tunnel->sockets[tunnel->num_channels];
-	tunnel->socketbuffers[n] = tunnel->socketbuffers[tunnel->num_channels];
+	tunnel->socketqueues[n] = tunnel->socketqueues[tunnel->num_channels];
+	tunnel->socketwatch[n] = tunnel->socketwatch[tunnel->num_channels];
+	tunnel->socketevents[n] = tunnel->socketevents[tunnel->num_channels];
+}
+
+/* Records what poll reported on a local socket, the main loop acts on it after ssh_event_dopoll returns */
+static int
+remmina_ssh_tunnel_socket_cb (socket_t fd, int revents, void *userdata)
+{
+	TRACE_CALL("remmina_ssh_tunnel_socket_cb");
+	RemminaSSHTunnel *tunnel = (RemminaSSHTunnel*) userdata;
+	gint i;
+
+	for (i = 0; i < tunnel->num_channels; i++)
+	{
+		if (tunnel->sockets[i] == fd)
+		{
+			tunnel->socketevents[i] |= revents;
+			break;
+		}
+	}
+	return 0;
+}
+
+static int
+remmina_ssh_tunnel_server_cb (socket_t fd, int revents, void *userdata)
+{
+	TRACE_CALL("remmina_ssh_tunnel_server_cb");
+	RemminaSSHTunnel *tunnel = (RemminaSSHTunnel*) userdata;
+
+	tunnel->accept_ready = TRUE;
+	return 0;
+}
+
+/* Sets the poll events watched on the local socket of channel n, 0 stops watching it */
+static void
+remmina_ssh_tunnel_watch_socket (RemminaSSHTunnel *tunnel, gint n, gshort events)
+{
+	TRACE_CALL("remmina_ssh_tunnel_watch_socket");
+
+	if (!tunnel->event || tunnel->socketwatch[n] == events)
+		return;
+
+	if (tunnel->socketwatch[n])
+		ssh_event_remove_fd (tunnel->event, tunnel->sockets[n]);
+	if (events)
+		ssh_event_add_fd (tunnel->event, tunnel->sockets[n], events, remmina_ssh_tunnel_socket_cb, tunnel);
+	tunnel->socketwatch[n] = events;
 }
 
 /* Register the new channel/socket pair */
@@ -660,25 +694,82 @@ remmina_ssh_tunnel_add_channel (RemminaSSHTunnel *tunnel, ssh_channel channel, g
 	i = tunnel->num_channels++;
 	if (tunnel->num_channels > tunnel->max_channels)
 	{
-		/* Allocate an extra NULL pointer in channels for ssh_select */
+		/* Keep channels NULL terminated */
 		tunnel->channels = (ssh_channel*) g_realloc (tunnel->channels,
 				sizeof (ssh_channel) * (tunnel->num_channels + 1));
 		tunnel->sockets = (gint*) g_realloc (tunnel->sockets,
 				sizeof (gint) * tunnel->num_channels);
-		tunnel->socketbuffers = (RemminaSSHTunnelBuffer**) g_realloc (tunnel->socketbuffers,
-				sizeof (RemminaSSHTunnelBuffer*) * tunnel->num_channels);
+		tunnel->socketqueues = (RemminaSSHTunnelQueue*) g_realloc (tunnel->socketqueues,
+				sizeof (RemminaSSHTunnelQueue) * tunnel->num_channels);
+		tunnel->socketwatch = (gshort*) g_realloc (tunnel->socketwatch,
+				sizeof (gshort) * tunnel->num_channels);
+		tunnel->socketevents = (gshort*) g_realloc (tunnel->socketevents,
+				sizeof (gshort) * tunnel->num_channels);
 		tunnel->max_channels = tunnel->num_channels;
-
-		tunnel->channels_out = (ssh_channel*) g_realloc (tunnel->channels_out,
-				sizeof (ssh_channel) * (tunnel->num_channels + 1));
 	}
 	tunnel->channels[i] = channel;
 	tunnel->channels[i + 1] = NULL;
 	tunnel->sockets[i] = sock;
-	tunnel->socketbuffers[i] = NULL;
+	remmina_ssh_tunnel_queue_init (&tunnel->socketqueues[i]);
+	tunnel->socketwatch[i] = 0;
+	tunnel->socketevents[i] = 0;
 
 	flags = fcntl (sock, F_GETFL, 0);
 	fcntl (sock, F_SETFL, flags | O_NONBLOCK);
+
+	remmina_ssh_tunnel_watch_socket (tunnel, i, POLLIN);
+}
+
+/* Accept a local connection and ask the SSH server to connect it to the destination */
+static gboolean
+remmina_ssh_tunnel_accept_local (RemminaSSHTunnel *tunnel)
+{
+	TRACE_CALL("remmina_ssh_tunnel_accept_local");
+	ssh_channel channel;
+	gint sock;
+
+	sock = accept (tunnel->server_sock, NULL, NULL);
+	if (sock < 0)
+	{
+		REMMINA_SSH (tunnel)->error = g_strdup ("Failed to accept local socket");
+		return FALSE;
+	}
+
+	if ((channel = channel_new (tunnel->ssh.session)) == NULL)
+	{
+		close (sock);
+		remmina_ssh_set_error (REMMINA_SSH (tunnel), "Failed to createt channel : %s");
+		return FALSE;
+	}
+	/* Request the SSH server to connect to the destination */
+	if (channel_open_forward (channel, tunnel->dest, tunnel->port, "127.0.0.1", 0) != SSH_OK)
+	{
+		close (sock);
+		channel_close (channel);
+		channel_free (channel);
+		remmina_ssh_set_error (REMMINA_SSH (tunnel), _("Failed to connect to the SSH tunnel destination: %s"));
+		return FALSE;
+	}
+	remmina_ssh_tunnel_add_channel (tunnel, channel, sock);
+	return TRUE;
+}
+
+static void
+remmina_ssh_tunnel_stop_event (RemminaSSHTunnel *tunnel)
+{
+	TRACE_CALL("remmina_ssh_tunnel_stop_event");
+
+	if (!tunnel->event)
+		return;
+
+	if (tunnel->event_server_sock >= 0)
+	{
+		ssh_event_remove_fd (tunnel->event, tunnel->event_server_sock);
+		tunnel->event_server_sock = -1;
+	}
+	ssh_event_remove_session (tunnel->event, REMMINA_SSH (tunnel)->session);
+	ssh_event_free (tunnel->event);
+	tunnel->event = NULL;
 }
 
 static gpointer
@@ -688,52 +779,27 @@ remmina_ssh_tunnel_main_thread_proc (gpointer data)
 	RemminaSSHTunnel *tunnel = (RemminaSSHTunnel*) data;
 	gchar *ptr;
 	ssize_t len = 0, lenw = 0;
-	fd_set set;
-	struct timeval timeout;
-	GTimeVal t1, t2;
-	glong diff;
+	guint32 window;
+	RemminaSSHTunnelBuffer *buffer;
+	gsize room;
 	ssh_channel channel = NULL;
 	gboolean first = TRUE;
 	gboolean disconnected;
 	gint sock;
-	gint maxfd;
+	gint timeout;
 	gint i;
 	gint ret;
 	struct sockaddr_in sin;
 
-	g_get_current_time (&t1);
-	t2 = t1;
-
 	switch (tunnel->tunnel_type)
 	{
 		case REMMINA_SSH_TUNNEL_OPEN:
-		/* Accept a local connection */
-		sock = accept (tunnel->server_sock, NULL, NULL);
-		if (sock < 0)
-		{
-			REMMINA_SSH (tunnel)->error = g_strdup ("Failed to accept local socket");
-			tunnel->thread = 0;
-			return NULL;
-		}
-
-		if ((channel = channel_new (tunnel->ssh.session)) == NULL)
-		{
-			close (sock);
-			remmina_ssh_set_error (REMMINA_SSH (tunnel), "Failed to createt channel : %s");
-			tunnel->thread = 0;
-			return NULL;
-		}
-		/* Request the SSH server to connect to the destination */
-		if (channel_open_forward (channel, tunnel->dest, tunnel->port, "127.0.0.1", 0) != SSH_OK)
+		/* Wait for the first local connection */
+		if (!remmina_ssh_tunnel_accept_local (tunnel))
 		{
-			close (sock);
-			channel_close (channel);
-			channel_free (channel);
-			remmina_ssh_set_error (REMMINA_SSH (tunnel), _("Failed to connect to the SSH tunnel destination: %s"));
 			tunnel->thread = 0;
 			return NULL;
 		}
-		remmina_ssh_tunnel_add_channel (tunnel, channel, sock);
 		break;
 
 		case REMMINA_SSH_TUNNEL_X11:
@@ -850,6 +916,20 @@ remmina_ssh_tunnel_main_thread_proc (gpointer data)
 	tunnel->buffer_len = 10240;
 	tunnel->buffer = g_malloc (tunnel->buffer_len);
 
+	/* One event loop for the session and every local socket of the tunnel */
+	tunnel->event = ssh_event_new ();
+	ssh_event_add_session (tunnel->event, REMMINA_SSH (tunnel)->session);
+	for (i = 0; i < tunnel->num_channels; i++)
+	{
+		remmina_ssh_tunnel_watch_socket (tunnel, i, POLLIN);
+	}
+	if (tunnel->tunnel_type == REMMINA_SSH_TUNNEL_OPEN && tunnel->server_sock >= 0)
+	{
+		tunnel->event_server_sock = tunnel->server_sock;
+		tunnel->accept_ready = FALSE;
+		ssh_event_add_fd (tunnel->event, tunnel->event_server_sock, POLLIN, remmina_ssh_tunnel_server_cb, tunnel);
+	}
+
 	/* Start the tunnel data transmittion */
 	while (tunnel->running)
 	{
@@ -876,6 +956,7 @@ remmina_ssh_tunnel_main_thread_proc (gpointer data)
 					{
 						(*tunnel->disconnect_func) (tunnel, tunnel->callback_data);
 					}
+					remmina_ssh_tunnel_stop_event (tunnel);
 					tunnel->thread = 0;
 					return NULL;
 				}
@@ -891,28 +972,19 @@ remmina_ssh_tunnel_main_thread_proc (gpointer data)
 			}
 			else if (tunnel->tunnel_type != REMMINA_SSH_TUNNEL_REVERSE)
 			{
-				/* Poll once per some period of time if no incoming connections.
-				 * Don't try to poll continuously as it will significantly slow down the loop */
-				g_get_current_time (&t1);
-				diff = (t1.tv_sec - t2.tv_sec) * 10 + (t1.tv_usec - t2.tv_usec) / 100000;
-				if (diff > 1)
+				/* The open requests received by the last poll are already queued in the session,
+				 * so checking without a timeout picks them up right away */
+				if (tunnel->tunnel_type == REMMINA_SSH_TUNNEL_X11)
 				{
-					if (tunnel->tunnel_type == REMMINA_SSH_TUNNEL_X11)
-					{
-						channel = channel_accept_x11 (tunnel->x11_channel, 0);
-					}
-					else
-					{
-						channel = channel_forward_accept (REMMINA_SSH (tunnel)->session, 0);
-					}
-					if (channel == NULL)
-					{
-						t2 = t1;
-					}
+					channel = channel_accept_x11 (tunnel->x11_channel, 0);
+				}
+				else
+				{
+					channel = channel_forward_accept (REMMINA_SSH (tunnel)->session, 0);
 				}
 			}
 
-			if (channel)
+			while (channel)
 			{
 				if (tunnel->tunnel_type == REMMINA_SSH_TUNNEL_REVERSE)
 				{
@@ -943,8 +1015,24 @@ remmina_ssh_tunnel_main_thread_proc (gpointer data)
 					channel_free (channel);
 				}
 				channel = NULL;
+
+				/* Several connections may have arrived together */
+				if (tunnel->tunnel_type == REMMINA_SSH_TUNNEL_X11)
+				{
+					channel = channel_accept_x11 (tunnel->x11_channel, 0);
+				}
+				else if (tunnel->tunnel_type == REMMINA_SSH_TUNNEL_XPORT)
+				{
+					channel = channel_forward_accept (REMMINA_SSH (tunnel)->session, 0);
+				}
 			}
 		}
+		else if (tunnel->accept_ready)
+		{
+			/* Another local client of a forwarded port, served together with the others */
+			tunnel->accept_ready = FALSE;
+			remmina_ssh_tunnel_accept_local (tunnel);
+		}
 
 		if (tunnel->num_channels <= 0)
 		{
@@ -952,33 +1040,42 @@ remmina_ssh_tunnel_main_thread_proc (gpointer data)
 			break;
 		}
 
-		timeout.tv_sec = 0;
-		timeout.tv_usec = 200000;
-
-		FD_ZERO (&set);
-		maxfd = 0;
+		/* Do not sleep when data is already waiting in a channel, the session socket
+		 * may have been read while handling the previous events. A closed channel
+		 * reports SSH_EOF, which is handled by the read loop and must not spin here */
+		timeout = REMMINA_SSH_TUNNEL_POLL_TIMEOUT;
 		for (i = 0; i < tunnel->num_channels; i++)
 		{
-			if (tunnel->sockets[i] > maxfd)
+			if (!tunnel->socketqueues[i].paused && channel_poll (tunnel->channels[i], 0) > 0)
 			{
-				maxfd = tunnel->sockets[i];
+				timeout = 0;
+				break;
 			}
-			FD_SET (tunnel->sockets[i], &set);
 		}
 
-		ret = ssh_select (tunnel->channels, tunnel->channels_out, maxfd + 1, &set, &timeout);
+		ret = ssh_event_dopoll (tunnel->event, timeout);
 		if (!tunnel->running) break;
-		if (ret == SSH_EINTR) continue;
-		if (ret == -1) break;
+		if (ret == SSH_ERROR && errno != EINTR) break;
+
+		if (tunnel->event_server_sock >= 0 && tunnel->server_sock != tunnel->event_server_sock)
+		{
+			/* The listening socket was closed by remmina_ssh_tunnel_cancel_accept () */
+			ssh_event_remove_fd (tunnel->event, tunnel->event_server_sock);
+			tunnel->event_server_sock = -1;
+			tunnel->accept_ready = FALSE;
+		}
 
 		i = 0;
 		while (tunnel->running && i < tunnel->num_channels)
 		{
 			disconnected = FALSE;
-			if (FD_ISSET (tunnel->sockets[i], &set))
+			if (tunnel->socketevents[i] & (POLLIN | POLLHUP | POLLERR))
 			{
-				while (!disconnected &&
-						(len = read (tunnel->sockets[i], tunnel->buffer, tunnel->buffer_len)) > 0)
+				/* Never read more than the server accepts, a full window leaves the rest
+				 * in the socket and lets TCP slow down the local sender */
+				len = -1;
+				while (!disconnected && (window = ssh_channel_window_size (tunnel->channels[i])) > 0 &&
+						(len = read (tunnel->sockets[i], tunnel->buffer, MIN ((guint32) tunnel->buffer_len, window))) > 0)
 				{
 					for (ptr = tunnel->buffer, lenw = 0; len > 0; len -= lenw, ptr += lenw)
 					{
@@ -992,6 +1089,7 @@ remmina_ssh_tunnel_main_thread_proc (gpointer data)
 				}
 				if (len == 0) disconnected = TRUE;
 			}
+			tunnel->socketevents[i] &= ~(POLLIN | POLLHUP | POLLERR);
 			if (disconnected)
 			{
 				remmina_ssh_tunnel_remove_channel (tunnel, i);
@@ -1005,53 +1103,36 @@ remmina_ssh_tunnel_main_thread_proc (gpointer data)
 		while (tunnel->running && i < tunnel->num_channels)
 		{
 			disconnected = FALSE;
+			tunnel->socketevents[i] = 0;
 
-			if (!tunnel->socketbuffers[i])
+			if (!remmina_ssh_tunnel_queue_flush (&tunnel->socketqueues[i], tunnel->buffer_pool, tunnel->sockets[i]))
+			{
+				disconnected = TRUE;
+			}
+			while (!disconnected && (room = remmina_ssh_tunnel_queue_room (&tunnel->socketqueues[i])) > 0)
 			{
 				len = channel_poll (tunnel->channels[i], 0);
-				if (len == SSH_ERROR || len == SSH_EOF)
+				if (len == SSH_ERROR || (len == SSH_EOF && tunnel->socketqueues[i].queued == 0))
 				{
 					disconnected = TRUE;
+					break;
 				}
-				else if (len > 0)
+				if (len <= 0) break;
+
+				buffer = remmina_ssh_tunnel_buffer_new (tunnel->buffer_pool);
+				len = channel_read_nonblocking (tunnel->channels[i], buffer->data, MIN ((gsize) len, room), 0);
+				if (len <= 0)
 				{
-					tunnel->socketbuffers[i] = remmina_ssh_tunnel_buffer_new (len);
-					len = channel_read_nonblocking (tunnel->channels[i], tunnel->socketbuffers[i]->data, len, 0);
-					if (len <= 0)
-					{
-						disconnected = TRUE;
-					}
-					else
-					{
-						tunnel->socketbuffers[i]->len = len;
-					}
+					remmina_ssh_tunnel_buffer_free (tunnel->buffer_pool, buffer);
+					disconnected = TRUE;
+					break;
 				}
+				remmina_ssh_tunnel_queue_push (&tunnel->socketqueues[i], buffer, len);
 			}
 
-			if (!disconnected && tunnel->socketbuffers[i])
+			if (!disconnected && !remmina_ssh_tunnel_queue_flush (&tunnel->socketqueues[i], tunnel->buffer_pool, tunnel->sockets[i]))
 			{
-				for (lenw = 0; tunnel->socketbuffers[i]->len > 0;
-						tunnel->socketbuffers[i]->len -= lenw, tunnel->socketbuffers[i]->ptr += lenw)
-				{
-					lenw = write (tunnel->sockets[i], tunnel->socketbuffers[i]->ptr, tunnel->socketbuffers[i]->len);
-					if (lenw == -1 && errno == EAGAIN && tunnel->running)
-					{
-						/* Sometimes we cannot write to a socket (always EAGAIN), probably because it's internal
-						 * buffer is full. We need read the pending bytes from the socket first. so here we simply
-						 * break, leave the buffer there, and continue with other data */
-						break;
-					}
-					if (lenw <= 0)
-					{
-						disconnected = TRUE;
-						break;
-					}
-				}
-				if (tunnel->socketbuffers[i]->len <= 0)
-				{
-					remmina_ssh_tunnel_buffer_free (tunnel->socketbuffers[i]);
-					tunnel->socketbuffers[i] = NULL;
-				}
+				disconnected = TRUE;
 			}
 
 			if (disconnected)
@@ -1059,11 +1140,16 @@ remmina_ssh_tunnel_main_thread_proc (gpointer data)
 				remmina_ssh_tunnel_remove_channel (tunnel, i);
 				continue;
 			}
+			/* Only watch the directions which can make progress, so a full side does not spin the loop */
+			remmina_ssh_tunnel_watch_socket (tunnel, i,
+					(ssh_channel_window_size (tunnel->channels[i]) > 0 ? POLLIN : 0) |
+					(tunnel->socketqueues[i].queued > 0 ? POLLOUT : 0));
 			i++;
 		}
 	}
 
 	remmina_ssh_tunnel_close_all_channels (tunnel);
+	remmina_ssh_tunnel_stop_event (tunnel);
 
 	return NULL;
 }
@@ -1216,6 +1302,7 @@ remmina_ssh_tunnel_free (RemminaSSHTunnel* tunnel)
 {
 	TRACE_CALL("remmina_ssh_tunnel_free");
 	pthread_t thread;
+	gpointer buffer;
 
 	thread = tunnel->thread;
 	if (thread != 0)
@@ -1237,9 +1324,10 @@ remmina_ssh_tunnel_free (RemminaSSHTunnel* tunnel)
 		tunnel->server_sock = -1;
 	}
 	remmina_ssh_tunnel_close_all_channels (tunnel);
+	remmina_ssh_tunnel_stop_event (tunnel);
 
 	g_free(tunnel->buffer);
-	g_free(tunnel->channels_out);
+	remmina_ssh_tunnel_pool_free (tunnel->buffer_pool);
 	g_free(tunnel->dest);
 	g_free(tunnel->localdisplay);
 
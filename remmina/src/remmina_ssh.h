@@ -46,6 +46,7 @@
 #include <pthread.h>
 #include "remmina_file.h"
 #include "remmina_init_dialog.h"
+#include "remmina_ssh_queue.h"
 
 G_BEGIN_DECLS
 
@@ -103,7 +104,6 @@ void remmina_ssh_free (RemminaSSH *ssh);
 
 /* ------------------- SSH Tunnel ---------------------- */
 typedef struct _RemminaSSHTunnel RemminaSSHTunnel;
-typedef struct _RemminaSSHTunnelBuffer RemminaSSHTunnelBuffer;
 
 typedef gboolean (*RemminaSSHTunnelCallback) (RemminaSSHTunnel*, gpointer);
 
@@ -123,10 +123,16 @@ struct _RemminaSSHTunnel
 
 	ssh_channel *channels;
 	gint *sockets;
-	RemminaSSHTunnelBuffer **socketbuffers;
+	RemminaSSHTunnelQueue *socketqueues;
+	gshort *socketwatch;
+	gshort *socketevents;
 	gint num_channels;
 	gint max_channels;
 
+	ssh_event event;
+	gint event_server_sock;
+	gboolean accept_ready;
+
 	ssh_channel x11_channel;
 
 	pthread_t thread;
@@ -134,7 +140,7 @@ struct _RemminaSSHTunnel
 
 	gchar *buffer;
 	gint buffer_len;
-	ssh_channel *channels_out;
+	GQueue *buffer_pool;
 
 	gint server_sock;
 	gchar *dest;
@@ -0,0 +1,169 @@
+/*
+ * Remmina - The GTK+ Remote Desktop Client
+ * Copyright (C) 2009 - Vic Lee 
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, 
+ * Boston, MA  02110-1301, USA.
+ *
+ *  In addition, as a special exception, the copyright holders give
+ *  permission to link the code of portions of this program with the
+ *  OpenSSL library under certain conditions as described in each
+ *  individual source file, and distribute linked combinations
+ *  including the two.
+ *  You must obey the GNU General Public License in all respects
+ *  for all of the code used other than OpenSSL. *  If you modify
+ *  file(s) with this exception, you may extend this exception to your
+ *  version of the file(s), but you are not obligated to do so. *  If you
+ *  do not wish to do so, delete this exception statement from your
+ *  version. *  If you delete this exception statement from all source
+ *  files in the program, then also delete it here.
+ *
+ */
+
+#include <glib.h>
+#include <unistd.h>
+#include <errno.h>
+#include "remmina_ssh_queue.h"
+#include "remmina/remmina_trace_calls.h"
+
+RemminaSSHTunnelBuffer*
+remmina_ssh_tunnel_buffer_new (GQueue *pool)
+{
+	TRACE_CALL("remmina_ssh_tunnel_buffer_new");
+	RemminaSSHTunnelBuffer *buffer;
+
+	buffer = (RemminaSSHTunnelBuffer*) g_queue_pop_head (pool);
+	if (!buffer)
+	{
+		buffer = g_new (RemminaSSHTunnelBuffer, 1);
+	}
+	buffer->ptr = buffer->data;
+	buffer->len = 0;
+	return buffer;
+}
+
+void
+remmina_ssh_tunnel_buffer_free (GQueue *pool, RemminaSSHTunnelBuffer *buffer)
+{
+	TRACE_CALL("remmina_ssh_tunnel_buffer_free");
+	if (g_queue_get_length (pool) < REMMINA_SSH_TUNNEL_POOL_MAX)
+	{
+		g_queue_push_head (pool, buffer);
+	}
+	else
+	{
+		g_free(buffer);
+	}
+}
+
+void
+remmina_ssh_tunnel_pool_free (GQueue *pool)
+{
+	TRACE_CALL("remmina_ssh_tunnel_pool_free");
+	RemminaSSHTunnelBuffer *buffer;
+
+	while ((buffer = (RemminaSSHTunnelBuffer*) g_queue_pop_head (pool)) != NULL)
+	{
+		g_free(buffer);
+	}
+	g_queue_free (pool);
+}
+
+void
+remmina_ssh_tunnel_queue_init (RemminaSSHTunnelQueue *queue)
+{
+	TRACE_CALL("remmina_ssh_tunnel_queue_init");
+	queue->buffers = g_queue_new ();
+	queue->queued = 0;
+	queue->paused = FALSE;
+}
+
+gsize
+remmina_ssh_tunnel_queue_room (RemminaSSHTunnelQueue *queue)
+{
+	TRACE_CALL("remmina_ssh_tunnel_queue_room");
+	if (queue->paused && queue->queued <= REMMINA_SSH_TUNNEL_LOW_WATERMARK)
+	{
+		queue->paused = FALSE;
+	}
+	if (queue->paused)
+	{
+		return 0;
+	}
+	/* Stop exactly at the high watermark, a full buffer read into an almost full queue overshoots it */
+	return MIN (REMMINA_SSH_TUNNEL_BUFFER_SIZE, REMMINA_SSH_TUNNEL_HIGH_WATERMARK - queue->queued);
+}
+
+void
+remmina_ssh_tunnel_queue_push (RemminaSSHTunnelQueue *queue, RemminaSSHTunnelBuffer *buffer, ssize_t len)
+{
+	TRACE_CALL("remmina_ssh_tunnel_queue_push");
+	buffer->len = len;
+	g_queue_push_tail (queue->buffers, buffer);
+	queue->queued += len;
+
+	if (queue->queued >= REMMINA_SSH_TUNNEL_HIGH_WATERMARK)
+	{
+		queue->paused = TRUE;
+	}
+}
+
+gboolean
+remmina_ssh_tunnel_queue_flush (RemminaSSHTunnelQueue *queue, GQueue *pool, gint sock)
+{
+	TRACE_CALL("remmina_ssh_tunnel_queue_flush");
+	RemminaSSHTunnelBuffer *buffer;
+	ssize_t lenw;
+
+	while ((buffer = (RemminaSSHTunnelBuffer*) g_queue_peek_head (queue->buffers)) != NULL)
+	{
+		lenw = write (sock, buffer->ptr, buffer->len);
+		if (lenw == -1 && errno == EAGAIN)
+		{
+			/* The socket buffer is full: retry as soon as poll reports the socket writable */
+			break;
+		}
+		if (lenw <= 0)
+		{
+			return FALSE;
+		}
+		buffer->ptr += lenw;
+		buffer->len -= lenw;
+		queue->queued -= lenw;
+		if (buffer->len <= 0)
+		{
+			g_queue_pop_head (queue->buffers);
+			remmina_ssh_tunnel_buffer_free (pool, buffer);
+		}
+	}
+	return TRUE;
+}
+
+/* Give back to the pool all the data still queued */
+void
+remmina_ssh_tunnel_queue_clear (RemminaSSHTunnelQueue *queue, GQueue *pool)
+{
+	TRACE_CALL("remmina_ssh_tunnel_queue_clear");
+	RemminaSSHTunnelBuffer *buffer;
+
+	while ((buffer = (RemminaSSHTunnelBuffer*) g_queue_pop_head (queue->buffers)) != NULL)
+	{
+		remmina_ssh_tunnel_buffer_free (pool, buffer);
+	}
+	g_queue_free (queue->buffers);
+	queue->buffers = NULL;
+	queue->queued = 0;
+	queue->paused = FALSE;
+}
@@ -0,0 +1,77 @@
+/*
+ * Remmina - The GTK+ Remote Desktop Client
+ * Copyright (C) 2009 - Vic Lee 
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, 
+ * Boston, MA  02110-1301, USA.
+ *
+ *  In addition, as a special exception, the copyright holders give
+ *  permission to link the code of portions of this program with the
+ *  OpenSSL library under certain conditions as described in each
+ *  individual source file, and distribute linked combinations
+ *  including the two.
+ *  You must obey the GNU General Public License in all respects
+ *  for all of the code used other than OpenSSL. *  If you modify
+ *  file(s) with this exception, you may extend this exception to your
+ *  version of the file(s), but you are not obligated to do so. *  If you
+ *  do not wish to do so, delete this exception statement from your
+ *  version. *  If you delete this exception statement from all source
+ *  files in the program, then also delete it here.
+ *
+ */
+
+#ifndef __REMMINASSHQUEUE_H__
+#define __REMMINASSHQUEUE_H__
+
+G_BEGIN_DECLS
+
+/* Data read from a channel and not yet written to its local socket is kept in a queue of
+ * fixed size buffers. Reading from the channel stops at the high watermark and resumes at the
+ * low one, so a slow local reader makes the SSH window close instead of growing the queue */
+#define REMMINA_SSH_TUNNEL_BUFFER_SIZE 16384
+#define REMMINA_SSH_TUNNEL_HIGH_WATERMARK (16 * REMMINA_SSH_TUNNEL_BUFFER_SIZE)
+#define REMMINA_SSH_TUNNEL_LOW_WATERMARK (4 * REMMINA_SSH_TUNNEL_BUFFER_SIZE)
+/* Most spare buffers kept around for reuse by a tunnel */
+#define REMMINA_SSH_TUNNEL_POOL_MAX 64
+
+typedef struct _RemminaSSHTunnelBuffer
+{
+	gchar *ptr;
+	ssize_t len;
+	gchar data[REMMINA_SSH_TUNNEL_BUFFER_SIZE];
+} RemminaSSHTunnelBuffer;
+
+typedef struct _RemminaSSHTunnelQueue
+{
+	GQueue *buffers;
+	gsize queued;
+	gboolean paused;
+} RemminaSSHTunnelQueue;
+
+RemminaSSHTunnelBuffer* remmina_ssh_tunnel_buffer_new (GQueue *pool);
+void remmina_ssh_tunnel_buffer_free (GQueue *pool, RemminaSSHTunnelBuffer *buffer);
+void remmina_ssh_tunnel_pool_free (GQueue *pool);
+
+void remmina_ssh_tunnel_queue_init (RemminaSSHTunnelQueue *queue);
+/* Bytes which may be read into the next buffer, 0 while the queue is paused */
+gsize remmina_ssh_tunnel_queue_room (RemminaSSHTunnelQueue *queue);
+void remmina_ssh_tunnel_queue_push (RemminaSSHTunnelQueue *queue, RemminaSSHTunnelBuffer *buffer, ssize_t len);
+/* Write as much queued data as sock takes. Returns FALSE when the socket is gone */
+gboolean remmina_ssh_tunnel_queue_flush (RemminaSSHTunnelQueue *queue, GQueue *pool, gint sock);
+void remmina_ssh_tunnel_queue_clear (RemminaSSHTunnelQueue *queue, GQueue *pool);
+
+G_END_DECLS
+
+#endif  /* __REMMINASSHQUEUE_H__  */
@@ -0,0 +1,235 @@
+/*
+ * Remmina - The GTK+ Remote Desktop Client
+ * Copyright (C) 2009 - Vic Lee 
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, 
+ * Boston, MA  02110-1301, USA.
+ *
+ *  In addition, as a special exception, the copyright holders give
+ *  permission to link the code of portions of this program with the
+ *  OpenSSL library under certain conditions as described in each
+ *  individual source file, and distribute linked combinations
+ *  including the two.
+ *  You must obey the GNU General Public License in all respects
+ *  for all of the code used other than OpenSSL. *  If you modify
+ *  file(s) with this exception, you may extend this exception to your
+ *  version of the file(s), but you are not obligated to do so. *  If you
+ *  do not wish to do so, delete this exception statement from your
+ *  version. *  If you delete this exception statement from all source
+ *  files in the program, then also delete it here.
+ *
+ */
+
+/* Streams data through a tunnel queue into a socket whose reader is slow, the
+ * way remmina_ssh_tunnel_main_thread_proc() moves channel data to a local
+ * socket, from a source which always has more to give like a fast SSH server.
+ * Checks that the data arrives intact, that the queued bytes never go past the
+ * high watermark, that the buffer pool stays bounded and, where /proc tells,
+ * that the peak RSS does not grow with the amount of data streamed. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <glib.h>
+#include "remmina_ssh_queue.h"
+
+#define REMMINA_SSH_QUEUE_TEST_TOTAL (64 * 1024 * 1024)
+/* channel_poll () reports everything in the window, often more than a buffer */
+#define REMMINA_SSH_QUEUE_TEST_POLL_MAX (3 * REMMINA_SSH_TUNNEL_BUFFER_SIZE)
+#define REMMINA_SSH_QUEUE_TEST_READ 4096
+/* The reader sleeps this long every so many reads */
+#define REMMINA_SSH_QUEUE_TEST_READER_SLEEP 1000
+#define REMMINA_SSH_QUEUE_TEST_READER_PERIOD 16
+/* Most the peak RSS may grow while streaming, in kB */
+#define REMMINA_SSH_QUEUE_TEST_RSS_MAX 8192
+
+static gint reader_errors;
+
+static guchar
+remmina_ssh_queue_test_byte (gsize offset)
+{
+	return (guchar) (offset % 251);
+}
+
+/* Peak resident set size in kB, -1 when unknown */
+static glong
+remmina_ssh_queue_test_peak_rss (void)
+{
+	FILE *fp;
+	gchar line[256];
+	glong kb = -1;
+
+	fp = fopen ("/proc/self/status", "r");
+	if (!fp) return -1;
+	while (fgets (line, sizeof (line), fp))
+	{
+		if (sscanf (line, "VmHWM: %ld", &kb) == 1) break;
+	}
+	fclose (fp);
+	return kb;
+}
+
+static gpointer
+remmina_ssh_queue_test_reader (gpointer data)
+{
+	gint sock = GPOINTER_TO_INT (data);
+	guchar buf[REMMINA_SSH_QUEUE_TEST_READ];
+	gsize offset = 0;
+	ssize_t len, j;
+	gint reads = 0;
+
+	while ((len = read (sock, buf, sizeof (buf))) > 0)
+	{
+		for (j = 0; j < len; j++)
+		{
+			if (buf[j] != remmina_ssh_queue_test_byte (offset + j))
+			{
+				printf ("reader: wrong byte at %" G_GSIZE_FORMAT ", WRONG\n", offset + j);
+				reader_errors++;
+				return NULL;
+			}
+		}
+		offset += len;
+		if (++reads % REMMINA_SSH_QUEUE_TEST_READER_PERIOD == 0)
+			g_usleep (REMMINA_SSH_QUEUE_TEST_READER_SLEEP);
+	}
+	if (offset != REMMINA_SSH_QUEUE_TEST_TOTAL)
+	{
+		printf ("reader: got %" G_GSIZE_FORMAT " bytes of %d, WRONG\n", offset, REMMINA_SSH_QUEUE_TEST_TOTAL);
+		reader_errors++;
+	}
+	return NULL;
+}
+
+int main (int argc, char *argv[])
+{
+	RemminaSSHTunnelQueue queue;
+	RemminaSSHTunnelBuffer *buffer;
+	GQueue *pool;
+	GThread *thread;
+	struct pollfd pfd;
+	gint socks[2];
+	gint sndbuf = 8192;
+	gsize sent = 0, room, avail, max_queued = 0, j;
+	guint max_buffers = 0, max_pool = 0, pauses = 0;
+	glong rss_start, rss_end;
+	gint64 start, elapsed;
+	gint errors = 0;
+
+	if (socketpair (AF_UNIX, SOCK_STREAM, 0, socks) < 0)
+	{
+		perror ("socketpair");
+		return 1;
+	}
+	setsockopt (socks[0], SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof (sndbuf));
+	fcntl (socks[0], F_SETFL, fcntl (socks[0], F_GETFL, 0) | O_NONBLOCK);
+
+	pool = g_queue_new ();
+	remmina_ssh_tunnel_queue_init (&queue);
+	rss_start = remmina_ssh_queue_test_peak_rss ();
+	g_random_set_seed (1);
+
+	thread = g_thread_new ("reader", remmina_ssh_queue_test_reader, GINT_TO_POINTER (socks[1]));
+	start = g_get_monotonic_time ();
+
+	/* Same steps as the channel to socket half of the tunnel loop */
+	while (sent < REMMINA_SSH_QUEUE_TEST_TOTAL || queue.queued > 0)
+	{
+		if (!remmina_ssh_tunnel_queue_flush (&queue, pool, socks[0]))
+		{
+			printf ("flush: socket gone, WRONG\n");
+			errors++;
+			break;
+		}
+		while (sent < REMMINA_SSH_QUEUE_TEST_TOTAL && (room = remmina_ssh_tunnel_queue_room (&queue)) > 0)
+		{
+			avail = g_random_int_range (1, REMMINA_SSH_QUEUE_TEST_POLL_MAX + 1);
+			avail = MIN (avail, REMMINA_SSH_QUEUE_TEST_TOTAL - sent);
+			avail = MIN (avail, room);
+			buffer = remmina_ssh_tunnel_buffer_new (pool);
+			for (j = 0; j < avail; j++)
+				buffer->data[j] = remmina_ssh_queue_test_byte (sent + j);
+			remmina_ssh_tunnel_queue_push (&queue, buffer, avail);
+			sent += avail;
+			if (queue.paused) pauses++;
+
+			max_queued = MAX (max_queued, queue.queued);
+			max_buffers = MAX (max_buffers, g_queue_get_length (queue.buffers));
+			if (queue.queued > REMMINA_SSH_TUNNEL_HIGH_WATERMARK)
+			{
+				printf ("queue: %" G_GSIZE_FORMAT " bytes queued past the high watermark, WRONG\n", queue.queued);
+				errors++;
+				break;
+			}
+		}
+		if (errors) break;
+		max_pool = MAX (max_pool, g_queue_get_length (pool));
+
+		if (!remmina_ssh_tunnel_queue_flush (&queue, pool, socks[0]))
+		{
+			printf ("flush: socket gone, WRONG\n");
+			errors++;
+			break;
+		}
+		if (queue.queued > 0)
+		{
+			pfd.fd = socks[0];
+			pfd.events = POLLOUT;
+			poll (&pfd, 1, 1000);
+		}
+	}
+	elapsed = g_get_monotonic_time () - start;
+
+	close (socks[0]);
+	g_thread_join (thread);
+	close (socks[1]);
+	errors += reader_errors;
+	rss_end = remmina_ssh_queue_test_peak_rss ();
+
+	printf ("queue: %d MB in %.2f s, %u pauses, at most %" G_GSIZE_FORMAT " bytes in %u buffers queued, %u pooled\n",
+			REMMINA_SSH_QUEUE_TEST_TOTAL / (1024 * 1024), elapsed / 1000000.0, pauses, max_queued,
+			max_buffers, max_pool);
+	if (pauses == 0)
+	{
+		printf ("queue: the reader never fell behind, the watermarks were not exercised, WRONG\n");
+		errors++;
+	}
+	if (max_pool > REMMINA_SSH_TUNNEL_POOL_MAX)
+	{
+		printf ("pool: %u spare buffers kept, more than %d, WRONG\n", max_pool, REMMINA_SSH_TUNNEL_POOL_MAX);
+		errors++;
+	}
+	if (rss_start >= 0 && rss_end >= 0)
+	{
+		printf ("rss: peak grew by %ld kB\n", rss_end - rss_start);
+		if (rss_end - rss_start > REMMINA_SSH_QUEUE_TEST_RSS_MAX)
+		{
+			printf ("rss: peak grew by more than %d kB, WRONG\n", REMMINA_SSH_QUEUE_TEST_RSS_MAX);
+			errors++;
+		}
+	}
+
+	remmina_ssh_tunnel_queue_clear (&queue, pool);
+	remmina_ssh_tunnel_pool_free (pool);
+
+	return errors ? 1 : 0;
+}